@@ -32,8 +32,10 @@
 #include "imagecanvas.h"
 #include "imagelayer.h"
 #include "imageproject.h"
+#include "inputrecorder.h"
 #include "layeredimagecanvas.h"
 #include "layeredimageproject.h"
+#include "layerthumbnailprovider.h"
 #include "project.h"
 #include "projectimageprovider.h"
 #include "projectmanager.h"
@@ -42,6 +44,7 @@
 #include "tilecanvaspaneitem.h"
 #include "tileset.h"
 #include "tilesetproject.h"
+#include "tracer.h"
 
 Q_LOGGING_CATEGORY(lcApplication, "app.application")
 
@@ -78,6 +81,9 @@ Application::Application(int &argc, char **argv, const QString &applicationName)
 
     installTranslators();
 
+    setUpTracing();
+    setUpInputRecording();
+
 #if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
     QQmlFileSelector fileSelector(mEngine.data());
     fileSelector.setExtraSelectors(QStringList() << QLatin1String("nativemenubar"));
@@ -87,6 +93,7 @@ Application::Application(int &argc, char **argv, const QString &applicationName)
 
     mEngine->addImageProvider("sprite", new SpriteImageProvider);
     mEngine->addImageProvider("project", new ProjectImageProvider(&mProjectManager));
+    mEngine->addImageProvider("layerthumbnail", new LayerThumbnailProvider(&mProjectManager));
 
     mEngine->rootContext()->setContextProperty("projectManager", &mProjectManager);
     mEngine->rootContext()->setContextProperty("settings", mSettings.data());
@@ -112,6 +119,11 @@ Application::~Application()
     // Give the engine a little helping hand and ensure that it's
     // destroyed before the project manager, otherwise we get binding errors.
     mEngine.reset();
+
+    // Writes out the trace file if tracing was enabled.
+    Tracer::instance()->setEnabled(false);
+    // Likewise for the input recording.
+    InputRecorder::instance()->setRecording(false);
 }
 
 int Application::run()
@@ -166,6 +178,35 @@ void Application::addFonts()
     }
 }
 
+void Application::setUpTracing()
+{
+    // The environment variable takes precedence over the setting so that
+    // traces can be recorded without having to change the user's settings.
+    const QString traceFilePath = qEnvironmentVariable("SLATE_TRACE_FILE");
+    if (!traceFilePath.isEmpty()) {
+        qCDebug(lcApplication) << "enabling tracing via SLATE_TRACE_FILE; trace will be written to" << traceFilePath;
+        Tracer::instance()->setFilePath(traceFilePath);
+        Tracer::instance()->setEnabled(true);
+        return;
+    }
+
+    Tracer::instance()->setEnabled(mSettings->isTracingEnabled());
+    QObject::connect(mSettings.data(), &ApplicationSettings::tracingEnabledChanged, mSettings.data(), [=]() {
+        Tracer::instance()->setEnabled(mSettings->isTracingEnabled());
+    });
+}
+
+void Application::setUpInputRecording()
+{
+    const QString recordingFilePath = qEnvironmentVariable("SLATE_INPUT_RECORDING_FILE");
+    if (recordingFilePath.isEmpty())
+        return;
+
+    qCDebug(lcApplication) << "recording input via SLATE_INPUT_RECORDING_FILE; session will be written to" << recordingFilePath;
+    InputRecorder::instance()->setFilePath(recordingFilePath);
+    InputRecorder::instance()->setRecording(true);
+}
+
 void Application::installTranslators()
 {
     // Install translators for the current language.
@@ -43,6 +43,8 @@ private:
     void registerQmlTypes();
     void addFonts();
     void installTranslators();
+    void setUpTracing();
+    void setUpInputRecording();
 
     QScopedPointer<QGuiApplication> mApplication;
     QScopedPointer<ApplicationSettings> mSettings;
@@ -203,6 +203,7 @@ ApplicationWindow {
             focus: true
 
             checkedToolButton: toolBar.toolButtonGroup.checkedButton
+            autoSwatchModel: swatchesPanel.autoSwatchModel
 
             SplitView.preferredWidth: window.width / 3
             SplitView.fillWidth: true
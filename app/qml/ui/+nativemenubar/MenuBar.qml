@@ -186,7 +186,7 @@ Item {
                 objectName: "redoMenuItem"
                 text: qsTr("Redo")
                 enabled: project && project.undoStack.canRedo
-                onTriggered: project.undoStack.redo()
+                onTriggered: canvas.redo()
             }
 
             // https://bugreports.qt.io/browse/QTBUG-67310
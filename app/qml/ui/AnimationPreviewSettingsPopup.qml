@@ -35,12 +35,20 @@ Dialog {
     property AnimationPlayback animationPlayback: animationSystem ? animationSystem.currentAnimationPlayback : null
 
     property real originalPreviewScale
+    property int originalUpscaler
 
     readonly property int controlWidth: 180
 
-    onAboutToShow: originalPreviewScale = animationPlayback.scale
+    onAboutToShow: {
+        originalPreviewScale = animationPlayback.scale
+        originalUpscaler = animationPlayback.upscaler
+        upscalerComboBox.currentIndex = upscalerComboBox.indexOfValue(animationPlayback.upscaler)
+    }
 
-    onRejected: animationPlayback.scale = originalPreviewScale
+    onRejected: {
+        animationPlayback.scale = originalPreviewScale
+        animationPlayback.upscaler = originalUpscaler
+    }
 
     GridLayout {
         rowSpacing: 0
@@ -73,5 +81,40 @@ Dialog {
                 text: animationPreviewScaleSlider.valueAt(animationPreviewScaleSlider.position).toFixed(2)
             }
         }
+
+        Label {
+            text: qsTr("Export Upscaler")
+        }
+
+        ComboBox {
+            id: upscalerComboBox
+            objectName: "animationUpscalerComboBox"
+            textRole: "display"
+            valueRole: "value"
+
+            model: [
+                {
+                    value: AnimationPlayback.NearestNeighbourUpscaler,
+                    display: qsTr("Nearest neighbour")
+                },
+                {
+                    value: AnimationPlayback.Scale2xUpscaler,
+                    display: qsTr("Scale2x")
+                },
+                {
+                    value: AnimationPlayback.Scale3xUpscaler,
+                    display: qsTr("Scale3x")
+                }
+            ]
+
+            ToolTip.text: qsTr("How frames are scaled up when exporting a GIF at a whole-number scale")
+            ToolTip.visible: hovered
+            ToolTip.delay: UiConstants.toolTipDelay
+            ToolTip.timeout: UiConstants.toolTipTimeout
+
+            Layout.preferredWidth: controlWidth
+
+            onActivated: animationPlayback.upscaler = currentValue
+        }
     }
 }
@@ -15,6 +15,8 @@ ColumnLayout {
         settings.gesturesEnabled = enableGesturesCheckBox.checked
         settings.penToolRightClickBehaviour = penToolRightClickBehaviourComboBox.currentValue
         settings.autoSwatchEnabled = enableAutoSwatchCheckBox.checked
+        settings.tracingEnabled = enableTracingCheckBox.checked
+        settings.packedTilesEnabled = enablePackedTilesCheckBox.checked
 
         for (var i = 0; i < shortcutModel.count; ++i) {
             var row = shortcutModel.get(i)
@@ -30,6 +32,8 @@ ColumnLayout {
         penToolRightClickBehaviourComboBox.currentIndex =
             penToolRightClickBehaviourComboBox.indexOfValue(settings.penToolRightClickBehaviour)
         enableAutoSwatchCheckBox.checked = settings.autoSwatchEnabled
+        enableTracingCheckBox.checked = settings.tracingEnabled
+        enablePackedTilesCheckBox.checked = settings.packedTilesEnabled
 
         for (var i = 0; i < shortcutModel.count; ++i) {
             var row = shortcutModel.get(i)
@@ -140,6 +144,39 @@ ColumnLayout {
                 ToolTip.timeout: UiConstants.toolTipTimeout
             }
 
+            Label {
+                text: qsTr("Record performance trace")
+            }
+            CheckBox {
+                id: enableTracingCheckBox
+                objectName: "enableTracingCheckBox"
+                leftPadding: 0
+                checked: settings.tracingEnabled
+
+                ToolTip.text: qsTr("Records how long painting, tools, undo/redo, saving, loading and exporting take, "
+                    + "and writes a trace file (viewable in Perfetto or chrome://tracing) to the temporary directory "
+                    + "when disabled or when Slate is closed")
+                ToolTip.visible: hovered
+                ToolTip.delay: UiConstants.toolTipDelay
+                ToolTip.timeout: UiConstants.toolTipTimeout
+            }
+
+            Label {
+                text: qsTr("Save packed tiles (experimental)")
+            }
+            CheckBox {
+                id: enablePackedTilesCheckBox
+                objectName: "enablePackedTilesCheckBox"
+                leftPadding: 0
+                checked: settings.packedTilesEnabled
+
+                ToolTip.text: qsTr("Saves the tiles of tileset projects in a compact format that makes large maps "
+                    + "faster to save and load, but that older versions of Slate can't open")
+                ToolTip.visible: hovered
+                ToolTip.delay: UiConstants.toolTipDelay
+                ToolTip.timeout: UiConstants.toolTipTimeout
+            }
+
             Label {
                 text: qsTr("Shortcuts")
                 font.bold: true
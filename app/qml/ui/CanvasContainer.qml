@@ -30,6 +30,7 @@ Item {
     property Project project: projectManager.project
     property ImageCanvas canvas: loader.item
     property var checkedToolButton
+    property AutoSwatchModel autoSwatchModel
 
     Loader {
         id: loader
@@ -77,6 +78,16 @@ Item {
         color: canvas ? canvas.invertedCursorPixelColour : crosshairCursor.defaultColour
     }
 
+    FrameTimingsOverlay {
+        x: 6
+        y: 6
+        z: 1
+        frameTimings: canvas ? canvas.frameTimings : null
+        canvas: canvasContainer.canvas
+        autoSwatchModel: canvasContainer.autoSwatchModel
+        visible: canvas && settings.fpsVisible
+    }
+
     StatusBar {
         id: statusBar
         parent: ApplicationWindow.window.contentItem
@@ -0,0 +1,277 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+import QtQuick
+import QtQuick.Layouts
+import QtQuick.Controls
+
+import Slate
+
+// Shows where the time in each frame is going, and what is using memory.
+// Shown alongside the FPS counter.
+Pane {
+    id: root
+    objectName: "frameTimingsOverlay"
+    padding: 6
+    opacity: 0.85
+
+    property var frameTimings
+    property ImageCanvas canvas
+    property AutoSwatchModel autoSwatchModel
+
+    readonly property int histogramBarMaxWidth: 80
+
+    function formatTime(milliseconds) {
+        return milliseconds.toFixed(2) + " ms"
+    }
+
+    function histogramBucketLabel(index) {
+        const bounds = frameTimings.frameTimeHistogramBounds
+        if (index === 0)
+            return "< " + bounds[0]
+        if (index === bounds.length)
+            return ">= " + bounds[bounds.length - 1]
+        return bounds[index - 1] + "-" + bounds[index]
+    }
+
+    function formatBytes(bytes) {
+        return Qt.locale().formattedDataSize(bytes)
+    }
+
+    MemoryStats {
+        id: memoryStats
+        objectName: "memoryStats"
+        canvas: root.canvas
+        autoSwatchModel: root.autoSwatchModel
+    }
+
+    // Gathering the stats walks the undo stack, so don't do it every frame.
+    Timer {
+        interval: 1000
+        running: root.visible && root.canvas
+        repeat: true
+        triggeredOnStart: true
+        onTriggered: memoryStats.refresh()
+    }
+
+    Binding {
+        target: root.frameTimings
+        property: "enabled"
+        value: root.visible
+        when: root.frameTimings
+    }
+
+    ColumnLayout {
+        spacing: 2
+
+        GridLayout {
+            columns: 2
+            columnSpacing: 12
+            rowSpacing: 0
+
+            Label {
+                text: qsTr("Frame")
+                font.bold: true
+            }
+            Label {
+                objectName: "frameTimeLabel"
+                text: root.frameTimings ? root.formatTime(root.frameTimings.frameTime) : ""
+                font.bold: true
+            }
+
+            Label {
+                text: qsTr("Content image")
+            }
+            Label {
+                objectName: "contentImageTimeLabel"
+                text: root.frameTimings ? root.formatTime(root.frameTimings.contentImageTime) : ""
+            }
+
+            Label {
+                text: qsTr("Pane paint")
+            }
+            Label {
+                objectName: "paintTimeLabel"
+                text: root.frameTimings ? root.formatTime(root.frameTimings.paintTime) : ""
+            }
+
+            Label {
+                text: qsTr("Tool")
+            }
+            Label {
+                objectName: "toolTimeLabel"
+                text: root.frameTimings ? root.formatTime(root.frameTimings.toolTime) : ""
+            }
+
+            Label {
+                text: qsTr("Undo push")
+            }
+            Label {
+                objectName: "undoPushTimeLabel"
+                text: root.frameTimings ? root.formatTime(root.frameTimings.undoPushTime) : ""
+            }
+        }
+
+        Label {
+            text: qsTr("Frame times (ms)")
+            font.bold: true
+
+            Layout.topMargin: 4
+        }
+
+        Repeater {
+            objectName: "frameTimeHistogramRepeater"
+            model: root.frameTimings ? root.frameTimings.frameTimeHistogram : []
+
+            RowLayout {
+                spacing: 6
+
+                readonly property int frameCount: modelData
+                readonly property int maxFrameCount: Math.max(...root.frameTimings.frameTimeHistogram, 1)
+
+                Label {
+                    text: root.histogramBucketLabel(index)
+
+                    Layout.preferredWidth: histogramLabelTextMetrics.width
+                }
+                Rectangle {
+                    color: index >= 2 ? "#e06c75" : "#98c379"
+
+                    Layout.preferredWidth: Math.max(1, root.histogramBarMaxWidth * frameCount / maxFrameCount)
+                    Layout.preferredHeight: 8
+                }
+                Label {
+                    text: frameCount
+                }
+            }
+        }
+
+        TextMetrics {
+            id: histogramLabelTextMetrics
+            text: ">= 100"
+        }
+
+        Label {
+            text: qsTr("Slowest recent frames")
+            font.bold: true
+            visible: slowestFramesRepeater.count > 0
+
+            Layout.topMargin: 4
+        }
+
+        Repeater {
+            id: slowestFramesRepeater
+            objectName: "slowestFramesRepeater"
+            model: root.frameTimings ? root.frameTimings.slowestFrames : []
+
+            Label {
+                text: qsTr("%1 (content %2, paint %3, tool %4, undo %5)")
+                    .arg(root.formatTime(modelData.frameTime))
+                    .arg(modelData.contentImageTime.toFixed(1))
+                    .arg(modelData.paintTime.toFixed(1))
+                    .arg(modelData.toolTime.toFixed(1))
+                    .arg(modelData.undoPushTime.toFixed(1))
+            }
+        }
+
+        Label {
+            text: qsTr("Memory")
+            font.bold: true
+
+            Layout.topMargin: 4
+        }
+
+        GridLayout {
+            objectName: "memoryStatsGridLayout"
+            columns: 2
+            columnSpacing: 12
+            rowSpacing: 0
+
+            Label {
+                text: qsTr("Total")
+                font.bold: true
+            }
+            Label {
+                objectName: "totalBytesLabel"
+                text: root.formatBytes(memoryStats.totalBytes)
+                font.bold: true
+            }
+
+            Label {
+                text: qsTr("Layers")
+            }
+            Label {
+                text: root.formatBytes(memoryStats.layerBytes)
+            }
+
+            Label {
+                text: qsTr("Undo stack")
+            }
+            Label {
+                objectName: "undoStackBytesLabel"
+                text: root.formatBytes(memoryStats.undoStackBytes)
+            }
+
+            Label {
+                text: qsTr("Live preview")
+            }
+            Label {
+                text: root.formatBytes(memoryStats.livePreviewBytes)
+            }
+
+            Label {
+                text: qsTr("Selection")
+            }
+            Label {
+                text: root.formatBytes(memoryStats.selectionBytes)
+            }
+
+            Label {
+                text: qsTr("Content image cache")
+            }
+            Label {
+                text: root.formatBytes(memoryStats.contentImageCacheBytes)
+            }
+
+            Label {
+                text: qsTr("Clipboard")
+            }
+            Label {
+                text: root.formatBytes(memoryStats.clipboardBytes)
+            }
+
+            Label {
+                text: qsTr("Auto swatch")
+            }
+            Label {
+                text: root.formatBytes(memoryStats.autoSwatchBytes)
+            }
+        }
+
+        Repeater {
+            objectName: "undoCommandMemoryRepeater"
+            model: memoryStats.undoCommands
+
+            Label {
+                text: qsTr("%1 \u00d7 %2: %3").arg(modelData.count).arg(modelData.type)
+                    .arg(root.formatBytes(modelData.bytes))
+            }
+        }
+    }
+}
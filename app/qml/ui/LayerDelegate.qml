@@ -61,4 +61,18 @@ EditableDelegate {
 
         onClicked: project.setLayerVisible(index, checked)
     }
+
+    Image {
+        objectName: "layerThumbnailImage"
+        source: model.thumbnailUrl
+        // The URL changes every time the thumbnail does, so there's no point caching old ones.
+        cache: false
+        smooth: false
+        fillMode: Image.PreserveAspectFit
+        parent: root.leftSectionLayout
+
+        Layout.preferredWidth: 24
+        Layout.preferredHeight: 24
+        Layout.rightMargin: 4
+    }
 }
@@ -35,7 +35,8 @@ Dialog {
     property LayeredImageProject project
 
     function updateLivePreview() {
-        project.moveContents(xDistanceSpinBox.value, yDistanceSpinBox.value, onlyMoveVisibleLayersCheckBox.checked)
+        project.moveContents(xDistanceSpinBox.value, yDistanceSpinBox.value, onlyMoveVisibleLayersCheckBox.checked,
+            wrapAroundCheckBox.checked)
     }
 
     onAboutToShow: {
@@ -125,6 +126,26 @@ Dialog {
 
                 Keys.onReturnPressed: root.accept()
             }
+
+            Label {
+                text: qsTr("Wrap around")
+                Layout.fillWidth: true
+            }
+
+            CheckBox {
+                id: wrapAroundCheckBox
+                objectName: "wrapAroundMoveContentsCheckBox"
+                checked: false
+
+                ToolTip.text: qsTr("Move contents that go past one edge to the opposite edge, as when tiling")
+                ToolTip.visible: hovered
+                ToolTip.delay: UiConstants.toolTipDelay
+                ToolTip.timeout: UiConstants.toolTipTimeout
+
+                onToggled: root.updateLivePreview()
+
+                Keys.onReturnPressed: root.accept()
+            }
         }
     }
 
@@ -43,6 +43,8 @@ Panel {
 
     property ImageCanvas canvas
     property Project project
+    // Null when auto swatches are disabled.
+    readonly property AutoSwatchModel autoSwatchModel: autoSwatchLoader.item ? autoSwatchLoader.item.model : null
 
     readonly property int delegateSize: swatchGridView.cellWidth
     readonly property int minimumUsefulHeight: header.implicitHeight
@@ -76,6 +78,7 @@ Panel {
             Layout.preferredHeight: 100
 
             Loader {
+                id: autoSwatchLoader
                 active: settings.autoSwatchEnabled
 
                 Layout.fillWidth: true
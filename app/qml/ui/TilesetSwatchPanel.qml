@@ -212,5 +212,21 @@ Panel {
                 contextMenu.rightClickedTile = null;
             }
         }
+
+        MenuItem {
+            objectName: "highlightTileUsagesMenuItem"
+            text: usesHighlighted ? qsTr("Stop Highlighting Uses") : qsTr("Highlight Uses")
+            // There's nothing to highlight if the tile isn't drawn anywhere on the map.
+            enabled: usesHighlighted || (!!contextMenu.rightClickedTile
+                && project.tilePositionsUsingTile(contextMenu.rightClickedTile.id).length > 0)
+
+            readonly property bool usesHighlighted: tileCanvas && contextMenu.rightClickedTile
+                ? tileCanvas.highlightedTileId === contextMenu.rightClickedTile.id : false
+
+            onTriggered: {
+                tileCanvas.highlightedTileId = usesHighlighted ? -1 : contextMenu.rightClickedTile.id;
+                contextMenu.rightClickedTile = null;
+            }
+        }
     }
 }
@@ -15,6 +15,7 @@ TileCanvas {
     checkerColour2: settings.checkerColour2
     gridColour: "#55000000"
     splitColour: Theme.splitColour
+    highlightColour: Theme.focusColour
     splitter.width: 32
     scrollZoom: settings.scrollZoom
     gesturesEnabled: settings.gesturesEnabled
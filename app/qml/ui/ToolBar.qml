@@ -138,7 +138,7 @@ ToolBarBase {
 
                 ToolTip.text: qsTr("Redo the last undone canvas operation")
 
-                onClicked: project.undoStack.redo()
+                onClicked: canvas.redo()
             }
 
             ToolSeparator {}
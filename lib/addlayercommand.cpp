@@ -62,6 +62,14 @@ bool AddLayerCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> AddLayerCommand::heldImages() const
+{
+    // The layer is only ours while the command is undone.
+    if (mLayerGuard)
+        return { *mLayerGuard->image() };
+    return {};
+}
+
 QDebug operator<<(QDebug debug, const AddLayerCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -162,6 +162,20 @@ void AnimationPlayback::setLoop(bool loop)
     emit loopChanged();
 }
 
+AnimationPlayback::Upscaler AnimationPlayback::upscaler() const
+{
+    return mUpscaler;
+}
+
+void AnimationPlayback::setUpscaler(Upscaler upscaler)
+{
+    if (upscaler == mUpscaler)
+        return;
+
+    mUpscaler = upscaler;
+    emit upscalerChanged();
+}
+
 int AnimationPlayback::pauseIndex() const
 {
     return mPauseIndex;
@@ -192,6 +206,8 @@ void AnimationPlayback::read(const QJsonObject &json)
 {
     setScale(json.value(QLatin1String("scale")).toDouble());
     setLoop(json.value(QLatin1String("loop")).toBool());
+    // Projects saved before this was added don't have it.
+    setUpscaler(static_cast<Upscaler>(json.value(QLatin1String("upscaler")).toInt(NearestNeighbourUpscaler)));
     setPlaying(false);
 }
 
@@ -199,6 +215,7 @@ void AnimationPlayback::write(QJsonObject &json) const
 {
     json[QLatin1String("scale")] = mScale;
     json[QLatin1String("loop")] = mLoop;
+    json[QLatin1String("upscaler")] = mUpscaler;
 }
 
 void AnimationPlayback::reset()
@@ -209,6 +226,7 @@ void AnimationPlayback::reset()
     mWasPlayingBeforeAnimationChanged = false;
     setScale(1.0);
     setLoop(true);
+    setUpscaler(NearestNeighbourUpscaler);
     mTimerId = -1;
 }
 
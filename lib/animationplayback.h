@@ -38,6 +38,7 @@ class SLATE_EXPORT AnimationPlayback : public QObject
     Q_PROPERTY(int currentFrameIndex READ currentFrameIndex WRITE setCurrentFrameIndex NOTIFY currentFrameIndexChanged FINAL)
     Q_PROPERTY(qreal scale READ scale WRITE setScale NOTIFY scaleChanged FINAL)
     Q_PROPERTY(bool loop READ shouldLoop WRITE setLoop NOTIFY loopChanged)
+    Q_PROPERTY(Upscaler upscaler READ upscaler WRITE setUpscaler NOTIFY upscalerChanged FINAL)
     // Not serialised.
     Q_PROPERTY(Animation *animation READ animation WRITE setAnimation NOTIFY animationChanged)
     Q_PROPERTY(bool playing READ isPlaying WRITE setPlaying NOTIFY playingChanged)
@@ -46,6 +47,15 @@ class SLATE_EXPORT AnimationPlayback : public QObject
     Q_MOC_INCLUDE("animation.h")
 
 public:
+    // How frames are scaled up when exporting at a whole-number scale.
+    // The values match ImageUtils::Upscaler; this just makes them available to QML.
+    enum Upscaler {
+        NearestNeighbourUpscaler,
+        Scale2xUpscaler,
+        Scale3xUpscaler
+    };
+    Q_ENUM(Upscaler)
+
     explicit AnimationPlayback(QObject *parent = nullptr);
 
     Animation *animation() const;
@@ -64,6 +74,9 @@ public:
     bool shouldLoop() const;
     void setLoop(bool shouldLoop);
 
+    Upscaler upscaler() const;
+    void setUpscaler(Upscaler upscaler);
+
     int pauseIndex() const;
 
     void read(const QJsonObject &json);
@@ -76,6 +89,7 @@ signals:
     void currentFrameIndexChanged();
     void scaleChanged();
     void loopChanged();
+    void upscalerChanged();
     void playingChanged();
 
 private slots:
@@ -97,6 +111,7 @@ private:
     // which is convenient because it allows us to switch between playing animations quickly.
     bool mWasPlayingBeforeAnimationChanged = false;
     bool mLoop = false;
+    Upscaler mUpscaler = NearestNeighbourUpscaler;
 
     int mTimerId = -1;
 };
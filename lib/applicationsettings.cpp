@@ -240,6 +240,47 @@ void ApplicationSettings::setAutoSwatchEnabled(bool autoSwatchEnabled)
     emit autoSwatchEnabledChanged();
 }
 
+bool ApplicationSettings::defaultTracingEnabled() const
+{
+    return false;
+}
+
+bool ApplicationSettings::isTracingEnabled() const
+{
+    return contains("tracingEnabled") ? value("tracingEnabled").toBool() : defaultTracingEnabled();
+}
+
+void ApplicationSettings::setTracingEnabled(bool tracingEnabled)
+{
+    const bool existingValue = value("tracingEnabled", defaultTracingEnabled()).toBool();
+    if (tracingEnabled == existingValue)
+        return;
+
+    setValue("tracingEnabled", tracingEnabled);
+    emit tracingEnabledChanged();
+}
+
+bool ApplicationSettings::defaultPackedTilesEnabled() const
+{
+    // Older versions of Slate can only read the "tiles" array.
+    return false;
+}
+
+bool ApplicationSettings::isPackedTilesEnabled() const
+{
+    return contains("packedTilesEnabled") ? value("packedTilesEnabled").toBool() : defaultPackedTilesEnabled();
+}
+
+void ApplicationSettings::setPackedTilesEnabled(bool packedTilesEnabled)
+{
+    const bool existingValue = value("packedTilesEnabled", defaultPackedTilesEnabled()).toBool();
+    if (packedTilesEnabled == existingValue)
+        return;
+
+    setValue("packedTilesEnabled", packedTilesEnabled);
+    emit packedTilesEnabledChanged();
+}
+
 bool ApplicationSettings::defaultAlwaysShowCrosshair() const
 {
     return false;
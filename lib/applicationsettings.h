@@ -44,6 +44,8 @@ class SLATE_EXPORT ApplicationSettings : public QSettings
         WRITE setShowCurrentLayerInStatusBar NOTIFY showCurrentLayerInStatusBarChanged)
     Q_PROPERTY(bool gesturesEnabled READ areGesturesEnabled WRITE setGesturesEnabled NOTIFY gesturesEnabledChanged)
     Q_PROPERTY(bool autoSwatchEnabled READ isAutoSwatchEnabled WRITE setAutoSwatchEnabled NOTIFY autoSwatchEnabledChanged)
+    Q_PROPERTY(bool tracingEnabled READ isTracingEnabled WRITE setTracingEnabled NOTIFY tracingEnabledChanged)
+    Q_PROPERTY(bool packedTilesEnabled READ isPackedTilesEnabled WRITE setPackedTilesEnabled NOTIFY packedTilesEnabledChanged)
     Q_PROPERTY(bool alwaysShowCrosshair READ isAlwaysShowCrosshair WRITE setAlwaysShowCrosshair NOTIFY alwaysShowCrosshairChanged)
     Q_PROPERTY(qreal windowOpacity READ windowOpacity WRITE setWindowOpacity NOTIFY windowOpacityChanged)
     Q_PROPERTY(QColor checkerColour1 READ checkerColour1 WRITE setCheckerColour1 NOTIFY checkerColour1Changed)
@@ -133,6 +135,14 @@ public:
     bool isAutoSwatchEnabled() const;
     void setAutoSwatchEnabled(bool autoSwatchEnabled);
 
+    bool defaultTracingEnabled() const;
+    bool isTracingEnabled() const;
+    void setTracingEnabled(bool tracingEnabled);
+
+    bool defaultPackedTilesEnabled() const;
+    bool isPackedTilesEnabled() const;
+    void setPackedTilesEnabled(bool packedTilesEnabled);
+
     bool defaultAlwaysShowCrosshair() const;
     bool isAlwaysShowCrosshair() const;
     void setAlwaysShowCrosshair(bool alwaysShowCrosshair);
@@ -328,6 +338,8 @@ signals:
     void showCurrentLayerInStatusBarChanged();
     void gesturesEnabledChanged();
     void autoSwatchEnabledChanged();
+    void tracingEnabledChanged();
+    void packedTilesEnabledChanged();
     void alwaysShowCrosshairChanged();
     void windowOpacityChanged();
     void checkerColour1Changed();
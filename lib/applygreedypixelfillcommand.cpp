@@ -59,6 +59,11 @@ bool ApplyGreedyPixelFillCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ApplyGreedyPixelFillCommand::heldImages() const
+{
+    return { mPreviousImage, mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const ApplyGreedyPixelFillCommand *command)
 {
     QDebugStateSaver saver(debug);
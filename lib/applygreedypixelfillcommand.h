@@ -40,6 +40,7 @@ public:
     int id() const override;
 
     bool modifiesContents() const override;
+    QVector<QImage> heldImages() const override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ApplyGreedyPixelFillCommand *command);
@@ -25,14 +25,13 @@
 
 Q_LOGGING_CATEGORY(lcApplyPixelEraserCommand, "app.undo.applyPixelEraserCommand")
 
-ApplyPixelEraserCommand::ApplyPixelEraserCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions,
-    const QVector<QColor> &previousColours, UndoCommand *parent) :
+ApplyPixelEraserCommand::ApplyPixelEraserCommand(TileCanvas *canvas, int layerIndex,
+    const TileCanvas::PixelBufferData &pixelData, UndoCommand *parent) :
     UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex)
 {
-    mScenePositions = scenePositions;
-    mPreviousColours = previousColours;
+    mPixelData.append(pixelData);
 
     qCDebug(lcApplyPixelEraserCommand) << "constructed" << this;
 }
@@ -40,17 +39,22 @@ ApplyPixelEraserCommand::ApplyPixelEraserCommand(ImageCanvas *canvas, int layerI
 void ApplyPixelEraserCommand::undo()
 {
     qCDebug(lcApplyPixelEraserCommand) << "undoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(mLayerIndex, mScenePositions.at(i), mPreviousColours.at(i));
+    mCanvas->beginPixelPenChanges();
+    // Go backwards so that pixels touched by several events end up as they were originally.
+    for (int i = mPixelData.size() - 1; i >= 0; --i) {
+        const TileCanvas::PixelBufferData &pixelData = mPixelData.at(i);
+        mCanvas->applyPixelBuffer(mLayerIndex, pixelData.sceneRect, pixelData.previousPixels, pixelData.mask);
     }
+    mCanvas->endPixelPenChanges();
 }
 
 void ApplyPixelEraserCommand::redo()
 {
     qCDebug(lcApplyPixelEraserCommand) << "redoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(mLayerIndex, mScenePositions.at(i), QColor(Qt::transparent));
-    }
+    mCanvas->beginPixelPenChanges();
+    for (const TileCanvas::PixelBufferData &pixelData : qAsConst(mPixelData))
+        mCanvas->applyPixelBuffer(mLayerIndex, pixelData.sceneRect, pixelData.newPixels, pixelData.mask);
+    mCanvas->endPixelPenChanges();
 }
 
 int ApplyPixelEraserCommand::id() const
@@ -65,15 +69,10 @@ bool ApplyPixelEraserCommand::mergeWith(const QUndoCommand *other)
         return false;
     }
 
-    // Duplicate pixel; we can just discard the other command.
-    if (otherCommand->mScenePositions.size() == 1 && mScenePositions.contains(otherCommand->mScenePositions.first())) {
-        return true;
-    }
-
-    // A unique pixel that we haven't touched yet; add it.
+    // Pixels that were already erased aren't in the other command's mask,
+    // so there's nothing to filter out here.
     qCDebug(lcApplyPixelEraserCommand) << "\nmerging:\n    " << otherCommand << "\nwith:\n    " << this;
-    mScenePositions.append(otherCommand->mScenePositions);
-    mPreviousColours.append(otherCommand->mPreviousColours);
+    mPixelData.append(otherCommand->mPixelData);
     return true;
 }
 
@@ -82,6 +81,14 @@ bool ApplyPixelEraserCommand::modifiesContents() const
     return true;
 }
 
+qint64 ApplyPixelEraserCommand::heldBytes() const
+{
+    qint64 bytes = 0;
+    for (const TileCanvas::PixelBufferData &pixelData : mPixelData)
+        bytes += pixelData.sizeInBytes();
+    return bytes;
+}
+
 QDebug operator<<(QDebug debug, const ApplyPixelEraserCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -90,8 +97,7 @@ QDebug operator<<(QDebug debug, const ApplyPixelEraserCommand *command)
 
     debug.nospace() << "(ApplyPixelEraserCommand"
         << " layerIndex=" << command->mLayerIndex
-        << ", scenePositions=" << command->mScenePositions
-        << ", previousColours=" << command->mPreviousColours
+        << ", pixelDataCount=" << command->mPixelData.size()
         << ")";
     return debug;
 }
@@ -20,19 +20,17 @@
 #ifndef APPLYPIXELERASERCOMMAND_H
 #define APPLYPIXELERASERCOMMAND_H
 
-#include <QColor>
 #include <QDebug>
-#include <QPoint>
 #include <QVector>
 
-#include "imagecanvas.h"
 #include "slate-global.h"
+#include "tilecanvas.h"
 #include "undocommand.h"
 
 class SLATE_EXPORT ApplyPixelEraserCommand : public UndoCommand
 {
 public:
-    ApplyPixelEraserCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions, const QVector<QColor> &previousColours,
+    ApplyPixelEraserCommand(TileCanvas *canvas, int layerIndex, const TileCanvas::PixelBufferData &pixelData,
         UndoCommand *parent = nullptr);
 
     void undo() override;
@@ -42,14 +40,15 @@ public:
     bool mergeWith(const QUndoCommand *other) override;
 
     bool modifiesContents() const override;
+    qint64 heldBytes() const override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ApplyPixelEraserCommand *command);
 
-    ImageCanvas *mCanvas;
+    TileCanvas *mCanvas;
     int mLayerIndex;
-    QVector<QPoint> mScenePositions;
-    QVector<QColor> mPreviousColours;
+    // One for each event of the eraser session, in the order they were applied.
+    QVector<TileCanvas::PixelBufferData> mPixelData;
 };
 
 
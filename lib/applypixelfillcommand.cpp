@@ -58,6 +58,11 @@ bool ApplyPixelFillCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ApplyPixelFillCommand::heldImages() const
+{
+    return { mPreviousImage, mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const ApplyPixelFillCommand *command)
 {
     QDebugStateSaver saver(debug);
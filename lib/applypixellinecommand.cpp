@@ -24,42 +24,61 @@
 #include <QImage>
 
 #include "commands.h"
+#include "pixelbrush.h"
 
 Q_LOGGING_CATEGORY(lcApplyPixelLineCommand, "app.undo.applyPixelLineCommand")
 
-// The undo command for lines needs the project image before and after
-// the line was drawn on it.
 ApplyPixelLineCommand::ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex, QImage &currentProjectImage, const QPointF &point1, const QPointF &point2,
         const QPointF &newLastPixelPenReleaseScenePos, const QPointF &oldLastPixelPenReleaseScenePos,
         QPainter::CompositionMode mode, UndoCommand *parent) :
+    ApplyPixelLineCommand(canvas, layerIndex, currentProjectImage, QVector<QPointF>{ point1, point2 },
+        newLastPixelPenReleaseScenePos, oldLastPixelPenReleaseScenePos, mode, parent)
+{
+}
+
+ApplyPixelLineCommand::ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex, QImage &currentProjectImage, const QVector<QPointF> &points,
+        const QPointF &newLastPixelPenReleaseScenePos, const QPointF &oldLastPixelPenReleaseScenePos,
+        QPainter::CompositionMode mode, UndoCommand *parent) :
     UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
+    mMode(mode),
     mNewLastPixelPenReleaseScenePos(newLastPixelPenReleaseScenePos),
     mOldLastPixelPenReleaseScenePos(oldLastPixelPenReleaseScenePos)
 {
-    const QRect lineRect = mCanvas->normalisedLineRect(point1, point2);
+    // Only the area around each segment is saved, rather than the bounding
+    // rect of the whole polyline, which could be most of the image.
+    const PixelBrush brush(canvas->toolSize(), canvas->toolShape());
+    QRegion lineRegion;
+    for (int i = 0; i < points.size(); ++i) {
+        const QPoint snappedPos = brush.snappedPosition(points.at(i));
+        const QPoint previousSnappedPos = i > 0 ? brush.snappedPosition(points.at(i - 1)) : snappedPos;
+        lineRegion += brush.lineRect(previousSnappedPos, snappedPos);
+    }
+    const QRect lineRect = lineRegion.boundingRect();
+
     const QList<ImageCanvas::SubImage> subImages = canvas->subImagesInBounds(lineRect);
     for (auto const &subImage : subImages) {
         // subimage-space to scene-space offset
         const QPoint offset = subImage.bounds.topLeft() - subImage.offset;
         // line rect offset to scene space and clipped to subimage bounds
-        const QRect subImageLineRect = subImage.bounds.intersected(lineRect.translated(offset));
+        const QRect subImageLineRect = subImage.bounds.intersected(lineRect.translated(offset))
+            .intersected(currentProjectImage.rect());
+        if (subImageLineRect.isEmpty())
+            continue;
 
-        SubImageData subImageData;
-        subImageData.subImage = subImage;
-        subImageData.lineRect = subImageLineRect;
-        subImageData.imageWithoutLine = currentProjectImage.copy(subImageLineRect);
+        // Save the original pixels before drawing, as several subimages
+        // can refer to the same part of the image (e.g. a tile used twice).
+        const QRegion subImageLineRegion = lineRegion.translated(offset).intersected(subImageLineRect);
+        for (const QRect &rect : subImageLineRegion)
+            addImageWithoutLine(rect, currentProjectImage);
 
-        QPainter painter(&currentProjectImage);
-        // Clip drawing to subimage
-        painter.setClipRect(subImageLineRect);
         // Draw line with offset to subimage
-        mCanvas->drawLine(&painter, point1 + offset, point2 + offset, mode);
-        painter.end();
-
-        subImageData.imageWithLine = currentProjectImage.copy(subImageLineRect);
-        subImageDatas.append(subImageData);
+        QVector<QPointF> subImagePoints;
+        subImagePoints.reserve(points.size());
+        for (const QPointF &point : points)
+            subImagePoints.append(point + offset);
+        mCanvas->drawPixelPolyline(&currentProjectImage, subImagePoints, mode, subImageLineRect);
     }
 
     qCDebug(lcApplyPixelLineCommand) << "constructed" << this;
@@ -73,17 +92,22 @@ ApplyPixelLineCommand::~ApplyPixelLineCommand()
 void ApplyPixelLineCommand::undo()
 {
     qCDebug(lcApplyPixelLineCommand) << "undoing" << this;
-    for (auto const &subImageData : qAsConst(subImageDatas)) {
-        mCanvas->applyPixelLineTool(mLayerIndex, subImageData.imageWithoutLine, subImageData.lineRect, mOldLastPixelPenReleaseScenePos);
-    }
+    if (mStrokeImageWithLine.isNull())
+        buildStrokeImages();
+
+    mCanvas->applyPixelLineTool(mLayerIndex, mStrokeImageWithoutLine, mStrokeRect, mOldLastPixelPenReleaseScenePos);
 }
 
 void ApplyPixelLineCommand::redo()
 {
     qCDebug(lcApplyPixelLineCommand) << "redoing" << this;
-    for (auto const &subImageData : qAsConst(subImageDatas)) {
-        mCanvas->applyPixelLineTool(mLayerIndex, subImageData.imageWithLine, subImageData.lineRect, mNewLastPixelPenReleaseScenePos);
+    if (mStrokeImageWithLine.isNull()) {
+        // The line was drawn when we were created; just let the canvas know about it.
+        mCanvas->notifyPixelLineDrawn(mLayerIndex, mStrokeRegion.boundingRect(), mNewLastPixelPenReleaseScenePos);
+        return;
     }
+
+    mCanvas->applyPixelLineTool(mLayerIndex, mStrokeImageWithLine, mStrokeRect, mNewLastPixelPenReleaseScenePos);
 }
 
 int ApplyPixelLineCommand::id() const
@@ -91,9 +115,26 @@ int ApplyPixelLineCommand::id() const
     return ApplyPixelLineCommandId;
 }
 
-bool ApplyPixelLineCommand::mergeWith(const QUndoCommand *)
+// Merges the next segment of the same stroke into this command.
+// QUndoStack only tries this with the last command of the current
+// macro, and each stroke is its own macro.
+bool ApplyPixelLineCommand::mergeWith(const QUndoCommand *other)
 {
-    return false;
+    const ApplyPixelLineCommand *otherCommand = dynamic_cast<const ApplyPixelLineCommand*>(other);
+    if (!otherCommand || otherCommand->mCanvas != mCanvas || otherCommand->mLayerIndex != mLayerIndex
+            || otherCommand->mMode != mMode)
+        return false;
+
+    // We've already been undone, so the stroke is over.
+    if (!mStrokeImageWithLine.isNull())
+        return false;
+
+    for (const ImageWithoutLine &imageWithoutLine : otherCommand->mImagesWithoutLine)
+        addImageWithoutLine(imageWithoutLine.rect, imageWithoutLine.image, imageWithoutLine.rect.topLeft());
+    mNewLastPixelPenReleaseScenePos = otherCommand->mNewLastPixelPenReleaseScenePos;
+
+    qCDebug(lcApplyPixelLineCommand) << "merged" << otherCommand << "into" << this;
+    return true;
 }
 
 bool ApplyPixelLineCommand::modifiesContents() const
@@ -101,6 +142,42 @@ bool ApplyPixelLineCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ApplyPixelLineCommand::heldImages() const
+{
+    QVector<QImage> images = { mStrokeImageWithoutLine, mStrokeImageWithLine };
+    for (const ImageWithoutLine &imageWithoutLine : mImagesWithoutLine)
+        images.append(imageWithoutLine.image);
+    return images;
+}
+
+// Saves the pixels of rect that we don't already have; image is positioned at imagePos.
+void ApplyPixelLineCommand::addImageWithoutLine(const QRect &rect, const QImage &image, const QPoint &imagePos)
+{
+    const QRegion newRegion = QRegion(rect).subtracted(mStrokeRegion);
+    for (const QRect &newRect : newRegion)
+        mImagesWithoutLine.append({ newRect, image.copy(newRect.translated(-imagePos)) });
+    mStrokeRegion += newRegion;
+}
+
+// Combines everything that the stroke covered into one image for undoing and one for redoing.
+void ApplyPixelLineCommand::buildStrokeImages()
+{
+    mStrokeRect = mStrokeRegion.boundingRect();
+    if (mStrokeRect.isEmpty())
+        return;
+
+    mStrokeImageWithLine = mCanvas->imageForLayerAt(mLayerIndex)->copy(mStrokeRect);
+    mStrokeImageWithoutLine = mStrokeImageWithLine;
+    QPainter painter(&mStrokeImageWithoutLine);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (const ImageWithoutLine &imageWithoutLine : qAsConst(mImagesWithoutLine))
+        painter.drawImage(imageWithoutLine.rect.topLeft() - mStrokeRect.topLeft(), imageWithoutLine.image);
+    painter.end();
+
+    mImagesWithoutLine.clear();
+    mStrokeRegion = QRegion();
+}
+
 QDebug operator<<(QDebug debug, const ApplyPixelLineCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -109,7 +186,7 @@ QDebug operator<<(QDebug debug, const ApplyPixelLineCommand *command)
 
     debug.nospace() << "(ApplyPixelLineCommand"
         << " layerIndex=" << command->mLayerIndex
-//        << ", lineRect" << command->mLineRect
+        << ", strokeRect=" << command->mStrokeRegion.boundingRect().united(command->mStrokeRect)
         << ", newLastPixelPenReleaseScenePos=" << command->mNewLastPixelPenReleaseScenePos
         << ", oldLastPixelPenReleaseScenePos=" << command->mOldLastPixelPenReleaseScenePos
         << ")";
@@ -22,17 +22,28 @@
 
 #include <QDebug>
 #include <QPointF>
+#include <QRegion>
+#include <QVector>
 
 #include "imagecanvas.h"
 #include "slate-global.h"
 #include "undocommand.h"
 
+// Segments of a stroke are drawn straight into the image as they come in,
+// and consecutive segments of the same stroke are merged into one command.
+// Only the pixels that a segment covers for the first time are saved, and
+// the images used for undoing and redoing are built once, when the stroke
+// is first undone.
 class SLATE_EXPORT ApplyPixelLineCommand : public UndoCommand
 {
 public:
     ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex, QImage &currentProjectImage, const QPointF &point1, const QPointF &point2,
         const QPointF &newLastPixelPenReleaseScenePos, const QPointF &oldLastPixelPenReleaseScenePos,
         QPainter::CompositionMode mode, UndoCommand *parent = nullptr);
+    // Draws a line through each of points, e.g. mouse moves that were coalesced into one frame.
+    ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex, QImage &currentProjectImage, const QVector<QPointF> &points,
+        const QPointF &newLastPixelPenReleaseScenePos, const QPointF &oldLastPixelPenReleaseScenePos,
+        QPainter::CompositionMode mode, UndoCommand *parent = nullptr);
     ~ApplyPixelLineCommand() override;
 
     void undo() override;
@@ -42,22 +53,33 @@ public:
     bool mergeWith(const QUndoCommand *other) override;
 
     bool modifiesContents() const override;
+    QVector<QImage> heldImages() const override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ApplyPixelLineCommand *command);
 
+    void addImageWithoutLine(const QRect &rect, const QImage &image, const QPoint &imagePos = QPoint());
+    void buildStrokeImages();
+
     ImageCanvas *mCanvas;
     int mLayerIndex;
+    QPainter::CompositionMode mMode;
     QPointF mNewLastPixelPenReleaseScenePos;
     QPointF mOldLastPixelPenReleaseScenePos;
 
-    struct SubImageData {
-        ImageCanvas::SubImage subImage;
-        QRect lineRect;
-        QImage imageWithoutLine;
-        QImage imageWithLine;
+    // The original pixels of each area that the stroke covered,
+    // in the coordinates of the image that was drawn on.
+    struct ImageWithoutLine {
+        QRect rect;
+        QImage image;
     };
-    QList<SubImageData> subImageDatas;
+    QVector<ImageWithoutLine> mImagesWithoutLine;
+    QRegion mStrokeRegion;
+
+    // Bounding rect of mStrokeRegion and the images for it; null until the first undo.
+    QRect mStrokeRect;
+    QImage mStrokeImageWithoutLine;
+    QImage mStrokeImageWithLine;
 };
 
 
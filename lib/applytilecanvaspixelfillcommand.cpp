@@ -41,17 +41,21 @@ ApplyTileCanvasPixelFillCommand::ApplyTileCanvasPixelFillCommand(TileCanvas *can
 void ApplyTileCanvasPixelFillCommand::undo()
 {
     qCDebug(lcApplyTileCanvasPixelFillCommand) << "undoing" << this;
+    mCanvas->beginPixelPenChanges();
     for (int i = 0; i < mScenePositions.size(); ++i) {
         mCanvas->applyPixelPenTool(-1, mScenePositions.at(i), mPreviousColour);
     }
+    mCanvas->endPixelPenChanges();
 }
 
 void ApplyTileCanvasPixelFillCommand::redo()
 {
     qCDebug(lcApplyTileCanvasPixelFillCommand) << "redoing" << this;
+    mCanvas->beginPixelPenChanges();
     for (int i = 0; i < mScenePositions.size(); ++i) {
         mCanvas->applyPixelPenTool(-1, mScenePositions.at(i), mColour);
     }
+    mCanvas->endPixelPenChanges();
 }
 
 int ApplyTileCanvasPixelFillCommand::id() const
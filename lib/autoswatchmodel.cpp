@@ -24,6 +24,7 @@
 #include "imagecanvas.h"
 #include "imageutils.h"
 #include "project.h"
+#include "tracer.h"
 
 Q_LOGGING_CATEGORY(lcAutoSwatchModel, "app.autoSwatchModel")
 
@@ -41,6 +42,8 @@ AutoSwatchWorker::~AutoSwatchWorker()
 
 void AutoSwatchWorker::findUniqueColours(const QImage &image)
 {
+    SLATE_TRACE_SCOPE("autoSwatch", "AutoSwatchWorker::findUniqueColours");
+
     if (image.isNull()) {
         emit errorOccurred(tr("Cannot find unique colours in the image because it is null."));
         return;
@@ -231,7 +234,9 @@ void AutoSwatchModel::updateColours()
     // The index of the undo stack can be set in its destructor,
     // so we need to account for that here.
     if (mCanvas && mCanvas->project() && mCanvas->project()->hasLoaded()) {
-        const QSize imageSize = mCanvas->project()->exportedImage().size();
+        // This is cached by the project, so it's only flattened once per modification.
+        const QImage exportedImage = mCanvas->project()->exportedImage();
+        const QSize imageSize = exportedImage.size();
         if (imageSize.width() * imageSize.height() > maxAutoSwatchImageDimensionInPixels * maxAutoSwatchImageDimensionInPixels) {
             setFailureMessage(tr("Exceeded maximum image dimensions (%1 x %1) supported by the auto swatch feature.")
                 .arg(maxAutoSwatchImageDimensionInPixels));
@@ -244,7 +249,7 @@ void AutoSwatchModel::updateColours()
         mAutoSwatchWorkerThread.start();
 
         const bool invokeSucceeded = QMetaObject::invokeMethod(&mAutoSwatchWorker, "findUniqueColours",
-            Qt::QueuedConnection, Q_ARG(QImage, mCanvas->project()->exportedImage()));
+            Qt::QueuedConnection, Q_ARG(QImage, exportedImage));
         Q_ASSERT(invokeSucceeded);
     } else {
         qCDebug(lcAutoSwatchModel) << "no canvas/project; clearing model";
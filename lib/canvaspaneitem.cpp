@@ -25,6 +25,7 @@
 #include "imageutils.h"
 #include "panedrawinghelper.h"
 #include "project.h"
+#include "tracer.h"
 
 #include <QPainter>
 
@@ -115,6 +116,7 @@ void CanvasPaneItem::itemChange(QQuickItem::ItemChange change, const QQuickItem:
 void CanvasPaneItem::connectToCanvas()
 {
     connect(mCanvas, &ImageCanvas::contentPaintRequested, this, &CanvasPaneItem::onContentPaintRequested);
+    connect(mCanvas, &ImageCanvas::contentRectPaintRequested, this, &CanvasPaneItem::onContentRectPaintRequested);
 
     // Fixes a problem where the second pane wasn't rendered when splitting the screen.
     update();
@@ -133,8 +135,19 @@ void CanvasPaneItem::onContentPaintRequested(int paneIndex)
     }
 }
 
+void CanvasPaneItem::onContentRectPaintRequested(const QRect &sceneRect)
+{
+    // Map the rect from scene coordinates to our own.
+    const QRect zoomedRect(sceneRect.topLeft() * mPane->integerZoomLevel() + mPane->integerOffset(),
+        mPane->zoomedSize(sceneRect.size()));
+    update(zoomedRect);
+}
+
 void CanvasPaneItem::paint(QPainter *painter)
 {
+    SLATE_TRACE_SCOPE("paint", "CanvasPaneItem::paint");
+    const FrameTimings::ScopedStageTimer stageTimer(mCanvas->frameTimings(), FrameTimings::PaintStage);
+
     if (!mCanvas->project() || !mCanvas->project()->hasLoaded())
         return;
 
@@ -145,7 +158,26 @@ void CanvasPaneItem::paint(QPainter *painter)
     const QSize zoomedCanvasSize = mPane->zoomedSize(mCanvas->currentProjectImage()->size());
     painter->drawTiledPixmap(0, 0, zoomedCanvasSize.width(), zoomedCanvasSize.height(), mCanvas->mCheckerPixmap);
 
-    const QImage image = mCanvas->contentImage();
+    mCanvas->updateContentImage();
+    const QImage image = mCanvas->mCachedContentImage;
+    const QVector<ImageCanvas::SelectionPreviewPatch> patches = mCanvas->mCachedSelectionPreviewPatches;
     const QSize zoomedImageSize = mPane->zoomedSize(image.size());
+    if (patches.isEmpty()) {
+        painter->drawImage(QRectF(QPointF(0, 0), zoomedImageSize), image, QRectF(0, 0, image.width(), image.height()));
+        return;
+    }
+
+    // The selection preview replaces the pixels of the image within its bounds,
+    // so draw the image around it and then the preview on its own.
+    QRegion imageClipRegion(QRect(QPoint(0, 0), zoomedImageSize));
+    for (const ImageCanvas::SelectionPreviewPatch &patch : patches)
+        imageClipRegion -= QRect(patch.pos * mPane->integerZoomLevel(), mPane->zoomedSize(patch.image.size()));
+    painter->save();
+    painter->setClipRegion(imageClipRegion, Qt::IntersectClip);
     painter->drawImage(QRectF(QPointF(0, 0), zoomedImageSize), image, QRectF(0, 0, image.width(), image.height()));
+    painter->restore();
+    for (const ImageCanvas::SelectionPreviewPatch &patch : patches) {
+        const QRect zoomedPatchRect(patch.pos * mPane->integerZoomLevel(), mPane->zoomedSize(patch.image.size()));
+        painter->drawImage(QRectF(zoomedPatchRect), patch.image, QRectF(patch.image.rect()));
+    }
 }
@@ -69,6 +69,7 @@ protected:
 
 protected slots:
     void onContentPaintRequested(int paneIndex);
+    void onContentRectPaintRequested(const QRect &sceneRect);
 
 protected:
     ImageCanvas *mCanvas = nullptr;
@@ -57,6 +57,11 @@ bool ChangeImageCanvasSizeCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ChangeImageCanvasSizeCommand::heldImages() const
+{
+    return { mPreviousImage, mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const ChangeImageCanvasSizeCommand *command)
 {
     QDebugStateSaver saver(debug);
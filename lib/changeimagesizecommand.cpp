@@ -57,6 +57,11 @@ bool ChangeImageSizeCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ChangeImageSizeCommand::heldImages() const
+{
+    return { mPreviousImage, mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const ChangeImageSizeCommand *command)
 {
     QDebugStateSaver saver(debug);
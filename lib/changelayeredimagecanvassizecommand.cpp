@@ -57,6 +57,11 @@ bool ChangeLayeredImageCanvasSizeCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ChangeLayeredImageCanvasSizeCommand::heldImages() const
+{
+    return mPreviousImages + mNewImages;
+}
+
 QDebug operator<<(QDebug debug, const ChangeLayeredImageCanvasSizeCommand *)
 {
     debug.nospace() << "(ChangeLayeredImageCanvasSizeCommand)";
@@ -57,6 +57,11 @@ bool ChangeLayeredImageSizeCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ChangeLayeredImageSizeCommand::heldImages() const
+{
+    return mPreviousImages + mNewImages;
+}
+
 QDebug operator<<(QDebug debug, const ChangeLayeredImageSizeCommand *)
 {
     debug.nospace() << "(ChangeLayeredImageSizeCommand)";
@@ -44,6 +44,11 @@ int ClipboardImage::height() const
     return mImage.height();
 }
 
+QImage ClipboardImage::image() const
+{
+    return mImage;
+}
+
 void ClipboardImage::setImage(const QImage &image)
 {
     mImage = image;
@@ -65,18 +70,24 @@ ClipboardImage *Clipboard::image() const
     return mClipboardImage;
 }
 
-QVector<QImage> Clipboard::copiedLayerImages() const
+QVector<CopiedLayerImage> Clipboard::copiedLayerImages() const
 {
     return mCopiedLayers;
 }
 
+QSize Clipboard::copiedLayerAreaSize() const
+{
+    return mCopiedLayerAreaSize;
+}
+
 int Clipboard::copiedLayerCount() const
 {
     return mCopiedLayers.size();
 }
 
-void Clipboard::setCopiedLayerImages(const QVector<QImage> &copiedLayers)
+void Clipboard::setCopiedLayerImages(const QSize &copiedAreaSize, const QVector<CopiedLayerImage> &copiedLayers)
 {
+    mCopiedLayerAreaSize = copiedAreaSize;
     mCopiedLayers = copiedLayers;
     emit copiedLayersChanged();
 }
@@ -22,6 +22,7 @@
 
 #include <QImage>
 #include <QObject>
+#include <QPoint>
 #include <QQmlEngine>
 
 #include "slate-global.h"
@@ -43,12 +44,23 @@ public:
     int width() const;
     int height() const;
 
+    QImage image() const;
     void setImage(const QImage &image);
 
 private:
     QImage mImage;
 };
 
+// The contents of one layer within the area copied by Copy Across Layers,
+// cropped to the pixels that aren't erased. The image is null if the layer
+// had nothing within that area.
+struct CopiedLayerImage
+{
+    QImage image;
+    // The position of image relative to the top left of the copied area.
+    QPoint offset;
+};
+
 class SLATE_EXPORT Clipboard : public QObject
 {
     Q_OBJECT
@@ -63,9 +75,11 @@ public:
     Q_INVOKABLE ClipboardImage *image() const;
 
     // Returns the copied layer images that were copied by Copy Across Layers.
-    QVector<QImage> copiedLayerImages() const;
+    QVector<CopiedLayerImage> copiedLayerImages() const;
+    // Returns the size of the area that was copied by Copy Across Layers.
+    QSize copiedLayerAreaSize() const;
     int copiedLayerCount() const;
-    void setCopiedLayerImages(const QVector<QImage> &copiedLayers);
+    void setCopiedLayerImages(const QSize &copiedAreaSize, const QVector<CopiedLayerImage> &copiedLayers);
 
     static Clipboard *instance();
     static QObject *qmlInstance(QQmlEngine *qmlEngine, QJSEngine *jsEngine);
@@ -75,7 +89,8 @@ signals:
 
 private:
     ClipboardImage *mClipboardImage = nullptr;
-    QVector<QImage> mCopiedLayers;
+    QSize mCopiedLayerAreaSize;
+    QVector<CopiedLayerImage> mCopiedLayers;
 };
 
 #endif // CLIPBOARD_H
@@ -6,7 +6,6 @@ enum {
     ApplyPixelEraserCommandId = 1,
     ApplyPixelFillCommandId,
     ApplyPixelLineCommandId,
-    ApplyPixelPenCommandId,
     ApplyTileEraserCommandId,
     ApplyTileFillCommandId,
     ApplyTilePenCommandId
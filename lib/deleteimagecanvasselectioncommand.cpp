@@ -59,6 +59,11 @@ bool DeleteImageCanvasSelectionCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> DeleteImageCanvasSelectionCommand::heldImages() const
+{
+    return { mDeletedAreaImagePortion };
+}
+
 QDebug operator<<(QDebug debug, const DeleteImageCanvasSelectionCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -61,6 +61,14 @@ bool DeleteLayerCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> DeleteLayerCommand::heldImages() const
+{
+    // The layer is only ours while it's deleted; otherwise it's counted as part of the project.
+    if (mLayerGuard)
+        return { *mLayerGuard->image() };
+    return {};
+}
+
 QDebug operator<<(QDebug debug, const DeleteLayerCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -63,6 +63,14 @@ bool DuplicateLayerCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> DuplicateLayerCommand::heldImages() const
+{
+    // The layer is only ours while the command is undone.
+    if (mLayerGuard)
+        return { *mLayerGuard->image() };
+    return {};
+}
+
 QDebug operator<<(QDebug debug, const DuplicateLayerCommand *command)
 {
     QDebugStateSaver saver(debug);
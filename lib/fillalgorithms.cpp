@@ -19,6 +19,7 @@
 
 #include "fillalgorithms.h"
 
+#include <QBitArray>
 #include <QDebug>
 #include <QColor>
 #include <QImage>
@@ -369,67 +370,126 @@ QImage greedyTexturedFill(const QImage *image, const QPoint &startPos, const QCo
     return imageGreedyPixelFill(image, startPos, targetColour, replacementColour, SwatchTextureFillColourProvider(parameters));
 }
 
-// TODO: convert these to non-recursive algorithms as above
-void tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
-    const QColor &replacementColour, QVector<QPoint> &filledPositions)
+// Fills the 4-connected area of cells in a grid of the given size that
+// matches() accepts, calling fill() once for each of them. Each iteration
+// fills a whole horizontal span and then seeds one cell for every run of
+// fillable cells directly above and below it, so the work done is
+// proportional to the filled area and no recursion is needed.
+template<typename MatchesFunction, typename FillFunction>
+static void spanFloodFill(const QSize &size, const QPoint &startPos, MatchesFunction matches, FillFunction fill)
 {
-    qCDebug(lcPixelFloodFill) << "attempting to fill pixel at" << pos << "...";
+    const int width = size.width();
+    QBitArray visited(width * size.height());
+    const auto fillable = [&](int x, int y) {
+        return !visited.testBit(y * width + x) && matches(x, y);
+    };
+
+    QVector<QPoint> seeds;
+    seeds.append(startPos);
+    while (!seeds.isEmpty()) {
+        const QPoint seed = seeds.takeLast();
+        const int y = seed.y();
+        // The cell may have been filled by another span since it was seeded.
+        if (!fillable(seed.x(), y))
+            continue;
+
+        int left = seed.x();
+        while (left > 0 && fillable(left - 1, y))
+            --left;
+
+        int right = seed.x();
+        while (right < width - 1 && fillable(right + 1, y))
+            ++right;
+
+        for (int x = left; x <= right; ++x) {
+            visited.setBit(y * width + x);
+            fill(x, y);
+        }
 
-    if (filledPositions.contains(pos)) {
-        // This tile has already been filled (would this ever happen?)
-        qCDebug(lcPixelFloodFill) << "already filled";
-        return;
+        for (const int adjacentY : { y - 1, y + 1 }) {
+            if (adjacentY < 0 || adjacentY >= size.height())
+                continue;
+
+            bool inRun = false;
+            for (int x = left; x <= right; ++x) {
+                const bool adjacentFillable = fillable(x, adjacentY);
+                if (adjacentFillable && !inRun)
+                    seeds.append(QPoint(x, adjacentY));
+                inRun = adjacentFillable;
+            }
+        }
+    }
+}
+
+static bool canFillTilePixel(const Tile *tile, const QPoint &pos, const QColor &targetColour,
+    const QColor &replacementColour)
+{
+    const QRect tileBounds(QPoint(0, 0), tile->sourceRect().size());
+    if (!tileBounds.contains(pos)) {
+        qCDebug(lcPixelFloodFill) << pos << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
+        return false;
     }
 
     if (tile->pixelColor(pos) == replacementColour) {
         qCDebug(lcPixelFloodFill) << "hit the same colour as replacement colour; returning";
-        return;
+        return false;
     }
 
     if (tile->pixelColor(pos) != targetColour) {
         qCDebug(lcPixelFloodFill) << "hit a different colour; returning";
-        return;
+        return false;
     }
 
-    qCDebug(lcPixelFloodFill) << "filling!";
-    filledPositions.append(pos);
+    return true;
+}
 
-    const QRect tileBounds(0, 0, tile->sourceRect().width(), tile->sourceRect().height());
-    const QPoint north = pos - QPoint(0, 1);
-    const QPoint south = pos + QPoint(0, 1);
-    const QPoint east = pos + QPoint(1, 0);
-    const QPoint west = pos - QPoint(1, 0);
+void tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
+    const QColor &replacementColour, QVector<QPoint> &filledPositions)
+{
+    qCDebug(lcPixelFloodFill) << "attempting to fill starting with pixel at" << pos << "...";
 
-    if (tileBounds.contains(north)) {
-        tilesetPixelFloodFill(tile, north, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << north << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
-    if (tileBounds.contains(south)) {
-        tilesetPixelFloodFill(tile, south, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << south << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
-    if (tileBounds.contains(east)) {
-        tilesetPixelFloodFill(tile, east, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << east << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
-    if (tileBounds.contains(west)) {
-        tilesetPixelFloodFill(tile, west, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << west << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
+    if (!canFillTilePixel(tile, pos, targetColour, replacementColour))
+        return;
+
+    // Compare the raw pixel values rather than going through QColor for each pixel.
+    const QImage *image = tile->tileset()->image();
+    const QPoint tileTopLeft = tile->sourceRect().topLeft();
+    const QRgb targetRgb = image->pixel(tileTopLeft + pos);
+    spanFloodFill(tile->sourceRect().size(), pos,
+        [&](int x, int y) { return image->pixel(tileTopLeft.x() + x, tileTopLeft.y() + y) == targetRgb; },
+        [&](int x, int y) { filledPositions.append(QPoint(x, y)); });
+
+    qCDebug(lcPixelFloodFill) << "... filled" << filledPositions.size() << "pixels.";
+}
+
+void tilesetGreedyPixelFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
+    const QColor &replacementColour, QVector<QPoint> &filledPositions)
+{
+    qCDebug(lcPixelFloodFill) << "attempting to greedily fill starting with pixel at" << pos << "...";
+
+    if (!canFillTilePixel(tile, pos, targetColour, replacementColour))
+        return;
+
+    const QImage *image = tile->tileset()->image();
+    const QRect sourceRect = tile->sourceRect();
+    const QRgb targetRgb = image->pixel(sourceRect.topLeft() + pos);
+    for (int y = 0; y < sourceRect.height(); ++y) {
+        for (int x = 0; x < sourceRect.width(); ++x) {
+            if (image->pixel(sourceRect.x() + x, sourceRect.y() + y) == targetRgb)
+                filledPositions.append(QPoint(x, y));
+        }
     }
+
+    qCDebug(lcPixelFloodFill) << "... filled" << filledPositions.size() << "pixels.";
 }
 
-void tilesetTileFloodFill(const TilesetProject *project, const Tile *tile, const QPoint &tilePos,
-    int targetTile, int replacementTile, QVector<QPoint> &filledTilePositions)
+void tilesetTileFloodFill(const TilesetProject *project, const QPoint &tilePos, int targetTile,
+    int replacementTile, QVector<QPoint> &filledTilePositions)
 {
-    qCDebug(lcTileFloodFill) << "attempting to fill pixel at" << tilePos << "...";
+    qCDebug(lcTileFloodFill) << "attempting to fill starting with tile at" << tilePos << "...";
 
-    if (filledTilePositions.contains(tilePos)) {
-        // This tile has already been filled (would this ever happen?)
-        qCDebug(lcTileFloodFill) << "already filled";
+    if (!project->isTilePosWithinBounds(tilePos)) {
+        qCDebug(lcTileFloodFill) << tilePos << "is out of bounds";
         return;
     }
 
@@ -440,36 +500,18 @@ void tilesetTileFloodFill(const TilesetProject *project, const Tile *tile, const
     }
 
     if (tileIdAtTilePos != targetTile) {
-        qCDebug(lcTileFloodFill) << "hit a different colour; returning";
+        qCDebug(lcTileFloodFill) << "hit a different tile; returning";
         return;
     }
 
-    qCDebug(lcTileFloodFill) << "filling!";
-    filledTilePositions.append(tilePos);
+    // Work on the tile ids directly; this is much cheaper than looking
+    // up the Tile for every position.
+    const QVector<int> tiles = project->tiles();
+    const int tilesWide = project->tilesWide();
+    const int startTileId = tiles.at(tilePos.y() * tilesWide + tilePos.x());
+    spanFloodFill(QSize(tilesWide, project->tilesHigh()), tilePos,
+        [&](int x, int y) { return tiles.at(y * tilesWide + x) == startTileId; },
+        [&](int x, int y) { filledTilePositions.append(QPoint(x, y)); });
 
-    const QPoint north = tilePos - QPoint(0, 1);
-    const QPoint south = tilePos + QPoint(0, 1);
-    const QPoint east = tilePos + QPoint(1, 0);
-    const QPoint west = tilePos - QPoint(1, 0);
-
-    if (project->isTilePosWithinBounds(north)) {
-        tilesetTileFloodFill(project, tile, north, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << north << "is out of bounds";
-    }
-    if (project->isTilePosWithinBounds(south)) {
-        tilesetTileFloodFill(project, tile, south, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << south << "is out of bounds";
-    }
-    if (project->isTilePosWithinBounds(east)) {
-        tilesetTileFloodFill(project, tile, east, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << east << "is out of bounds";
-    }
-    if (project->isTilePosWithinBounds(west)) {
-        tilesetTileFloodFill(project, tile, west, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << west << "is out of bounds";
-    }
+    qCDebug(lcTileFloodFill) << "... filled" << filledTilePositions.size() << "tiles.";
 }
@@ -23,6 +23,8 @@
 #include <QString>
 #include <QtContainerFwd>
 
+#include "slate-global.h"
+
 class QColor;
 class QImage;
 class QPoint;
@@ -31,7 +33,7 @@ class TexturedFillParameters;
 class TilesetProject;
 class Tile;
 
-class FillColourProvider
+class SLATE_EXPORT FillColourProvider
 {
 public:
     virtual QColor colour(const QColor &baseColour) const;
@@ -49,13 +51,13 @@ public:
     virtual QString debugName() const;
 };
 
-QImage imagePixelFloodFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
+SLATE_EXPORT QImage imagePixelFloodFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
     const QColor &replacementColour, const FillColourProvider &fillColourProvider = FillColourProvider());
 
-QImage imageGreedyPixelFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
+SLATE_EXPORT QImage imageGreedyPixelFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
     const QColor &replacementColour, const FillColourProvider &fillColourProvider = FillColourProvider());
 
-QImage texturedFill(const QImage *image, const QPoint &startPos,
+SLATE_EXPORT QImage texturedFill(const QImage *image, const QPoint &startPos,
     const QColor &targetColour, const QColor &replacementColour, const TexturedFillParameters &parameters);
 
 QImage greedyTexturedFill(const QImage *image, const QPoint &startPos,
@@ -64,7 +66,10 @@ QImage greedyTexturedFill(const QImage *image, const QPoint &startPos,
 void tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
     const QColor &replacementColour, QVector<QPoint> &filledPositions);
 
-void tilesetTileFloodFill(const TilesetProject *project, const Tile *tile, const QPoint &tilePos, int targetTile,
+void tilesetGreedyPixelFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
+    const QColor &replacementColour, QVector<QPoint> &filledPositions);
+
+void tilesetTileFloodFill(const TilesetProject *project, const QPoint &tilePos, int targetTile,
     int replacementTile, QVector<QPoint> &filledTilePositions);
 
 #endif // FILLALGORITHMS_H
@@ -0,0 +1,242 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "frametimings.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcFrameTimings, "app.frameTimings")
+
+// Two seconds' worth of frames at 60 FPS.
+static const int maxRecentFrames = 120;
+static const int maxSlowestFrames = 5;
+// How often the snapshot that QML sees is updated.
+static const int publishIntervalMs = 500;
+static const int histogramBounds[] = { 8, 17, 33, 50, 100 };
+
+static qreal toMs(qint64 nsecs)
+{
+    return nsecs / 1000000.0;
+}
+
+FrameTimings::ScopedStageTimer::ScopedStageTimer(FrameTimings *timings, Stage stage) :
+    mTimings(timings && timings->isEnabled() ? timings : nullptr),
+    mStage(stage)
+{
+    if (mTimings)
+        mTimer.start();
+}
+
+FrameTimings::ScopedStageTimer::~ScopedStageTimer()
+{
+    if (mTimings)
+        mTimings->addStageSample(mStage, mTimer.nsecsElapsed());
+}
+
+FrameTimings::FrameTimings(QObject *parent) :
+    QObject(parent)
+{
+    reset();
+}
+
+FrameTimings::~FrameTimings()
+{
+}
+
+bool FrameTimings::isEnabled() const
+{
+    return mEnabled.loadRelaxed() != 0;
+}
+
+void FrameTimings::setEnabled(bool enabled)
+{
+    if (enabled == isEnabled())
+        return;
+
+    qCDebug(lcFrameTimings) << "setting enabled to" << enabled;
+
+    // Start from scratch so that stale frames from a previous session don't skew the results.
+    reset();
+    mEnabled.storeRelaxed(enabled ? 1 : 0);
+    emit enabledChanged();
+    emit timingsChanged();
+}
+
+void FrameTimings::addStageSample(Stage stage, qint64 nsecsElapsed)
+{
+    QMutexLocker locker(&mMutex);
+    mCurrentFrame.stageDurations[stage] += nsecsElapsed;
+}
+
+void FrameTimings::endFrame()
+{
+    if (!isEnabled())
+        return;
+
+    bool shouldPublish = false;
+    {
+        QMutexLocker locker(&mMutex);
+        // restart() returns milliseconds, but everything else is in nanoseconds.
+        mCurrentFrame.duration = mFrameTimer.nsecsElapsed();
+        mFrameTimer.restart();
+
+        if (mRecentFrames.size() < maxRecentFrames)
+            mRecentFrames.append(mCurrentFrame);
+        else
+            mRecentFrames[mNextFrameIndex] = mCurrentFrame;
+        mNextFrameIndex = (mNextFrameIndex + 1) % maxRecentFrames;
+        mCurrentFrame = Frame();
+
+        shouldPublish = mPublishTimer.elapsed() >= publishIntervalMs;
+    }
+
+    if (shouldPublish)
+        publish();
+}
+
+qreal FrameTimings::frameTime() const
+{
+    return mFrameTime;
+}
+
+qreal FrameTimings::contentImageTime() const
+{
+    return stageTime(ContentImageStage);
+}
+
+qreal FrameTimings::paintTime() const
+{
+    return stageTime(PaintStage);
+}
+
+qreal FrameTimings::toolTime() const
+{
+    return stageTime(ToolStage);
+}
+
+qreal FrameTimings::undoPushTime() const
+{
+    return stageTime(UndoPushStage);
+}
+
+qreal FrameTimings::stageTime(Stage stage) const
+{
+    return mStageTimes.at(stage);
+}
+
+QVariantList FrameTimings::frameTimeHistogram() const
+{
+    return mFrameTimeHistogram;
+}
+
+QVariantList FrameTimings::frameTimeHistogramBounds() const
+{
+    QVariantList bounds;
+    for (const int bound : histogramBounds)
+        bounds.append(bound);
+    return bounds;
+}
+
+QVariantList FrameTimings::slowestFrames() const
+{
+    return mSlowestFrames;
+}
+
+void FrameTimings::reset()
+{
+    {
+        QMutexLocker locker(&mMutex);
+        mCurrentFrame = Frame();
+        mRecentFrames.clear();
+        mRecentFrames.reserve(maxRecentFrames);
+        mNextFrameIndex = 0;
+        mFrameTimer.start();
+        mPublishTimer.start();
+    }
+
+    mFrameTime = 0;
+    mStageTimes.fill(0);
+    mFrameTimeHistogram.clear();
+    for (int i = 0; i <= int(std::size(histogramBounds)); ++i)
+        mFrameTimeHistogram.append(0);
+    mSlowestFrames.clear();
+}
+
+void FrameTimings::publish()
+{
+    QVector<Frame> frames;
+    {
+        QMutexLocker locker(&mMutex);
+        frames = mRecentFrames;
+        mPublishTimer.restart();
+    }
+
+    if (frames.isEmpty())
+        return;
+
+    qint64 totalFrameDuration = 0;
+    std::array<qint64, stageCount> totalStageDurations {};
+    std::array<int, stageCount> stageFrameCounts {};
+    QVector<int> histogram(int(std::size(histogramBounds)) + 1, 0);
+    for (const Frame &frame : qAsConst(frames)) {
+        totalFrameDuration += frame.duration;
+
+        for (int stage = 0; stage < stageCount; ++stage) {
+            if (frame.stageDurations.at(stage) > 0) {
+                totalStageDurations[stage] += frame.stageDurations.at(stage);
+                ++stageFrameCounts[stage];
+            }
+        }
+
+        const qreal frameMs = toMs(frame.duration);
+        const auto boundIt = std::upper_bound(std::begin(histogramBounds), std::end(histogramBounds), frameMs);
+        ++histogram[int(std::distance(std::begin(histogramBounds), boundIt))];
+    }
+
+    mFrameTime = toMs(totalFrameDuration) / frames.size();
+    for (int stage = 0; stage < stageCount; ++stage) {
+        mStageTimes[stage] = stageFrameCounts.at(stage) > 0
+            ? toMs(totalStageDurations.at(stage)) / stageFrameCounts.at(stage) : 0;
+    }
+
+    mFrameTimeHistogram.clear();
+    for (const int count : qAsConst(histogram))
+        mFrameTimeHistogram.append(count);
+
+    const int slowestFrameCount = qMin(maxSlowestFrames, int(frames.size()));
+    std::partial_sort(frames.begin(), frames.begin() + slowestFrameCount, frames.end(),
+        [](const Frame &a, const Frame &b) { return a.duration > b.duration; });
+
+    mSlowestFrames.clear();
+    for (int i = 0; i < slowestFrameCount; ++i) {
+        const Frame &frame = frames.at(i);
+        QVariantMap frameMap;
+        frameMap.insert(QLatin1String("frameTime"), toMs(frame.duration));
+        frameMap.insert(QLatin1String("contentImageTime"), toMs(frame.stageDurations.at(ContentImageStage)));
+        frameMap.insert(QLatin1String("paintTime"), toMs(frame.stageDurations.at(PaintStage)));
+        frameMap.insert(QLatin1String("toolTime"), toMs(frame.stageDurations.at(ToolStage)));
+        frameMap.insert(QLatin1String("undoPushTime"), toMs(frame.stageDurations.at(UndoPushStage)));
+        mSlowestFrames.append(frameMap);
+    }
+
+    emit timingsChanged();
+}
@@ -0,0 +1,150 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMETIMINGS_H
+#define FRAMETIMINGS_H
+
+#include <array>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QQmlEngine>
+#include <QVariantList>
+#include <QVector>
+
+#include "slate-global.h"
+
+/*
+    Keeps rolling timings of the stages that go into producing a frame of the
+    canvas so that the frame-time overlay can show where time is being spent.
+
+    Nothing is recorded unless enabled is true, in which case each stage costs
+    two QElapsedTimer reads and an uncontended mutex lock.
+
+    A frame is the time between two QQuickWindow::afterAnimating() emissions,
+    which the owning canvas reports via endFrame(). Stages can overlap (e.g.
+    PaintStage includes ContentImageStage), so their sum isn't the frame time.
+*/
+class SLATE_EXPORT FrameTimings : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(qreal frameTime READ frameTime NOTIFY timingsChanged)
+    Q_PROPERTY(qreal contentImageTime READ contentImageTime NOTIFY timingsChanged)
+    Q_PROPERTY(qreal paintTime READ paintTime NOTIFY timingsChanged)
+    Q_PROPERTY(qreal toolTime READ toolTime NOTIFY timingsChanged)
+    Q_PROPERTY(qreal undoPushTime READ undoPushTime NOTIFY timingsChanged)
+    Q_PROPERTY(QVariantList frameTimeHistogram READ frameTimeHistogram NOTIFY timingsChanged)
+    Q_PROPERTY(QVariantList frameTimeHistogramBounds READ frameTimeHistogramBounds CONSTANT)
+    Q_PROPERTY(QVariantList slowestFrames READ slowestFrames NOTIFY timingsChanged)
+    QML_ANONYMOUS
+
+public:
+    enum Stage {
+        // ImageCanvas::getContentImage(), i.e. compositing.
+        ContentImageStage,
+        // CanvasPaneItem::paint().
+        PaintStage,
+        // ImageCanvas::applyCurrentTool().
+        ToolStage,
+        // Project::addChange().
+        UndoPushStage
+    };
+    Q_ENUM(Stage)
+
+    static const int stageCount = UndoPushStage + 1;
+
+    // Records the time between its construction and destruction as a sample
+    // for the given stage, if timings is non-null and enabled.
+    class ScopedStageTimer
+    {
+    public:
+        ScopedStageTimer(FrameTimings *timings, Stage stage);
+        ~ScopedStageTimer();
+
+        Q_DISABLE_COPY(ScopedStageTimer)
+
+    private:
+        FrameTimings *mTimings;
+        Stage mStage;
+        QElapsedTimer mTimer;
+    };
+
+    explicit FrameTimings(QObject *parent = nullptr);
+    ~FrameTimings() override;
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    void addStageSample(Stage stage, qint64 nsecsElapsed);
+    void endFrame();
+
+    // All times are in milliseconds and are averaged over the recent frames.
+    // Stage times only count the frames in which that stage occurred.
+    qreal frameTime() const;
+    qreal contentImageTime() const;
+    qreal paintTime() const;
+    qreal toolTime() const;
+    qreal undoPushTime() const;
+    qreal stageTime(Stage stage) const;
+
+    // The number of recent frames that fall into each bucket of frameTimeHistogramBounds.
+    QVariantList frameTimeHistogram() const;
+    // The exclusive upper bound, in milliseconds, of each histogram bucket.
+    // The last bucket has no upper bound.
+    QVariantList frameTimeHistogramBounds() const;
+    // The slowest recent frames, slowest first. Each is a map containing
+    // "frameTime" and the time of each stage within that frame.
+    QVariantList slowestFrames() const;
+
+signals:
+    void enabledChanged();
+    void timingsChanged();
+
+private:
+    struct Frame
+    {
+        qint64 duration = 0;
+        std::array<qint64, stageCount> stageDurations {};
+    };
+
+    void reset();
+    void publish();
+
+    QAtomicInt mEnabled;
+
+    // Guards the members up to the snapshots below, since paint() can be
+    // called on the render thread.
+    mutable QMutex mMutex;
+    QElapsedTimer mFrameTimer;
+    QElapsedTimer mPublishTimer;
+    Frame mCurrentFrame;
+    QVector<Frame> mRecentFrames;
+    int mNextFrameIndex = 0;
+
+    // Snapshots taken by publish() on the GUI thread, so that QML can read them cheaply.
+    qreal mFrameTime = 0;
+    std::array<qreal, stageCount> mStageTimes {};
+    QVariantList mFrameTimeHistogram;
+    QVariantList mSlowestFrames;
+};
+
+#endif // FRAMETIMINGS_H
@@ -36,7 +36,6 @@
 #include "applypixelerasercommand.h"
 #include "applypixelfillcommand.h"
 #include "applypixellinecommand.h"
-#include "applypixelpencommand.h"
 #include "changenotecommand.h"
 #include "deleteguidescommand.h"
 #include "deletenotecommand.h"
@@ -45,22 +44,26 @@
 #include "flipimagecanvasselectioncommand.h"
 #include "imageproject.h"
 #include "imageutils.h"
+#include "inputrecorder.h"
 #include "jsonutils.h"
 #include "modifyimagecanvasselectioncommand.h"
 #include "moveguidecommand.h"
 #include "note.h"
 #include "panedrawinghelper.h"
 #include "pasteimagecanvascommand.h"
+#include "pixelbrush.h"
 #include "project.h"
 #include "projectutils.h"
 #include "qtutils.h"
 #include "tileset.h"
+#include "tracer.h"
 
 Q_LOGGING_CATEGORY(lcImageCanvas, "app.canvas")
 Q_LOGGING_CATEGORY(lcImageCanvasCursorPos, "app.canvas.cursorpos")
 Q_LOGGING_CATEGORY(lcImageCanvasCursorShape, "app.canvas.cursorshape")
 Q_LOGGING_CATEGORY(lcImageCanvasEvents, "app.canvas.events")
 Q_LOGGING_CATEGORY(lcImageCanvasHoverEvents, "app.canvas.events.hover")
+Q_LOGGING_CATEGORY(lcImageCanvasLatency, "app.canvas.latency")
 Q_LOGGING_CATEGORY(lcImageCanvasFocusEvents, "app.canvas.events.focus")
 Q_LOGGING_CATEGORY(lcImageCanvasLifecycle, "app.canvas.lifecycle")
 Q_LOGGING_CATEGORY(lcImageCanvasGuides, "app.canvas.guides")
@@ -103,6 +106,7 @@ ImageCanvas::ImageCanvas() :
     mGuidePositionBeforePress(0),
     mPressedGuideIndex(-1),
     mPressedNoteIndex(-1),
+    mContentImageDirty(true),
     mCursorX(0),
     mCursorY(0),
     mCursorPaneX(0),
@@ -165,6 +169,9 @@ ImageCanvas::ImageCanvas() :
     connect(&mSecondPane, SIGNAL(sizeChanged()), this, SLOT(onPaneSizeChanged()));
     connect(&mSplitter, SIGNAL(positionChanged()), this, SLOT(onSplitterPositionChanged()));
 
+    QQmlEngine::setObjectOwnership(&mFrameTimings, QQmlEngine::CppOwnership);
+    connect(&mFrameTimings, &FrameTimings::enabledChanged, this, &ImageCanvas::onFrameTimingsEnabledChanged);
+
     recreateCheckerImage();
 
     qCDebug(lcImageCanvasLifecycle) << "constructing ImageCanvas" << this;
@@ -281,6 +288,7 @@ void ImageCanvas::setProject(Project *project)
 
     mProject = project;
     mImageProject = qobject_cast<ImageProject*>(mProject);
+    mContentImageDirty = true;
 
     if (mProject) {
         connectSignals();
@@ -561,6 +569,10 @@ void ImageCanvas::setTool(const Tool &tool)
     if (tool == mTool)
         return;
 
+    applyPendingStrokePoints();
+
+    const bool wasLineVisible = isLineVisible();
+
     mTool = tool;
 
     // The selection tool doesn't follow the undo rules, so we have to clear
@@ -573,6 +585,10 @@ void ImageCanvas::setTool(const Tool &tool)
 
     toolChange();
 
+    // The line is drawn as part of the content image.
+    if (isLineVisible() != wasLineVisible)
+        onContentChanged();
+
     emit toolChanged();
 }
 
@@ -920,6 +936,11 @@ Splitter *ImageCanvas::splitter()
     return &mSplitter;
 }
 
+FrameTimings *ImageCanvas::frameTimings()
+{
+    return &mFrameTimings;
+}
+
 QColor ImageCanvas::mapBackgroundColour() const
 {
     return mBackgroundColour;
@@ -979,6 +1000,11 @@ void ImageCanvas::setAltPressed(bool altPressed)
     emit altPressedChanged();
 }
 
+bool ImageCanvas::isShiftPressed() const
+{
+    return mShiftPressed;
+}
+
 void ImageCanvas::setShiftPressed(bool shiftPressed)
 {
     if (shiftPressed == mShiftPressed)
@@ -996,7 +1022,7 @@ void ImageCanvas::setShiftPressed(bool shiftPressed)
         emit lineChanged();
     }
 
-    requestContentPaint();
+    onContentChanged();
 }
 
 void ImageCanvas::connectSignals()
@@ -1004,16 +1030,18 @@ void ImageCanvas::connectSignals()
     qCDebug(lcImageCanvas) << "connecting signals for" << this << "as we have a new project" << mProject;
 
     connect(mProject, SIGNAL(loadedChanged()), this, SLOT(onLoadedChanged()));
-    connect(mProject, SIGNAL(projectCreated()), this, SLOT(requestContentPaint()));
+    connect(mProject, SIGNAL(projectCreated()), this, SLOT(onContentChanged()));
     connect(mProject, SIGNAL(projectClosed()), this, SLOT(reset()));
-    connect(mProject, SIGNAL(sizeChanged()), this, SLOT(requestContentPaint()));
+    connect(mProject, SIGNAL(sizeChanged()), this, SLOT(onContentChanged()));
     connect(mProject, SIGNAL(notesChanged()), this, SLOT(onNotesChanged()));
     connect(mProject, SIGNAL(preProjectSaved()), this, SLOT(saveState()));
     connect(mProject, SIGNAL(aboutToBeginMacro(QString)),
         this, SLOT(onAboutToBeginMacro(QString)));
-    connect(mProject, SIGNAL(contentsModified()), this, SLOT(requestContentPaint()));
+    connect(mProject, SIGNAL(contentsModified()), this, SLOT(onContentChanged()));
 
     connect(window(), SIGNAL(activeFocusItemChanged()), this, SLOT(updateWindowCursorShape()));
+
+    mProject->setFrameTimings(&mFrameTimings);
 }
 
 void ImageCanvas::disconnectSignals()
@@ -1021,14 +1049,16 @@ void ImageCanvas::disconnectSignals()
     qCDebug(lcImageCanvas) << "disconnecting signals for" << this;
 
     mProject->disconnect(SIGNAL(loadedChanged()), this, SLOT(onLoadedChanged()));
-    mProject->disconnect(SIGNAL(projectCreated()), this, SLOT(requestContentPaint()));
+    mProject->disconnect(SIGNAL(projectCreated()), this, SLOT(onContentChanged()));
     mProject->disconnect(SIGNAL(projectClosed()), this, SLOT(reset()));
-    mProject->disconnect(SIGNAL(sizeChanged()), this, SLOT(requestContentPaint()));
+    mProject->disconnect(SIGNAL(sizeChanged()), this, SLOT(onContentChanged()));
     mProject->disconnect(SIGNAL(notesChanged()), this, SLOT(onNotesChanged()));
     mProject->disconnect(SIGNAL(preProjectSaved()), this, SLOT(saveState()));
     mProject->disconnect(SIGNAL(aboutToBeginMacro(QString)),
         this, SLOT(onAboutToBeginMacro(QString)));
-    mProject->disconnect(SIGNAL(contentsModified()), this, SLOT(requestContentPaint()));
+    mProject->disconnect(SIGNAL(contentsModified()), this, SLOT(onContentChanged()));
+
+    mProject->setFrameTimings(nullptr);
 
     if (window()) {
         window()->disconnect(SIGNAL(activeFocusItemChanged()), this, SLOT(updateWindowCursorShape()));
@@ -1059,7 +1089,14 @@ void ImageCanvas::componentComplete()
 
     findRulers();
 
-    requestContentPaint();
+    onContentChanged();
+}
+
+void ImageCanvas::updatePolish()
+{
+    QQuickItem::updatePolish();
+
+    applyPendingStrokePoints();
 }
 
 void ImageCanvas::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
@@ -1096,20 +1133,67 @@ int ImageCanvas::currentLayerIndex() const
 
 QImage ImageCanvas::contentImage()
 {
+    updateContentImage();
+    if (mCachedSelectionPreviewPatches.isEmpty())
+        return mCachedContentImage;
+
+    // paint() draws the patches over the cached image itself; only callers
+    // that need everything in one image (e.g. auto tests) pay for this copy.
+    return withSelectionPreviewPatches(mCachedContentImage);
+}
+
+void ImageCanvas::updateContentImage()
+{
+    if (!mContentImageDirty)
+        return;
+
+    const FrameTimings::ScopedStageTimer stageTimer(&mFrameTimings, FrameTimings::ContentImageStage);
+    mCachedSelectionPreviewPatches.clear();
     mCachedContentImage = getContentImage();
-    return mCachedContentImage;
+    mContentImageDirty = false;
+}
+
+QColor ImageCanvas::contentPixelColour(const QPoint &scenePos) const
+{
+    for (const SelectionPreviewPatch &patch : mCachedSelectionPreviewPatches) {
+        const QRect patchRect(patch.pos, patch.image.size());
+        if (patchRect.contains(scenePos))
+            return patch.image.pixelColor(scenePos - patchRect.topLeft());
+    }
+    return mCachedContentImage.pixelColor(scenePos);
+}
+
+QImage ImageCanvas::withSelectionPreviewPatches(const QImage &image) const
+{
+    QImage result = image;
+    QPainter painter(&result);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (const SelectionPreviewPatch &patch : mCachedSelectionPreviewPatches)
+        painter.drawImage(patch.pos, patch.image);
+    return result;
 }
 
 QImage ImageCanvas::getContentImage()
 {
-    QImage image = !shouldDrawSelectionPreviewImage() ? *currentProjectImage() : mSelectionPreviewImage;
+    SLATE_TRACE_SCOPE("composite", "ImageCanvas::getContentImage");
+
+    QImage image = *currentProjectImage();
+    if (shouldDrawSelectionPreview()) {
+        // Only the areas affected by the selection are composited, and rather than
+        // copying the whole image to put them in, paint() draws them over the image.
+        mCachedSelectionPreviewPatches = selectionPreviewPatches(image);
+    }
     // Draw the pixel-pen-line indicator over the content.
     if (isLineVisible()) {
-        QPainter linePainter(&image);
+        if (!mCachedSelectionPreviewPatches.isEmpty()) {
+            // The line has to be drawn over the preview too, so we need it in the image.
+            image = withSelectionPreviewPatches(image);
+            mCachedSelectionPreviewPatches.clear();
+        }
         // Draw the line on top of what has already been painted using a special composition mode.
         // This ensures that e.g. a translucent red overwrites whatever pixels it
         // lies on, rather than blending with them.
-        drawLine(&linePainter, linePoint1(), linePoint2(), QPainter::CompositionMode_Source);
+        drawPixelLine(&image, linePoint1(), linePoint2(), QPainter::CompositionMode_Source, image.rect());
     }
     return image;
 }
@@ -1118,35 +1202,12 @@ void ImageCanvas::drawLine(QPainter *painter, QPointF point1, QPointF point2, co
 {
     painter->save();
 
-    QPen pen;
-    pen.setColor(penColour());
-    pen.setWidth(mToolSize);
-    if (mToolShape == ToolShape::SquareToolShape) {
-        pen.setCapStyle(Qt::PenCapStyle::SquareCap);
-        pen.setJoinStyle(Qt::PenJoinStyle::MiterJoin);
-    }
-    else {
-        pen.setCapStyle(Qt::PenCapStyle::RoundCap);
-        pen.setJoinStyle(Qt::PenJoinStyle::RoundJoin);
-    }
-    painter->setPen(pen);
-
-    // Offset odd sized pens to pixel centre to centre pen
-    const QPointF penOffset = (mToolSize % 2 == 1) ? QPointF(0.5, 0.5) : QPointF(0.0, 0.0);
+    const PixelBrush brush(mToolSize, mToolShape);
+    painter->setPen(brush.pen(penColour()));
 
     // Snap points to points to pixel grid
-    if (mToolSize > 1) {
-        point1 = (point1 + penOffset).toPoint() - penOffset;
-        point2 = (point2 + penOffset).toPoint() - penOffset;
-    }
-    else {
-        // Handle inconsitant width 1 pen behaviour, off pixel centres so results in non-ideal asymetrical lines but
-        // would require either redrawing previous segment as part of stroke or custom line function to prevent spurs
-        point1 = QPointF(qFloor(point1.x()), qFloor(point1.y()));
-        point2 = QPointF(qFloor(point2.x()), qFloor(point2.y()));
-    }
-
-    const QLineF line(point1, point2);
+    const QLineF line(brush.penPosition(brush.snappedPosition(point1)),
+        brush.penPosition(brush.snappedPosition(point2)));
 
     painter->setCompositionMode(mode);
     // Zero-length line doesn't draw with round pen so handle case with drawPoint
@@ -1160,6 +1221,40 @@ void ImageCanvas::drawLine(QPainter *painter, QPointF point1, QPointF point2, co
     painter->restore();
 }
 
+// Draws a line with the current tool into \a image, clipped to \a clipRect.
+// Uses PixelBrush where possible, falling back to QPainter otherwise.
+void ImageCanvas::drawPixelLine(QImage *image, const QPointF &point1, const QPointF &point2,
+    QPainter::CompositionMode mode, const QRect &clipRect) const
+{
+    drawPixelPolyline(image, { point1, point2 }, mode, clipRect);
+}
+
+// Draws a line between each consecutive pair of points, so that a whole
+// batch of stroke segments only needs one brush.
+void ImageCanvas::drawPixelPolyline(QImage *image, const QVector<QPointF> &points,
+    QPainter::CompositionMode mode, const QRect &clipRect) const
+{
+    if (points.isEmpty())
+        return;
+
+    if (!PixelBrush::canDraw(*image, mode)) {
+        QPainter painter(image);
+        painter.setClipRect(clipRect);
+        if (points.size() == 1)
+            drawLine(&painter, points.first(), points.first(), mode);
+        for (int i = 1; i < points.size(); ++i)
+            drawLine(&painter, points.at(i - 1), points.at(i), mode);
+        return;
+    }
+
+    const PixelBrush brush(mToolSize, mToolShape);
+    QVector<QPoint> snappedPositions;
+    snappedPositions.reserve(points.size());
+    for (const QPointF &point : points)
+        snappedPositions.append(brush.snappedPosition(point));
+    brush.drawPolyline(image, snappedPositions, penColour(), mode, clipRect);
+}
+
 void ImageCanvas::centrePanes(bool respectSceneCentred)
 {
     if (!mProject)
@@ -1451,10 +1546,9 @@ void ImageCanvas::beginSelectionMove()
         mSelectionAreaBeforeFirstModification = mSelectionArea;
         mSelectionContents = currentProjectImage()->copy(mSelectionAreaBeforeFirstModification);
         // Technically we don't need to call this until the selection has actually moved,
-        // but updateCursorPos() calls pixelColor() on the result of contentImage(), which will be an invalid
-        // image until we've updated the selection preview image (since shouldDrawSelectionPreviewImage() will
-        // return true due to mMovingSelection being true).
-        updateSelectionPreviewImage(SelectionMove);
+        // but shouldDrawSelectionPreview() returns true as soon as mMovingSelection is,
+        // so make sure that the area under the selection is repainted with the preview.
+        updateSelectionPreview(SelectionMove);
     }
 }
 
@@ -1494,27 +1588,17 @@ void ImageCanvas::updateSelectionArea()
     setSelectionArea(newSelectionArea);
 }
 
-void ImageCanvas::updateSelectionPreviewImage(SelectionModification reason)
+void ImageCanvas::updateSelectionPreview(SelectionModification reason)
 {
-    qCDebug(lcImageCanvasSelectionPreviewImage) << "updating selection preview image due to" << reason;
-
-    if (!mIsSelectionFromPaste) {
-        // Only if the selection wasn't pasted should we erase the area left behind.
-        mSelectionPreviewImage = ImageUtils::erasePortionOfImage(*currentProjectImage(), mSelectionAreaBeforeFirstModification);
-        qCDebug(lcImageCanvasSelectionPreviewImage) << "... selection is not from paste; erasing area left behind"
-            << "- new selection preview image:" << mSelectionPreviewImage;
-    } else {
-        mSelectionPreviewImage = *currentProjectImage();
-        qCDebug(lcImageCanvasSelectionPreviewImage) << "... selection is from a paste; not touching existing canvas content"
-            << "- new selection preview image:" << mSelectionPreviewImage;
-    }
-
-    // Then, move the dragged contents to their new location.
-    // Doing this last ensures that the drag contents are painted over the transparency,
-    // and not the other way around.
-    qCDebug(lcImageCanvasSelectionPreviewImage) << "painting selection contents" << mSelectionContents
-       << "within selection area" << mSelectionArea << "over top of current project image" << mSelectionPreviewImage;
-    mSelectionPreviewImage = ImageUtils::paintImageOntoPortionOfImage(mSelectionPreviewImage, mSelectionArea, mSelectionContents);
+    // The preview isn't stored anywhere; it's composited over the layer when the content
+    // image is requested. All we need to do is repaint the areas it used to cover and the
+    // areas it covers now.
+    const QRegion previewRegion = selectionPreviewRegion();
+    qCDebug(lcImageCanvasSelectionPreviewImage) << "updating selection preview due to" << reason
+        << "- old preview region:" << mSelectionPreviewRegion << "new preview region:" << previewRegion;
+    for (const QRect &rect : mSelectionPreviewRegion.united(previewRegion))
+        onContentRectChanged(rect);
+    mSelectionPreviewRegion = previewRegion;
 }
 
 void ImageCanvas::moveSelectionArea()
@@ -1527,7 +1611,7 @@ void ImageCanvas::moveSelectionArea()
     setSelectionArea(boundSelectionArea(newSelectionArea));
 
     // TODO: move this to be second-last once all tests are passing
-    updateSelectionPreviewImage(SelectionMove);
+    updateSelectionPreview(SelectionMove);
 
     setLastSelectionModification(SelectionMove);
 
@@ -1545,7 +1629,7 @@ void ImageCanvas::moveSelectionAreaBy(const QPoint &pixelDistance)
     setSelectionArea(boundSelectionArea(newSelectionArea));
 
     // see TODO in the function above
-    updateSelectionPreviewImage(SelectionMove);
+    updateSelectionPreview(SelectionMove);
 
     setLastSelectionModification(SelectionMove);
 
@@ -1627,6 +1711,12 @@ void ImageCanvas::clearSelection()
 {
     qCDebug(lcImageCanvasSelection) << "clearing selection";
 
+    // The preview is composited into the content image, so that needs recomputing without it.
+    if (shouldDrawSelectionPreview()) {
+        for (const QRect &rect : mSelectionPreviewRegion)
+            onContentRectChanged(rect);
+    }
+
     setSelectionArea(QRect());
     mPotentiallySelecting = false;
     setHasSelection(false);
@@ -1635,7 +1725,7 @@ void ImageCanvas::clearSelection()
     mSelectionAreaBeforeFirstModification = QRect(0, 0, 0, 0);
     mSelectionAreaBeforeLastMove = QRect(0, 0, 0, 0);
     mLastValidSelectionArea = QRect(0, 0, 0, 0);
-    mSelectionPreviewImage = QImage();
+    mSelectionPreviewRegion = QRegion();
     mSelectionContents = QImage();
     setLastSelectionModification(NoSelectionModification);
     setHasModifiedSelection(false);
@@ -1671,12 +1761,48 @@ bool ImageCanvas::cursorOverSelection() const
     return mHasSelection ? mSelectionArea.contains(QPoint(mCursorSceneX, mCursorSceneY)) : false;
 }
 
-bool ImageCanvas::shouldDrawSelectionPreviewImage() const
+bool ImageCanvas::shouldDrawSelectionPreview() const
 {
     return mMovingSelection || mIsSelectionFromPaste
         || mLastSelectionModification != NoSelectionModification;
 }
 
+// Returns the area of the image that the selection preview affects:
+// the area that the contents were taken from (unless they were pasted)
+// and the area that they would be dropped onto. These are kept apart so that
+// moving a selection a long way doesn't affect everything in between.
+QRegion ImageCanvas::selectionPreviewRegion() const
+{
+    QRegion previewRegion(QRect(mSelectionArea.topLeft(), mSelectionContents.size()));
+    if (!mIsSelectionFromPaste)
+        previewRegion += mSelectionAreaBeforeFirstModification;
+    return previewRegion.intersected(mProject->bounds());
+}
+
+// Returns the parts of layerImage within selectionPreviewRegion() as they would look
+// if the selection was dropped where it is now.
+QVector<ImageCanvas::SelectionPreviewPatch> ImageCanvas::selectionPreviewPatches(const QImage &layerImage) const
+{
+    QVector<SelectionPreviewPatch> patches;
+    for (const QRect &previewRect : selectionPreviewRegion()) {
+        QImage patch = layerImage.copy(previewRect);
+        QPainter painter(&patch);
+        painter.translate(-previewRect.topLeft());
+        if (!mIsSelectionFromPaste) {
+            // Only if the selection wasn't pasted should we erase the area left behind.
+            painter.setCompositionMode(QPainter::CompositionMode_Clear);
+            painter.fillRect(mSelectionAreaBeforeFirstModification, Qt::transparent);
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        }
+        // Doing this last ensures that the contents are painted over the transparency,
+        // and not the other way around.
+        painter.drawImage(mSelectionArea.topLeft(), mSelectionContents);
+        painter.end();
+        patches.append({ previewRect.topLeft(), patch });
+    }
+    return patches;
+}
+
 bool ImageCanvas::shouldDrawSelectionCursorGuide() const
 {
     return mTool == SelectionTool && !mHasSelection && mContainsMouse;
@@ -1874,6 +2000,9 @@ QPointF ImageCanvas::snappedScenePositionF(const QPointF &scenePosition) const
 
 void ImageCanvas::reset()
 {
+    mPendingStrokePoints.clear();
+    mPendingStrokeTimer.invalidate();
+    mUndisplayedStrokeTimer.invalidate();
     mFirstPane.reset();
     mSecondPane.reset();
     setCurrentPane(nullptr);
@@ -1928,7 +2057,7 @@ void ImageCanvas::reset()
     // TODO: ^ why?
     mToolsForbiddenReason.clear();
 
-    requestContentPaint();
+    onContentChanged();
 }
 
 void ImageCanvas::centreView()
@@ -2020,7 +2149,7 @@ void ImageCanvas::paste()
 
     // moveSelectionArea() does this for us when we're moving, but for the initial
     // paste, we must do it ourselves.
-    updateSelectionPreviewImage(SelectionPaste);
+    updateSelectionPreview(SelectionPaste);
 
     requestContentPaint();
 }
@@ -2058,8 +2187,8 @@ void ImageCanvas::flipSelection(Qt::Orientation orientation)
         mProject->addChange(new FlipImageCanvasSelectionCommand(this, mSelectionArea, orientation));
         mProject->endMacro();
     } else {
-        mSelectionContents = mSelectionContents.mirrored(orientation == Qt::Horizontal, orientation == Qt::Vertical);
-        updateSelectionPreviewImage(SelectionFlip);
+        ImageUtils::flip(mSelectionContents, mSelectionContents.rect(), orientation);
+        updateSelectionPreview(SelectionFlip);
         requestContentPaint();
     }
 }
@@ -2098,7 +2227,7 @@ void ImageCanvas::rotateSelection(int angle)
 
     setLastSelectionModification(SelectionRotate);
 
-    updateSelectionPreviewImage(SelectionRotate);
+    updateSelectionPreview(SelectionRotate);
     requestContentPaint();
 }
 
@@ -2162,10 +2291,10 @@ void ImageCanvas::modifySelectionHsl(qreal hue, qreal saturation, qreal lightnes
 
     ImageUtils::modifyHsl(mSelectionContents, hue, saturation, lightness, alpha, alphaAdjustmentFlags);
 
-    // Set this so that the check in shouldDrawSelectionPreviewImage() evaluates to true.
+    // Set this so that the check in shouldDrawSelectionPreview() evaluates to true.
     setLastSelectionModification(SelectionHsl);
 
-    updateSelectionPreviewImage(SelectionHsl);
+    updateSelectionPreview(SelectionHsl);
     requestContentPaint();
 }
 
@@ -2176,7 +2305,7 @@ void ImageCanvas::endModifyingSelectionHsl(AdjustmentAction adjustmentAction)
     if (adjustmentAction == RollbackAdjustment) {
         mSelectionContents = mSelectionContentsBeforeImageAdjustment;
         setLastSelectionModification(mLastSelectionModificationBeforeImageAdjustment);
-        updateSelectionPreviewImage(SelectionHsl);
+        updateSelectionPreview(SelectionHsl);
         requestContentPaint();
     } else {
         // Commit the adjustments. We don't need to request a repaint
@@ -2275,30 +2404,6 @@ void ImageCanvas::cycleFillTools()
     setTool(mLastFillToolUsed == FillTool ? TexturedFillTool : FillTool);
 }
 
-ImageCanvas::PixelCandidateData ImageCanvas::penEraserPixelCandidates(Tool tool) const
-{
-    PixelCandidateData candidateData;
-
-    QPoint topLeft(qRound(mCursorSceneFX - mToolSize / 2.0), qRound(mCursorSceneFY - mToolSize / 2.0));
-    topLeft = clampToImageBounds(topLeft);
-    QPoint bottomRight(qRound(mCursorSceneFX + mToolSize / 2.0), qRound(mCursorSceneFY + mToolSize / 2.0));
-    bottomRight = clampToImageBounds(bottomRight);
-    QPoint scenePos(topLeft);
-    for (; scenePos.y() < bottomRight.y(); ++scenePos.ry()) {
-        for (scenePos.rx() = topLeft.x(); scenePos.x() < bottomRight.x(); ++scenePos.rx()) {
-            const QColor previousColour = currentProjectImage()->pixelColor(scenePos);
-            // Let the pen tool draw over the same colour, as the line tool requires
-            // a press point to start from, which we don't get if we make this a no-op.
-            if (tool == PenTool || (tool == EraserTool && previousColour != QColor(Qt::transparent))) {
-                candidateData.scenePositions.append(scenePos);
-                candidateData.previousColours.append(previousColour);
-            }
-        }
-    }
-
-    return candidateData;
-}
-
 QImage ImageCanvas::fillPixels() const
 {
     const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
@@ -2360,6 +2465,9 @@ ImageCanvas::Tool ImageCanvas::penRightClickTool() const
 
 void ImageCanvas::applyCurrentTool()
 {
+    SLATE_TRACE_SCOPE("tool", "ImageCanvas::applyCurrentTool");
+    const FrameTimings::ScopedStageTimer stageTimer(&mFrameTimings, FrameTimings::ToolStage);
+
     updateToolsForbidden();
     if (areToolsForbidden())
         return;
@@ -2453,44 +2561,145 @@ void ImageCanvas::applyCurrentTool()
     }
 }
 
+bool ImageCanvas::canCoalesceStrokePoints() const
+{
+    const Tool tool = effectiveTool();
+    return tool == PenTool || tool == EraserTool;
+}
+
+void ImageCanvas::queueStrokePoint(const QPointF &scenePos)
+{
+    if (mPendingStrokePoints.isEmpty())
+        mPendingStrokeTimer.start();
+
+    mPendingStrokePoints.append(scenePos);
+    // updatePolish() is called before the next frame is rendered.
+    polish();
+}
+
+void ImageCanvas::applyPendingStrokePoints()
+{
+    if (mPendingStrokePoints.isEmpty())
+        return;
+
+    // Continue on from where the last batch (or the press) left off.
+    QVector<QPointF> points;
+    points.reserve(mPendingStrokePoints.size() + 1);
+    points.append(mLastPixelPenPressScenePositionF);
+    points.append(mPendingStrokePoints);
+    mPendingStrokePoints.clear();
+
+    qCDebug(lcImageCanvas) << "applying" << points.size() - 1 << "coalesced stroke points";
+
+    updateToolsForbidden();
+    if (!areToolsForbidden())
+        applyPixelStroke(points);
+
+    if (!mUndisplayedStrokeTimer.isValid())
+        mUndisplayedStrokeTimer = mPendingStrokeTimer;
+    mPendingStrokeTimer.invalidate();
+    if (window()) {
+        connect(window(), &QQuickWindow::frameSwapped, this, &ImageCanvas::onStrokeFrameSwapped,
+            Qt::UniqueConnection);
+    }
+}
+
+void ImageCanvas::applyPixelStroke(const QVector<QPointF> &points)
+{
+    const bool erasing = effectiveTool() == EraserTool;
+    mProject->beginMacro(erasing ? QLatin1String("PixelEraserTool") : QLatin1String("PixelLineTool"));
+    mProject->addChange(new ApplyPixelLineCommand(this, mProject->currentLayerIndex(), *currentProjectImage(), points,
+        points.last(), mLastPixelPenPressScenePositionF,
+        erasing ? QPainter::CompositionMode_Clear : QPainter::CompositionMode_Source));
+}
+
+void ImageCanvas::onStrokeFrameSwapped()
+{
+    if (!mUndisplayedStrokeTimer.isValid())
+        return;
+
+    const qint64 latency = mUndisplayedStrokeTimer.nsecsElapsed();
+    mUndisplayedStrokeTimer.invalidate();
+    qCDebug(lcImageCanvasLatency) << "stroke latency:" << latency / 1000000.0 << "ms";
+    emit strokeLatencyMeasured(latency);
+}
+
+void ImageCanvas::onFrameTimingsEnabledChanged()
+{
+    if (!window())
+        return;
+
+    // A frame is the time between two afterAnimating() emissions, which
+    // happen on the GUI thread at the start of every frame.
+    if (mFrameTimings.isEnabled()) {
+        connect(window(), &QQuickWindow::afterAnimating, &mFrameTimings, &FrameTimings::endFrame,
+            Qt::UniqueConnection);
+    } else {
+        disconnect(window(), &QQuickWindow::afterAnimating, &mFrameTimings, &FrameTimings::endFrame);
+    }
+}
+
 // This function actually operates on the image.
 void ImageCanvas::applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease)
 {
     imageForLayerAt(layerIndex)->setPixelColor(scenePos, colour);
     if (markAsLastRelease)
         mLastPixelPenPressScenePositionF = scenePos;
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, QRect(scenePos, QSize(1, 1)));
+    onContentChanged();
+}
+
+void ImageCanvas::beginPixelPenChanges()
+{
+}
+
+void ImageCanvas::endPixelPenChanges()
+{
 }
 
 void ImageCanvas::applyPixelLineTool(int layerIndex, const QImage &lineImage, const QRect &lineRect,
     const QPointF &lastPixelPenReleaseScenePosition)
 {
-    mLastPixelPenPressScenePositionF = lastPixelPenReleaseScenePosition;
     QPainter painter(imageForLayerAt(layerIndex));
     painter.setCompositionMode(QPainter::CompositionMode_Source);
     painter.drawImage(lineRect, lineImage);
-    requestContentPaint();
+    painter.end();
+    notifyPixelLineDrawn(layerIndex, lineRect, lastPixelPenReleaseScenePosition);
+}
+
+void ImageCanvas::notifyPixelLineDrawn(int layerIndex, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition)
+{
+    mLastPixelPenPressScenePositionF = lastPixelPenReleaseScenePosition;
+    notifyLayerImageModified(layerIndex, lineRect);
+    onContentChanged();
+}
+
+void ImageCanvas::notifyLayerImageModified(int, const QRect &)
+{
 }
 
 void ImageCanvas::paintImageOntoPortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage)
 {
     QImage *image = imageForLayerAt(layerIndex);
     *image = ImageUtils::paintImageOntoPortionOfImage(*image, portion, replacementImage);
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, portion);
+    onContentChanged();
 }
 
 void ImageCanvas::replacePortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage)
 {
     QImage *image = imageForLayerAt(layerIndex);
     *image = ImageUtils::replacePortionOfImage(*image, portion, replacementImage);
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, portion);
+    onContentChanged();
 }
 
 void ImageCanvas::erasePortionOfImage(int layerIndex, const QRect &portion)
 {
     QImage *image = imageForLayerAt(layerIndex);
     *image = ImageUtils::erasePortionOfImage(*image, portion);
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, portion);
+    onContentChanged();
 }
 
 void ImageCanvas::replaceImage(int layerIndex, const QImage &replacementImage)
@@ -2498,27 +2707,30 @@ void ImageCanvas::replaceImage(int layerIndex, const QImage &replacementImage)
     // TODO: could ImageCanvas just be a LayeredImageCanvas with one layer?
     QImage *image = imageForLayerAt(layerIndex);
     *image = replacementImage;
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, image->rect());
+    onContentChanged();
 }
 
 void ImageCanvas::doFlipSelection(int layerIndex, const QRect &area, Qt::Orientation orientation)
 {
-    const QImage flippedImagePortion = currentProjectImage()->copy(area)
-        .mirrored(orientation == Qt::Horizontal, orientation == Qt::Vertical);
-    erasePortionOfImage(layerIndex, area);
-    paintImageOntoPortionOfImage(layerIndex, area, flippedImagePortion);
+    ImageUtils::flip(*imageForLayerAt(layerIndex), area, orientation);
+    notifyLayerImageModified(layerIndex, area);
+    onContentChanged();
 }
 
 QRect ImageCanvas::doRotateSelection(int layerIndex, const QRect &area, int angle)
 {
     QImage *image = imageForLayerAt(layerIndex);
     QRect rotatedArea;
-    *image = ImageUtils::rotateAreaWithinImage(*image, area, angle, rotatedArea);
+    const QImage rotatedImagePortion = ImageUtils::rotateAreaWithinImage(*image, area, angle, rotatedArea);
+    ImageUtils::erasePixels(*image, area);
+    ImageUtils::copyPixels(rotatedImagePortion, rotatedImagePortion.rect(), *image, rotatedArea.topLeft());
     // Only update the selection area when the commands are being created for the first time,
     // not when they're being undone and redone.
     if (mHasSelection)
         setSelectionArea(rotatedArea);
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, area.united(rotatedArea));
+    onContentChanged();
     return area.united(rotatedArea);
 }
 
@@ -2581,7 +2793,7 @@ void ImageCanvas::updateCursorPos(const QPoint &eventPos)
         setCursorPixelColour(QColor(Qt::black));
     } else {
         const QPoint cursorScenePos = QPoint(mCursorSceneX, mCursorSceneY);
-        setCursorPixelColour(mCachedContentImage.pixelColor(cursorScenePos));
+        setCursorPixelColour(contentPixelColour(cursorScenePos));
     }
 
     qCDebug(lcImageCanvasCursorPos) << "mCursorX" << mCursorX << "mCursorY" << mCursorY
@@ -2621,6 +2833,7 @@ void ImageCanvas::onLoadedChanged()
 
     if (mProject->hasLoaded()) {
         centrePanes();
+        onContentChanged();
     }
 
     updateWindowCursorShape();
@@ -2631,7 +2844,8 @@ void ImageCanvas::requestContentPaint()
     // It's nice to be able to debug where a paint request comes from;
     // that's the only reason that these functions are slots and the signal isn't
     // just emitted immediately instead.
-    // Note that this function can be called for drawing _and_ e.g. panning, zooming, etc.
+    // Note that this function is called for view changes like panning and zooming,
+    // which don't affect the content image, so it doesn't mark it as dirty.
     emit contentPaintRequested(-1);
 }
 
@@ -2640,6 +2854,25 @@ void ImageCanvas::requestPaneContentPaint(int paneIndex)
     emit contentPaintRequested(paneIndex);
 }
 
+void ImageCanvas::requestContentRectPaint(const QRect &sceneRect)
+{
+    emit contentRectPaintRequested(sceneRect);
+}
+
+void ImageCanvas::onContentChanged()
+{
+    // The content image is recomputed the next time a pane paints,
+    // and only once for all panes.
+    mContentImageDirty = true;
+    requestContentPaint();
+}
+
+void ImageCanvas::onContentRectChanged(const QRect &sceneRect)
+{
+    mContentImageDirty = true;
+    requestContentRectPaint(sceneRect);
+}
+
 void ImageCanvas::updateWindowCursorShape()
 {
     if (!mProject)
@@ -2882,6 +3115,9 @@ void ImageCanvas::applyZoom(qreal newZoomLevel, const QPoint &origin)
 
 void ImageCanvas::wheelEvent(QWheelEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     qCDebug(lcImageCanvasEvents) << "wheelEvent:" << event;
 
     if (!mProject->hasLoaded() || !mScrollZoom) {
@@ -2923,8 +3159,13 @@ void ImageCanvas::wheelEvent(QWheelEvent *event)
 
 void ImageCanvas::mousePressEvent(QMouseEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     QQuickItem::mousePressEvent(event);
 
+    applyPendingStrokePoints();
+
     // Is it possible to get a press without a hover enter? If so, we need this line.
     updateCursorPos(event->pos());
 
@@ -3007,6 +3248,9 @@ void ImageCanvas::mousePressEvent(QMouseEvent *event)
 
 void ImageCanvas::mouseMoveEvent(QMouseEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     qCDebug(lcImageCanvasEvents) << "mouseMoveEvent -" << event;
     QQuickItem::mouseMoveEvent(event);
 
@@ -3032,10 +3276,15 @@ void ImageCanvas::mouseMoveEvent(QMouseEvent *event)
                 if (mTool != SelectionTool) {
                     mPressScenePosition = QPoint(mCursorSceneX, mCursorSceneY);
                     mPressScenePositionF = QPointF(mCursorSceneFX, mCursorSceneFY);
-                    if (!mShiftPressed) {
-                        mLastPixelPenPressScenePositionF = oldCursorScenePosition;
+                    if (!mShiftPressed && canCoalesceStrokePoints()) {
+                        // Draw every move that arrives before the next frame in one go.
+                        queueStrokePoint(mPressScenePositionF);
+                    } else {
+                        if (!mShiftPressed) {
+                            mLastPixelPenPressScenePositionF = oldCursorScenePosition;
+                        }
+                        applyCurrentTool();
                     }
-                    applyCurrentTool();
                 } else {
                     panWithSelectionIfAtEdge(SelectionPanMouseMovementReason);
 
@@ -3053,11 +3302,17 @@ void ImageCanvas::mouseMoveEvent(QMouseEvent *event)
 
 void ImageCanvas::mouseReleaseEvent(QMouseEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     qCDebug(lcImageCanvasEvents) << "mouseReleaseEvent -" << event
          << "mCursorX:" << mCursorX << "mCursorY:" << mCursorY
          << "mCursorSceneFX:" << mCursorSceneFX << "mCursorSceneFY:" << mCursorSceneFY;
     QQuickItem::mouseReleaseEvent(event);
 
+    // Finish the stroke before anything else, like ending the macro, happens.
+    applyPendingStrokePoints();
+
     updateCursorPos(event->pos());
 
     if (!mProject->hasLoaded())
@@ -3199,6 +3454,9 @@ void ImageCanvas::hoverEnterEvent(QHoverEvent *event)
 
 void ImageCanvas::hoverMoveEvent(QHoverEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     qCDebug(lcImageCanvasHoverEvents) << "hoverMoveEvent:" << event->position();
     QQuickItem::hoverMoveEvent(event);
 
@@ -3214,7 +3472,7 @@ void ImageCanvas::hoverMoveEvent(QHoverEvent *event)
     updateWindowCursorShape();
 
     if (mTool == PenTool && mShiftPressed)
-        requestContentPaint();
+        onContentChanged();
 }
 
 void ImageCanvas::hoverLeaveEvent(QHoverEvent *event)
@@ -3227,9 +3485,14 @@ void ImageCanvas::hoverLeaveEvent(QHoverEvent *event)
 
 void ImageCanvas::keyPressEvent(QKeyEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     qCDebug(lcImageCanvasEvents) << "keyPressEvent:" << event;
     QQuickItem::keyPressEvent(event);
 
+    applyPendingStrokePoints();
+
     if (!mProject->hasLoaded())
         return;
 
@@ -3296,9 +3559,14 @@ void ImageCanvas::keyPressEvent(QKeyEvent *event)
 
 void ImageCanvas::keyReleaseEvent(QKeyEvent *event)
 {
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordEvent(this, event);
+
     qCDebug(lcImageCanvasEvents) << "keyReleaseEvent:" << event;
     QQuickItem::keyReleaseEvent(event);
 
+    applyPendingStrokePoints();
+
     if (!mProject->hasLoaded())
         return;
 
@@ -3358,8 +3626,15 @@ void ImageCanvas::timerEvent(QTimerEvent *event)
 
 void ImageCanvas::undo()
 {
+    SLATE_TRACE_SCOPE("undo", "ImageCanvas::undo");
+
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordAction(this, QLatin1String("undo"));
+
     qCDebug(lcImageCanvasUndo) << "about to undo";
 
+    applyPendingStrokePoints();
+
     if (mHasSelection && !mIsSelectionFromPaste) {
         if (mLastSelectionModification != NoSelectionModification) {
             qCDebug(lcImageCanvasSelection) << "Undo activated while a selection that has previously been modified is active;"
@@ -3371,7 +3646,7 @@ void ImageCanvas::undo()
             // to be done this way, because we want to behave like mspsaint, where pressing Ctrl+Z
             // with a modified selection will undo *all* modifications done to the selection since it was created.
             // Since we have special undo behaviour, we can't use the undo framework for all of it, and so
-            // we store the temporary state in mSelectionContents (which is displayed via mSelectionPreviewImage).
+            // we store the temporary state in mSelectionContents (which is displayed via the selection preview).
             // See the undo shortcut in Shortcuts.qml for more info.
             mProject->undoStack()->undo();
 //            requestContentPaint();
@@ -3411,3 +3686,15 @@ void ImageCanvas::undo()
         undoStack->undo();
     }
 }
+
+void ImageCanvas::redo()
+{
+    SLATE_TRACE_SCOPE("undo", "ImageCanvas::redo");
+
+    if (InputRecorder::isRecording())
+        InputRecorder::instance()->recordAction(this, QLatin1String("redo"));
+
+    qCDebug(lcImageCanvasUndo) << "about to redo";
+
+    mProject->undoStack()->redo();
+}
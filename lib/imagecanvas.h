@@ -21,10 +21,12 @@
 #define IMAGECANVAS_H
 
 #include <QBasicTimer>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QLoggingCategory>
 #include <QPixmap>
 #include <QQuickItem>
+#include <QRegion>
 #include <QStack>
 #include <QTimerEvent>
 #include <QUndoStack>
@@ -32,6 +34,7 @@
 #include <QPainter>
 
 #include "canvaspane.h"
+#include "frametimings.h"
 #include "ruler.h"
 #include "slate-global.h"
 #include "splitter.h"
@@ -71,6 +74,7 @@ class SLATE_EXPORT ImageCanvas : public QQuickItem
     Q_PROPERTY(PenToolRightClickBehaviour penToolRightClickBehaviour READ penToolRightClickBehaviour
         WRITE setPenToolRightClickBehaviour NOTIFY penToolRightClickBehaviourChanged)
     Q_PROPERTY(Splitter *splitter READ splitter CONSTANT)
+    Q_PROPERTY(FrameTimings *frameTimings READ frameTimings CONSTANT)
     Q_PROPERTY(CanvasPane *firstPane READ firstPane CONSTANT)
     Q_PROPERTY(CanvasPane *secondPane READ secondPane CONSTANT)
     Q_PROPERTY(CanvasPane *currentPane READ currentPane NOTIFY currentPaneChanged)
@@ -227,6 +231,8 @@ public:
 
     Splitter *splitter();
 
+    FrameTimings *frameTimings();
+
     CanvasPane *firstPane();
     const CanvasPane *firstPane() const;
     CanvasPane *secondPane();
@@ -300,11 +306,15 @@ public:
     //
     // This function calls getContentImage() and caches the result so that we have
     // cheap lookup of pixel data, which is useful for e.g. mCursorPixelColour.
+    // The cached image is only recomputed after the content has changed (see
+    // onContentChanged()), so each pane in split screen mode doesn't have to
+    // composite it separately, and view changes like panning don't recompute it.
     //
     // Public for auto test access.
     QImage contentImage();
 
     Q_INVOKABLE void undo();
+    Q_INVOKABLE void redo();
 
     // The image that is currently being drawn on. For regular image canvases, this is
     // the project's image. For layered image canvases, this is the image belonging to
@@ -404,6 +414,12 @@ signals:
     // paneIndex is the index of the pane that should be redrawn,
     // or -1 for all panes.
     void contentPaintRequested(int paneIndex);
+    // Like contentPaintRequested(), but for when only sceneRect
+    // needs to be redrawn (in every pane).
+    void contentRectPaintRequested(const QRect &sceneRect);
+    // Emitted when coalesced pen strokes have made it on screen, with the time
+    // between the oldest mouse move in the batch arriving and the frame being swapped.
+    void strokeLatencyMeasured(qint64 nanoseconds);
 
     void errorOccurred(const QString &errorMessage);
 
@@ -445,8 +461,14 @@ protected slots:
     // (like the user drawing pixels) require both panes to be redrawn,
     // but stuff like panning does not, and hence it should use
     // requestPaneContentPaint() and pass a specific index.
+    // These only repaint; when something that the content image is
+    // made from has changed, call onContentChanged() or onContentRectChanged()
+    // instead so that it's recomputed.
     void requestContentPaint();
     void requestPaneContentPaint(int paneIndex);
+    void requestContentRectPaint(const QRect &sceneRect);
+    void onContentChanged();
+    void onContentRectChanged(const QRect &sceneRect);
     void updateWindowCursorShape();
     void onZoomLevelChanged();
     void onPaneIntegerOffsetChanged();
@@ -455,9 +477,12 @@ protected slots:
     void onNotesChanged();
     void onAboutToBeginMacro(const QString &macroText);
     void recreateCheckerImage();
+    void onStrokeFrameSwapped();
+    void onFrameTimingsEnabledChanged();
 
 protected:
     void componentComplete() override;
+    void updatePolish() override;
     void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
 
     virtual void restoreState();
@@ -466,7 +491,6 @@ protected:
     friend class ApplyPixelEraserCommand;
     friend class ApplyPixelFillCommand;
     friend class ApplyPixelLineCommand;
-    friend class ApplyPixelPenCommand;
     friend class ModifyImageCanvasSelectionCommand;
     friend class DeleteImageCanvasSelectionCommand;
     friend class FlipImageCanvasSelectionCommand;
@@ -477,7 +501,6 @@ protected:
         QVector<QPoint> scenePositions;
         QVector<QColor> previousColours;
     };
-    virtual PixelCandidateData penEraserPixelCandidates(Tool tool) const;
     QImage fillPixels() const;
     QImage greedyFillPixels() const;
     QImage texturedFillPixels() const;
@@ -486,8 +509,22 @@ protected:
     ImageCanvas::Tool effectiveTool() const;
     ImageCanvas::Tool penRightClickTool() const;
     virtual void applyCurrentTool();
+    // Mouse moves for tools that support it are queued with queueStrokePoint()
+    // and drawn as one polyline per frame by applyPendingStrokePoints().
+    virtual bool canCoalesceStrokePoints() const;
+    void queueStrokePoint(const QPointF &scenePos);
+    void applyPendingStrokePoints();
+    virtual void applyPixelStroke(const QVector<QPointF> &points);
     virtual void applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease = false);
+    // Called around a series of applyPixelPenTool() calls so that
+    // the changes can be treated as one (e.g. for notifications).
+    virtual void beginPixelPenChanges();
+    virtual void endPixelPenChanges();
     virtual void applyPixelLineTool(int layerIndex, const QImage &lineImage, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition);
+    // Called when pixels within lineRect have been drawn directly into the image for layerIndex.
+    virtual void notifyPixelLineDrawn(int layerIndex, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition);
+    // Called when the pixels within sceneRect of the image for layerIndex have been modified.
+    virtual void notifyLayerImageModified(int layerIndex, const QRect &sceneRect);
     void paintImageOntoPortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage);
     void replacePortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage);
     void erasePortionOfImage(int layerIndex, const QRect &portion);
@@ -521,7 +558,14 @@ protected:
     CanvasPane *hoveredPane(const QPoint &pos);
     QPoint eventPosRelativeToCurrentPane(const QPoint &pos);
     virtual QImage getContentImage();
+    void updateContentImage();
+    QColor contentPixelColour(const QPoint &scenePos) const;
+    QImage withSelectionPreviewPatches(const QImage &image) const;
     void drawLine(QPainter *painter, QPointF point1, QPointF point2, QPainter::CompositionMode mode) const;
+    void drawPixelLine(QImage *image, const QPointF &point1, const QPointF &point2,
+        QPainter::CompositionMode mode, const QRect &clipRect) const;
+    void drawPixelPolyline(QImage *image, const QVector<QPointF> &points,
+        QPainter::CompositionMode mode, const QRect &clipRect) const;
     void centrePanes(bool respectSceneCentred = true);
     enum ResetPaneSizePolicy {
         DontResetPaneSizes,
@@ -568,7 +612,7 @@ protected:
     void beginSelectionMove();
     void updateOrMoveSelectionArea();
     void updateSelectionArea();
-    void updateSelectionPreviewImage(SelectionModification reason = NoSelectionModification);
+    void updateSelectionPreview(SelectionModification reason = NoSelectionModification);
     void moveSelectionArea();
     void moveSelectionAreaBy(const QPoint &pixelDistance);
     void confirmSelectionModification();
@@ -579,7 +623,16 @@ protected:
     void setHasSelection(bool hasSelection);
     void setMovingSelection(bool movingSelection);
     bool cursorOverSelection() const;
-    bool shouldDrawSelectionPreviewImage() const;
+    bool shouldDrawSelectionPreview() const;
+    // Part of the current layer as it would look if the selection was dropped where it is now.
+    struct SelectionPreviewPatch
+    {
+        QPoint pos;
+        QImage image;
+    };
+
+    QRegion selectionPreviewRegion() const;
+    QVector<SelectionPreviewPatch> selectionPreviewPatches(const QImage &layerImage) const;
     bool shouldDrawSelectionCursorGuide() const;
     void confirmPasteSelection();
     void setSelectionFromPaste(bool isSelectionFromPaste);
@@ -590,6 +643,7 @@ protected:
 
     void setAltPressed(bool altPressed);
 
+    bool isShiftPressed() const;
     void setShiftPressed(bool shiftPressed);
 
     virtual void connectSignals();
@@ -617,6 +671,7 @@ private:
 
 protected:
     friend class CanvasPaneItem;
+    friend class MemoryStats;
     friend class TileCanvasPaneItem;
 
     // The background colour of the entire pane.
@@ -630,6 +685,7 @@ protected:
 
     bool mSplitScreen;
     Splitter mSplitter;
+    FrameTimings mFrameTimings;
     CanvasPane mFirstPane;
     CanvasPane mSecondPane;
     CanvasPane *mCurrentPane;
@@ -652,8 +708,13 @@ protected:
     int mPressedGuideIndex;
     int mPressedNoteIndex;
 
-    // Used for setCursorPixelColour().
+    // Used for setCursorPixelColour() and shared by the panes.
     QImage mCachedContentImage;
+    // Set by the content paint requests; cleared when mCachedContentImage is recomputed.
+    bool mContentImageDirty;
+    // For regular image canvases, mCachedContentImage is the unmodified project image while
+    // the selection preview is shown, and these are drawn over it.
+    QVector<SelectionPreviewPatch> mCachedSelectionPreviewPatches;
 
     // The position of the cursor in view coordinates.
     int mCursorX;
@@ -703,6 +764,13 @@ protected:
     // The scene position at which the mouse was last pressed.
     // This is used by the pixel line tool to draw the line preview.
     QPointF mLastPixelPenPressScenePositionF;
+    // Scene positions of mouse moves that haven't been drawn yet.
+    QVector<QPointF> mPendingStrokePoints;
+    // Started when the oldest pending stroke point was queued.
+    QElapsedTimer mPendingStrokeTimer;
+    // Started when the oldest stroke point that has been drawn
+    // but isn't on screen yet was queued.
+    QElapsedTimer mUndisplayedStrokeTimer;
 
     bool mPotentiallySelecting;
     bool mHasSelection;
@@ -721,9 +789,8 @@ protected:
     QRect mLastCopiedSelectionArea;
     // The image contents of the selection.
     QImage mSelectionContents;
-    // The entire image as it would look if the selection (that is currently being dragged)
-    // was dropped where it is now.
-    QImage mSelectionPreviewImage;
+    // The area of the image that the selection preview covered when it was last updated.
+    QRegion mSelectionPreviewRegion;
     // See the definition of beginModifyingSelectionHsl() for info.
     QImage mSelectionContentsBeforeImageAdjustment;
     // The last image that was copied from this canvas.
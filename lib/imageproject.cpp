@@ -24,6 +24,7 @@
 #include "imageutils.h"
 #include "qtutils.h"
 #include "rearrangeimagecontentsintogridcommand.h"
+#include "tracer.h"
 
 Q_LOGGING_CATEGORY(lcImageProjectLivePreview, "app.imageproject.livepreview")
 Q_LOGGING_CATEGORY(lcResize, "app.imageproject.resize")
@@ -364,13 +365,15 @@ void ImageProject::removeAnimation(int index)
     mAnimationHelper.removeAnimation(index);
 }
 
-QImage ImageProject::exportedImage() const
+QImage ImageProject::createExportedImage() const
 {
     return mImage;
 }
 
 void ImageProject::exportGif(const QUrl &url)
 {
+    SLATE_TRACE_SCOPE("export", "ImageProject::exportGif");
+
     if (!mUsingAnimation) {
         // Shouldn't happen, but just in case...
         error(tr("Cannot export as GIF because the project isn't using animation"));
@@ -52,7 +52,6 @@ public:
 
     AnimationSystem *animationSystem();
 
-    QImage exportedImage() const override;
 
     Q_INVOKABLE void exportGif(const QUrl &url);
 
@@ -81,6 +80,7 @@ protected:
     void doLoad(const QUrl &url) override;
     void doClose() override;
     bool doSaveAs(const QUrl &url) override;
+    QImage createExportedImage() const override;
 
 private:
     friend class ChangeImageCanvasSizeCommand;
@@ -31,7 +31,10 @@
 #include <QPainterPath>
 #include <QPainterPathStroker>
 #include <QScopeGuard>
+#include <QSet>
 #include <QThread>
+#include <QThreadPool>
+#include <QtMath>
 #include <QTransform>
 
 // Need this otherwise we get linker errors.
@@ -46,6 +49,7 @@ extern "C" {
 #include "animationplayback.h"
 #include "clipboard.h"
 #include "imagelayer.h"
+#include "qtutils.h"
 
 Q_LOGGING_CATEGORY(lcUtils, "app.utils")
 Q_LOGGING_CATEGORY(lcUtilsRearrange, "app.utils.rearrangeContentsIntoGrid")
@@ -90,8 +94,75 @@ QImage ImageUtils::erasePortionOfImage(const QImage &image, const QRect &portion
     return newImage;
 }
 
+// The size (in pixels) of the square blocks that 90 degree rotations are done in.
+// Reading and writing a block at a time keeps both the source rows and the
+// destination rows that are being accessed in the cache, whereas going through
+// the whole image a row at a time would write each destination pixel to a
+// different row, thrashing the cache for large images.
+static const int rotationBlockSize = 32;
+
+static QImage rotate90(const QImage &image, bool clockwise)
+{
+    const int width = image.width();
+    const int height = image.height();
+    QImage rotated(height, width, image.format());
+    uchar *rotatedBits = rotated.bits();
+    const qsizetype rotatedBytesPerLine = rotated.bytesPerLine();
+
+    for (int blockY = 0; blockY < height; blockY += rotationBlockSize) {
+        const int blockEndY = qMin(blockY + rotationBlockSize, height);
+        for (int blockX = 0; blockX < width; blockX += rotationBlockSize) {
+            const int blockEndX = qMin(blockX + rotationBlockSize, width);
+            for (int y = blockY; y < blockEndY; ++y) {
+                const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+                // Clockwise, (x, y) ends up at (height - 1 - y, x).
+                // Counter-clockwise, it ends up at (y, width - 1 - x).
+                const int rotatedX = clockwise ? height - 1 - y : y;
+                for (int x = blockX; x < blockEndX; ++x) {
+                    const int rotatedY = clockwise ? x : width - 1 - x;
+                    reinterpret_cast<quint32*>(rotatedBits + rotatedY * rotatedBytesPerLine)[rotatedX] = row[x];
+                }
+            }
+        }
+    }
+    return rotated;
+}
+
+static QImage rotate180(const QImage &image)
+{
+    const int width = image.width();
+    const int height = image.height();
+    QImage rotated(image.size(), image.format());
+    for (int y = 0; y < height; ++y) {
+        const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        auto rotatedRow = reinterpret_cast<quint32*>(rotated.scanLine(height - 1 - y));
+        std::reverse_copy(row, row + width, rotatedRow);
+    }
+    return rotated;
+}
+
+/*!
+    Returns \a image rotated clockwise by \a angle degrees.
+
+    Multiples of 90 degrees are done by copying pixels around,
+    so there is no resampling and the result is always exact.
+*/
 QImage ImageUtils::rotate(const QImage &image, int angle)
 {
+    const int normalisedAngle = QtUtils::modFloor(angle, 360);
+    if (!image.isNull() && image.depth() == 32 && normalisedAngle % 90 == 0) {
+        switch (normalisedAngle) {
+        case 0:
+            return image;
+        case 90:
+            return rotate90(image, true);
+        case 180:
+            return rotate180(image);
+        case 270:
+            return rotate90(image, false);
+        }
+    }
+
     const QPoint center = image.rect().center();
     QTransform transform;
     transform.translate(center.x(), center.y());
@@ -100,29 +171,173 @@ QImage ImageUtils::rotate(const QImage &image, int angle)
 }
 
 /*!
-    1. Copies \a area in \a image.
-    2. Erases \a area in \a image, filling it with transparency.
-    3. Pastes the rotated image from step 1 at the centre of \a area.
-    4. Tries to move the rotated area within the bounds of the image if it's outside.
-    5. Crops the the rotated image if it's too large.
-    6. Returns the final rotated image portion and sets \a inRotatedArea as the area
+    Flips the pixels within \a area of \a image in place.
+*/
+void ImageUtils::flip(QImage &image, const QRect &area, Qt::Orientation orientation)
+{
+    if (image.depth() != 32 || !image.rect().contains(area)) {
+        if (area == image.rect()) {
+            image = image.mirrored(orientation == Qt::Horizontal, orientation == Qt::Vertical);
+            return;
+        }
+
+        const QImage flippedImagePortion = image.copy(area)
+            .mirrored(orientation == Qt::Horizontal, orientation == Qt::Vertical);
+        image = replacePortionOfImage(image, area, flippedImagePortion);
+        return;
+    }
+
+    if (orientation == Qt::Horizontal) {
+        for (int y = area.top(); y <= area.bottom(); ++y) {
+            auto row = reinterpret_cast<quint32*>(image.scanLine(y));
+            std::reverse(row + area.left(), row + area.right() + 1);
+        }
+    } else {
+        for (int topY = area.top(), bottomY = area.bottom(); topY < bottomY; ++topY, --bottomY) {
+            auto topRow = reinterpret_cast<quint32*>(image.scanLine(topY)) + area.left();
+            auto bottomRow = reinterpret_cast<quint32*>(image.scanLine(bottomY)) + area.left();
+            std::swap_ranges(topRow, topRow + area.width(), bottomRow);
+        }
+    }
+}
+
+/*!
+    Copies the pixels within \a sourceArea of \a sourceImage into \a targetImage
+    at \a targetTopLeft, replacing what was there (i.e. no blending is done).
+
+    Anything that falls outside of either image is ignored.
+*/
+void ImageUtils::copyPixels(const QImage &sourceImage, const QRect &sourceArea, QImage &targetImage, const QPoint &targetTopLeft)
+{
+    // Clip the area to both images.
+    QRect area = sourceArea.intersected(sourceImage.rect());
+    area = area.intersected(targetImage.rect().translated(sourceArea.topLeft() - targetTopLeft));
+    if (area.isEmpty())
+        return;
+
+    const QPoint targetPos = targetTopLeft + (area.topLeft() - sourceArea.topLeft());
+    if (sourceImage.format() != targetImage.format() || targetImage.depth() != 32) {
+        QPainter painter(&targetImage);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(targetPos, sourceImage, area);
+        return;
+    }
+
+    const size_t bytesPerRow = size_t(area.width()) * sizeof(quint32);
+    for (int y = 0; y < area.height(); ++y) {
+        const auto sourceRow = reinterpret_cast<const quint32*>(sourceImage.constScanLine(area.y() + y)) + area.x();
+        auto targetRow = reinterpret_cast<quint32*>(targetImage.scanLine(targetPos.y() + y)) + targetPos.x();
+        memcpy(targetRow, sourceRow, bytesPerRow);
+    }
+}
+
+/*!
+    Makes the pixels within \a area of \a image fully transparent.
+*/
+void ImageUtils::erasePixels(QImage &image, const QRect &area)
+{
+    const QRect clippedArea = area.intersected(image.rect());
+    if (clippedArea.isEmpty())
+        return;
+
+    // All of the 32 bit formats with an alpha channel that we use
+    // represent fully transparent pixels with zero bytes.
+    if (image.depth() != 32 || !image.hasAlphaChannel()) {
+        QPainter painter(&image);
+        painter.setCompositionMode(QPainter::CompositionMode_Clear);
+        painter.fillRect(clippedArea, Qt::transparent);
+        return;
+    }
+
+    const size_t bytesPerRow = size_t(clippedArea.width()) * sizeof(quint32);
+    for (int y = clippedArea.top(); y <= clippedArea.bottom(); ++y)
+        memset(reinterpret_cast<quint32*>(image.scanLine(y)) + clippedArea.left(), 0, bytesPerRow);
+}
+
+/*!
+    Returns the smallest rect within \a area of \a image that contains
+    every pixel that erasePixels() would change, or an empty rect if there
+    are none.
+
+    Images that erasePixels() doesn't write to directly aren't scanned;
+    \a area (clipped to the image) is returned for them.
+*/
+QRect ImageUtils::unerasedPixelBounds(const QImage &image, const QRect &area)
+{
+    const QRect clippedArea = area.intersected(image.rect());
+    if (clippedArea.isEmpty() || image.depth() != 32 || !image.hasAlphaChannel())
+        return clippedArea;
+
+    int left = clippedArea.right() + 1;
+    int right = clippedArea.left() - 1;
+    int top = clippedArea.bottom() + 1;
+    int bottom = clippedArea.top() - 1;
+    for (int y = clippedArea.top(); y <= clippedArea.bottom(); ++y) {
+        const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        for (int x = clippedArea.left(); x <= clippedArea.right(); ++x) {
+            if (row[x] == 0)
+                continue;
+
+            left = qMin(left, x);
+            right = qMax(right, x);
+            top = qMin(top, y);
+            bottom = qMax(bottom, y);
+        }
+    }
+
+    if (left > right)
+        return QRect();
+
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+/*!
+    Returns the value that \a image would store for \a colour, as if it
+    had been set with QImage::setPixelColor().
+*/
+uint ImageUtils::rawPixelValue(const QImage &image, const QColor &colour)
+{
+    if (image.depth() != 32)
+        return colour.rgba();
+
+    QImage pixel(1, 1, image.format());
+    pixel.setPixelColor(0, 0, colour);
+    return *reinterpret_cast<const quint32*>(pixel.constScanLine(0));
+}
+
+uint ImageUtils::rawPixel(const QImage &image, int x, int y)
+{
+    if (image.depth() != 32)
+        return image.pixelColor(x, y).rgba();
+
+    return reinterpret_cast<const quint32*>(image.constScanLine(y))[x];
+}
+
+void ImageUtils::setRawPixel(QImage &image, int x, int y, uint value)
+{
+    if (image.depth() != 32) {
+        image.setPixelColor(x, y, QColor::fromRgba(value));
+        return;
+    }
+
+    reinterpret_cast<quint32*>(image.scanLine(y))[x] = value;
+}
+
+/*!
+    1. Copies \a area in \a image and rotates it.
+    2. Centres the rotated image from step 1 over the centre of \a area.
+    3. Tries to move the rotated area within the bounds of the image if it's outside.
+    4. Crops the the rotated image if it's too large.
+    5. Returns the final rotated image portion and sets \a inRotatedArea as the area
        representing the newly rotated \a area.
 */
 QImage ImageUtils::rotateAreaWithinImage(const QImage &image, const QRect &area, int angle, QRect &inRotatedArea)
 {
-    QImage result = image;
     const QPoint areaCentre = area.center();
 
     // Create an image from the target area and then rotate it.
     // The resulting image will be big enough to contain the rotation.
-    QImage rotatedImagePortion = image.copy(area);
-    QTransform transform;
-    transform.translate(areaCentre.x(), areaCentre.y());
-    transform.rotate(angle);
-    rotatedImagePortion = rotatedImagePortion.transformed(transform);
-
-    // Remove what was behind the area and replace it with transparency.
-    result = erasePortionOfImage(result, area);
+    QImage rotatedImagePortion = rotate(image.copy(area), angle);
 
     // Centre the rotated image over the target area's centre...
     QRect rotatedArea = rotatedImagePortion.rect();
@@ -151,15 +366,60 @@ QImage ImageUtils::rotateAreaWithinImage(const QImage &image, const QRect &area,
     return rotatedImagePortion;
 }
 
-QImage ImageUtils::moveContents(const QImage &image, int xDistance, int yDistance)
+/*!
+    Returns a copy of \a image with its contents moved by \a xDistance and \a yDistance.
+
+    If \a wrapAround is \c true, contents that are moved past one edge come back in
+    at the opposite edge, so that e.g. the seams of a tiling texture can be moved
+    into the middle to be worked on. Otherwise, they're cut off and the area that
+    they leave behind is transparent.
+
+    32 bit images with an alpha channel are moved a row at a time straight into
+    the new image; others go through QPainter.
+*/
+QImage ImageUtils::moveContents(const QImage &image, int xDistance, int yDistance, bool wrapAround)
 {
-    QImage translated = filledImage(image.size());
+    if (image.isNull())
+        return image;
+
+    const int width = image.width();
+    const int height = image.height();
+    // Where the top left of the image ends up when wrapping around.
+    const int wrappedX = ((xDistance % width) + width) % width;
+    const int wrappedY = ((yDistance % height) + height) % height;
+
+    if (image.depth() != 32 || !image.hasAlphaChannel()) {
+        QImage moved = filledImage(image.size());
+        QPainter painter(&moved);
+        if (!wrapAround) {
+            painter.drawImage(xDistance, yDistance, image);
+        } else {
+            // Draw the image at each of the four positions that overlap the image's bounds.
+            for (const int x : { wrappedX, wrappedX - width }) {
+                for (const int y : { wrappedY, wrappedY - height })
+                    painter.drawImage(x, y, image);
+            }
+        }
+        return moved;
+    }
 
-    QPainter painter(&translated);
-    painter.drawImage(xDistance, yDistance, image);
-    painter.end();
+    QImage moved(image.size(), image.format());
+    if (!wrapAround) {
+        // Clear the area that's left behind (all of it, for simplicity), then copy the rows over.
+        moved.fill(Qt::transparent);
+        const QRect sourceArea = image.rect().intersected(image.rect().translated(-xDistance, -yDistance));
+        copyPixels(image, sourceArea, moved, sourceArea.topLeft() + QPoint(xDistance, yDistance));
+        return moved;
+    }
 
-    return translated;
+    for (int y = 0; y < height; ++y) {
+        const auto sourceRow = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        auto targetRow = reinterpret_cast<quint32*>(moved.scanLine((y + wrappedY) % height));
+        // The pixels that go past the right edge come back in on the left.
+        memcpy(targetRow + wrappedX, sourceRow, size_t(width - wrappedX) * sizeof(quint32));
+        memcpy(targetRow, sourceRow + width - wrappedX, size_t(wrappedX) * sizeof(quint32));
+    }
+    return moved;
 }
 
 QImage ImageUtils::resizeContents(const QImage &image, int newWidth, int newHeight, bool smooth)
@@ -169,10 +429,159 @@ QImage ImageUtils::resizeContents(const QImage &image, int newWidth, int newHeig
 
 QImage ImageUtils::resizeContents(const QImage &image, const QSize &newSize, bool smooth)
 {
+    if (!smooth && !image.isNull() && newSize.width() > image.width()
+            && newSize.width() % image.width() == 0 && newSize.height() % image.height() == 0) {
+        const int factor = newSize.width() / image.width();
+        if (newSize.height() / image.height() == factor)
+            return upscale(image, factor);
+    }
+
     return image.scaled(newSize, Qt::IgnoreAspectRatio,
         smooth ? Qt::SmoothTransformation : Qt::FastTransformation);
 }
 
+static QImage upscaleNearestNeighbour(const QImage &image, int factor)
+{
+    QImage upscaled(image.size() * factor, image.format());
+    const int width = image.width();
+    const size_t bytesPerUpscaledRow = size_t(upscaled.width()) * sizeof(quint32);
+    for (int y = 0; y < image.height(); ++y) {
+        const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        auto upscaledRow = reinterpret_cast<quint32*>(upscaled.scanLine(y * factor));
+        for (int x = 0; x < width; ++x)
+            std::fill_n(upscaledRow + x * factor, factor, row[x]);
+
+        // The rest of the rows for this source row are identical to the first.
+        for (int i = 1; i < factor; ++i)
+            memcpy(upscaled.scanLine(y * factor + i), upscaledRow, bytesPerUpscaledRow);
+    }
+    return upscaled;
+}
+
+// https://www.scale2x.it/algorithm
+static QImage scale2x(const QImage &image)
+{
+    QImage upscaled(image.size() * 2, image.format());
+    const int lastX = image.width() - 1;
+    const int lastY = image.height() - 1;
+    for (int y = 0; y <= lastY; ++y) {
+        const auto rowAbove = reinterpret_cast<const quint32*>(image.constScanLine(qMax(y - 1, 0)));
+        const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        const auto rowBelow = reinterpret_cast<const quint32*>(image.constScanLine(qMin(y + 1, lastY)));
+        auto upscaledRow0 = reinterpret_cast<quint32*>(upscaled.scanLine(y * 2));
+        auto upscaledRow1 = reinterpret_cast<quint32*>(upscaled.scanLine(y * 2 + 1));
+        for (int x = 0; x <= lastX; ++x) {
+            const quint32 b = rowAbove[x];
+            const quint32 d = row[qMax(x - 1, 0)];
+            const quint32 e = row[x];
+            const quint32 f = row[qMin(x + 1, lastX)];
+            const quint32 h = rowBelow[x];
+            if (b != h && d != f) {
+                upscaledRow0[x * 2] = d == b ? d : e;
+                upscaledRow0[x * 2 + 1] = b == f ? f : e;
+                upscaledRow1[x * 2] = d == h ? d : e;
+                upscaledRow1[x * 2 + 1] = h == f ? f : e;
+            } else {
+                upscaledRow0[x * 2] = e;
+                upscaledRow0[x * 2 + 1] = e;
+                upscaledRow1[x * 2] = e;
+                upscaledRow1[x * 2 + 1] = e;
+            }
+        }
+    }
+    return upscaled;
+}
+
+// https://www.scale2x.it/algorithm
+static QImage scale3x(const QImage &image)
+{
+    QImage upscaled(image.size() * 3, image.format());
+    const int lastX = image.width() - 1;
+    const int lastY = image.height() - 1;
+    for (int y = 0; y <= lastY; ++y) {
+        const auto rowAbove = reinterpret_cast<const quint32*>(image.constScanLine(qMax(y - 1, 0)));
+        const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        const auto rowBelow = reinterpret_cast<const quint32*>(image.constScanLine(qMin(y + 1, lastY)));
+        auto upscaledRow0 = reinterpret_cast<quint32*>(upscaled.scanLine(y * 3));
+        auto upscaledRow1 = reinterpret_cast<quint32*>(upscaled.scanLine(y * 3 + 1));
+        auto upscaledRow2 = reinterpret_cast<quint32*>(upscaled.scanLine(y * 3 + 2));
+        for (int x = 0; x <= lastX; ++x) {
+            const int previousX = qMax(x - 1, 0);
+            const int nextX = qMin(x + 1, lastX);
+            const quint32 a = rowAbove[previousX];
+            const quint32 b = rowAbove[x];
+            const quint32 c = rowAbove[nextX];
+            const quint32 d = row[previousX];
+            const quint32 e = row[x];
+            const quint32 f = row[nextX];
+            const quint32 g = rowBelow[previousX];
+            const quint32 h = rowBelow[x];
+            const quint32 i = rowBelow[nextX];
+            quint32 *e0 = upscaledRow0 + x * 3;
+            quint32 *e3 = upscaledRow1 + x * 3;
+            quint32 *e6 = upscaledRow2 + x * 3;
+            if (b != h && d != f) {
+                e0[0] = d == b ? d : e;
+                e0[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+                e0[2] = b == f ? f : e;
+                e3[0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+                e3[1] = e;
+                e3[2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+                e6[0] = d == h ? d : e;
+                e6[1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+                e6[2] = h == f ? f : e;
+            } else {
+                std::fill_n(e0, 3, e);
+                std::fill_n(e3, 3, e);
+                std::fill_n(e6, 3, e);
+            }
+        }
+    }
+    return upscaled;
+}
+
+static_assert(int(ImageUtils::NearestNeighbourUpscaler) == int(AnimationPlayback::NearestNeighbourUpscaler)
+    && int(ImageUtils::Scale2xUpscaler) == int(AnimationPlayback::Scale2xUpscaler)
+    && int(ImageUtils::Scale3xUpscaler) == int(AnimationPlayback::Scale3xUpscaler),
+    "AnimationPlayback::Upscaler must match ImageUtils::Upscaler");
+
+/*!
+    Returns \a image scaled up by \a factor using \a upscaler.
+
+    Unlike QImage::scaled(), this works directly on the scanlines of the image
+    rather than going through the generic transformation code, which makes a big
+    difference for the large integer scales that pixel art is typically exported at.
+*/
+QImage ImageUtils::upscale(const QImage &image, int factor, Upscaler upscaler)
+{
+    Q_ASSERT(factor >= 1);
+    if (image.isNull() || factor <= 1)
+        return image;
+
+    // The kernels work on 32 bit pixels.
+    const bool needsConversion = image.depth() != 32;
+    QImage upscaled = needsConversion ? image.convertToFormat(QImage::Format_ARGB32_Premultiplied) : image;
+
+    if (upscaler == Scale2xUpscaler) {
+        for (; factor % 2 == 0; factor /= 2)
+            upscaled = scale2x(upscaled);
+    } else if (upscaler == Scale3xUpscaler) {
+        for (; factor % 3 == 0; factor /= 3)
+            upscaled = scale3x(upscaled);
+    }
+
+    if (factor > 1)
+        upscaled = upscaleNearestNeighbour(upscaled, factor);
+
+    // No new colours are introduced, so an indexed image's colour table still covers every pixel.
+    if (needsConversion) {
+        upscaled = image.colorCount() > 0
+            ? upscaled.convertToFormat(image.format(), image.colorTable())
+            : upscaled.convertToFormat(image.format());
+    }
+    return upscaled;
+}
+
 QVector<QImage> ImageUtils::rearrangeContentsIntoGrid(const QVector<QImage> &images, uint cellWidth, uint cellHeight,
     uint columns, uint rows)
 {
@@ -288,6 +697,35 @@ QVector<QImage> ImageUtils::rearrangeContentsIntoGrid(const QVector<QImage> &ima
     return newImages;
 }
 
+/*!
+    Returns the contents of \a image within \a copyArea, cropped to the pixels
+    that aren't erased.
+*/
+CopiedLayerImage ImageUtils::copyLayerImage(const QImage &image, const QRect &copyArea)
+{
+    CopiedLayerImage copiedLayerImage;
+    const QRect bounds = unerasedPixelBounds(image, copyArea);
+    if (!bounds.isEmpty()) {
+        copiedLayerImage.image = image.copy(bounds);
+        copiedLayerImage.offset = bounds.topLeft() - copyArea.topLeft();
+    }
+    return copiedLayerImage;
+}
+
+/*!
+    Replaces the contents of \a image within \a pasteRect with \a copiedLayerImage,
+    as if the uncropped image had been drawn there with QPainter::CompositionMode_Source.
+    Only the pixels within \a pasteRect are touched.
+*/
+void ImageUtils::pasteCopiedLayerImage(QImage &image, const QRect &pasteRect, const CopiedLayerImage &copiedLayerImage)
+{
+    erasePixels(image, pasteRect);
+    if (!copiedLayerImage.image.isNull()) {
+        copyPixels(copiedLayerImage.image, copiedLayerImage.image.rect(),
+            image, pasteRect.topLeft() + copiedLayerImage.offset);
+    }
+}
+
 QVector<QImage> ImageUtils::pasteAcrossLayers(const QVector<ImageLayer *> &layers, const QVector<QImage> &layerImagesBeforeLivePreview,
     int pasteX, int pasteY, bool onlyPasteIntoVisibleLayers)
 {
@@ -300,19 +738,15 @@ QVector<QImage> ImageUtils::pasteAcrossLayers(const QVector<ImageLayer *> &layer
         return newImages;
     }
 
+    const QVector<CopiedLayerImage> copiedLayerImages = Clipboard::instance()->copiedLayerImages();
+    const QRect pasteRect(QPoint(pasteX, pasteY), Clipboard::instance()->copiedLayerAreaSize());
+    newImages.reserve(layers.size());
     for (int layerIndex = 0; layerIndex < layers.size(); ++layerIndex) {
         const auto layer = layers.at(layerIndex);
-        const bool layerVisible = layer->isVisible();
-        const QImage oldImage = layerImagesBeforeLivePreview.at(layerIndex);
-        if (onlyPasteIntoVisibleLayers && !layerVisible) {
-            // This is lazy and inefficient (we could e.g. store a null QImage),
-            // but it avoids adding more code paths elsewhere.
-            newImages.append(oldImage);
-        } else {
-            const auto pasteImage = Clipboard::instance()->copiedLayerImages().at(layerIndex);
-            const QRect pasteRect(pasteX, pasteY, pasteImage.width(), pasteImage.height());
-            newImages.append(ImageUtils::replacePortionOfImage(oldImage, pasteRect, pasteImage));
-        }
+        QImage newImage = layerImagesBeforeLivePreview.at(layerIndex);
+        if (!onlyPasteIntoVisibleLayers || layer->isVisible())
+            pasteCopiedLayerImage(newImage, pasteRect, copiedLayerImages.at(layerIndex));
+        newImages.append(newImage);
     }
     return newImages;
 }
@@ -367,6 +801,132 @@ QRect ImageUtils::ensureWithinArea(const QRect &rect, const QSize &boundsSize)
     return newArea;
 }
 
+// The first pixel of a sourceLength-long row or column that the target pixel at targetIndex covers.
+static int downsampleSourceStart(int targetIndex, int sourceLength, int targetLength)
+{
+    return int(qint64(targetIndex) * sourceLength / targetLength);
+}
+
+// One past the last source pixel that the target pixel at targetIndex covers.
+// Every target pixel covers at least one source pixel.
+static int downsampleSourceEnd(int targetIndex, int sourceLength, int targetLength)
+{
+    return qMax(downsampleSourceStart(targetIndex + 1, sourceLength, targetLength),
+        downsampleSourceStart(targetIndex, sourceLength, targetLength) + 1);
+}
+
+// The inverse of the functions above: the range of target pixels that cover any of the source pixels
+// from sourceFirst to sourceLast (inclusive). We start from an estimate and then correct it, since
+// it's the rounding of the forward mapping that determines which target pixels are affected.
+static void downsampleTargetRange(int sourceFirst, int sourceLast, int sourceLength, int targetLength,
+    int &targetFirst, int &targetLast)
+{
+    targetFirst = qBound(0, int(qint64(sourceFirst) * targetLength / sourceLength), targetLength - 1);
+    while (targetFirst > 0 && downsampleSourceEnd(targetFirst - 1, sourceLength, targetLength) > sourceFirst)
+        --targetFirst;
+    while (targetFirst < targetLength - 1 && downsampleSourceEnd(targetFirst, sourceLength, targetLength) <= sourceFirst)
+        ++targetFirst;
+
+    targetLast = qBound(0, int(qint64(sourceLast) * targetLength / sourceLength), targetLength - 1);
+    while (targetLast < targetLength - 1 && downsampleSourceStart(targetLast + 1, sourceLength, targetLength) <= sourceLast)
+        ++targetLast;
+    while (targetLast > 0 && downsampleSourceStart(targetLast, sourceLength, targetLength) > sourceLast)
+        --targetLast;
+}
+
+/*!
+    Returns the pixels of an image of size \a sourceSize that
+    downsample() needs in order to produce \a targetRect of an image
+    of size \a targetSize.
+*/
+QRect ImageUtils::downsampleSourceRect(const QSize &sourceSize, const QSize &targetSize, const QRect &targetRect)
+{
+    const QRect rect = targetRect.intersected(QRect(QPoint(0, 0), targetSize));
+    if (rect.isEmpty() || sourceSize.isEmpty())
+        return QRect();
+
+    const QPoint topLeft(downsampleSourceStart(rect.left(), sourceSize.width(), targetSize.width()),
+        downsampleSourceStart(rect.top(), sourceSize.height(), targetSize.height()));
+    const QPoint bottomRight(downsampleSourceEnd(rect.right(), sourceSize.width(), targetSize.width()) - 1,
+        downsampleSourceEnd(rect.bottom(), sourceSize.height(), targetSize.height()) - 1);
+    return QRect(topLeft, bottomRight);
+}
+
+/*!
+    Returns the pixels of a downsampled image of size \a targetSize that
+    are affected by a change to \a sourceRect of an image of size \a sourceSize.
+*/
+QRect ImageUtils::downsampleTargetRect(const QSize &sourceSize, const QSize &targetSize, const QRect &sourceRect)
+{
+    const QRect rect = sourceRect.intersected(QRect(QPoint(0, 0), sourceSize));
+    if (rect.isEmpty() || targetSize.isEmpty())
+        return QRect();
+
+    int left = 0;
+    int right = 0;
+    downsampleTargetRange(rect.left(), rect.right(), sourceSize.width(), targetSize.width(), left, right);
+    int top = 0;
+    int bottom = 0;
+    downsampleTargetRange(rect.top(), rect.bottom(), sourceSize.height(), targetSize.height(), top, bottom);
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+/*!
+    Downsamples an image of size \a sourceSize to \a targetSize using a box
+    filter, where each target pixel is the average of the source pixels it
+    covers. Only the pixels within \a targetRect are computed, and they're
+    returned as an image of that size.
+
+    \a source only needs to contain downsampleSourceRect() of the source
+    image, with its top-left corner at \a sourceOffset within the source
+    image. This means that a portion of a downsampled image can be updated
+    without the rest of the source image, and the result is identical to
+    downsampling the whole image.
+*/
+QImage ImageUtils::downsample(const QImage &source, const QPoint &sourceOffset, const QSize &sourceSize,
+    const QSize &targetSize, const QRect &targetRect)
+{
+    const QRect rect = targetRect.intersected(QRect(QPoint(0, 0), targetSize));
+    if (rect.isEmpty() || sourceSize.isEmpty())
+        return QImage();
+
+    Q_ASSERT(QRect(sourceOffset, source.size()).contains(downsampleSourceRect(sourceSize, targetSize, rect)));
+
+    // Averaging premultiplied pixels gives the correct weight to translucent ones.
+    const QImage premultipliedSource = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage target(rect.size(), QImage::Format_ARGB32_Premultiplied);
+    for (int targetY = rect.top(); targetY <= rect.bottom(); ++targetY) {
+        const int sourceTop = downsampleSourceStart(targetY, sourceSize.height(), targetSize.height()) - sourceOffset.y();
+        const int sourceBottom = downsampleSourceEnd(targetY, sourceSize.height(), targetSize.height()) - sourceOffset.y();
+        auto targetRow = reinterpret_cast<QRgb*>(target.scanLine(targetY - rect.top()));
+
+        for (int targetX = rect.left(); targetX <= rect.right(); ++targetX) {
+            const int sourceLeft = downsampleSourceStart(targetX, sourceSize.width(), targetSize.width()) - sourceOffset.x();
+            const int sourceRight = downsampleSourceEnd(targetX, sourceSize.width(), targetSize.width()) - sourceOffset.x();
+
+            quint64 red = 0;
+            quint64 green = 0;
+            quint64 blue = 0;
+            quint64 alpha = 0;
+            for (int sourceY = sourceTop; sourceY < sourceBottom; ++sourceY) {
+                const auto sourceRow = reinterpret_cast<const QRgb*>(premultipliedSource.constScanLine(sourceY));
+                for (int sourceX = sourceLeft; sourceX < sourceRight; ++sourceX) {
+                    const QRgb pixel = sourceRow[sourceX];
+                    red += qRed(pixel);
+                    green += qGreen(pixel);
+                    blue += qBlue(pixel);
+                    alpha += qAlpha(pixel);
+                }
+            }
+
+            const quint64 count = quint64(sourceRight - sourceLeft) * quint64(sourceBottom - sourceTop);
+            targetRow[targetX - rect.left()] = qRgba(int((red + count / 2) / count), int((green + count / 2) / count),
+                int((blue + count / 2) / count), int((alpha + count / 2) / count));
+        }
+    }
+    return target;
+}
+
 void ImageUtils::modifyHsl(QImage &image, qreal hue, qreal saturation, qreal lightness, qreal alpha,
     ImageCanvas::AlphaAdjustmentFlags alphaAdjustmentFlags)
 {
@@ -407,6 +967,186 @@ void ImageUtils::modifyHsl(QImage &image, qreal hue, qreal saturation, qreal lig
     }
 }
 
+/*!
+    Returns the smallest rect that contains every pixel that differs between
+    \a image and \a previousImage, or a null rect if they are identical.
+
+    Both images must be the same size and have a 32 bit format.
+*/
+static QRect differingArea(const QImage &image, const QImage &previousImage)
+{
+    Q_ASSERT(image.size() == previousImage.size());
+    Q_ASSERT(image.depth() == 32 && previousImage.depth() == 32);
+
+    const int width = image.width();
+    const int height = image.height();
+    const size_t bytesPerRow = size_t(width) * sizeof(quint32);
+
+    // Whole rows can be compared in one go, which quickly skips past the
+    // (usually large) unchanged areas above and below the changes.
+    int top = 0;
+    while (top < height && memcmp(image.constScanLine(top), previousImage.constScanLine(top), bytesPerRow) == 0)
+        ++top;
+    if (top == height)
+        return QRect();
+
+    int bottom = height - 1;
+    while (bottom > top && memcmp(image.constScanLine(bottom), previousImage.constScanLine(bottom), bytesPerRow) == 0)
+        --bottom;
+
+    int left = width;
+    int right = -1;
+    for (int y = top; y <= bottom; ++y) {
+        const auto row = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        const auto previousRow = reinterpret_cast<const quint32*>(previousImage.constScanLine(y));
+        for (int x = 0; x < left; ++x) {
+            if (row[x] != previousRow[x]) {
+                left = x;
+                break;
+            }
+        }
+        for (int x = width - 1; x > right; --x) {
+            if (row[x] != previousRow[x]) {
+                right = x;
+                break;
+            }
+        }
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+static void appendGifUInt16(QByteArray &data, int value)
+{
+    data.append(char(value & 0xFF));
+    data.append(char((value >> 8) & 0xFF));
+}
+
+// Skips the data sub-blocks starting at index, returning the index after the block
+// terminator, or -1 if the data ends before the terminator.
+static int skipGifSubBlocks(const QByteArray &data, int index)
+{
+    while (index < data.size()) {
+        const int blockSize = uchar(data.at(index));
+        index += 1 + blockSize;
+        if (blockSize == 0)
+            return index;
+    }
+    return -1;
+}
+
+static void appendGifHeader(QByteArray &data, int width, int height)
+{
+    data.append("GIF89a", 6);
+    // Logical screen descriptor. There is no global colour table,
+    // as each frame has its own; see appendGifFrame().
+    appendGifUInt16(data, width);
+    appendGifUInt16(data, height);
+    data.append(char(0x70));
+    // Background colour index and pixel aspect ratio.
+    data.append(char(0));
+    data.append(char(0));
+    // The Netscape application extension, to loop forever.
+    data.append("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19);
+}
+
+/*!
+    Takes the image in \a encodedFrame (a complete single-frame GIF stream) and
+    appends it to \a data at \a position, to be shown for \a delayInCentiseconds.
+
+    The frame is left in place once its delay is up, so that the next frame
+    only needs to cover the area that changed.
+
+    Returns \c false if \a encodedFrame contains no image or is malformed.
+*/
+static bool appendGifFrame(QByteArray &data, const QByteArray &encodedFrame, const QPoint &position, int delayInCentiseconds)
+{
+    // Header and logical screen descriptor.
+    static const int screenDescriptorEnd = 13;
+    if (encodedFrame.size() < screenDescriptorEnd || !encodedFrame.startsWith("GIF8"))
+        return false;
+
+    int index = screenDescriptorEnd;
+    const uchar screenFields = uchar(encodedFrame.at(10));
+    QByteArray globalColourTable;
+    if (screenFields & 0x80) {
+        const int tableSize = 3 * (1 << ((screenFields & 0x07) + 1));
+        globalColourTable = encodedFrame.mid(index, tableSize);
+        index += tableSize;
+    }
+
+    uchar controlFields = 0;
+    uchar transparentIndex = 0;
+    while (index >= 0 && index < encodedFrame.size()) {
+        const uchar introducer = uchar(encodedFrame.at(index));
+        if (introducer == 0x21 && index + 1 < encodedFrame.size()) {
+            // Extension. We only care about the graphic control extension.
+            const uchar label = uchar(encodedFrame.at(index + 1));
+            if (label == 0xF9 && index + 6 < encodedFrame.size()) {
+                controlFields = uchar(encodedFrame.at(index + 3));
+                transparentIndex = uchar(encodedFrame.at(index + 6));
+            }
+            index = skipGifSubBlocks(encodedFrame, index + 2);
+        } else if (introducer == 0x2C && index + 10 <= encodedFrame.size()) {
+            // Image descriptor.
+            uchar descriptorFields = uchar(encodedFrame.at(index + 9));
+            int imageDataStart = index + 10;
+            QByteArray colourTable;
+            if (descriptorFields & 0x80) {
+                const int tableSize = 3 * (1 << ((descriptorFields & 0x07) + 1));
+                colourTable = encodedFrame.mid(imageDataStart, tableSize);
+                imageDataStart += tableSize;
+            } else if (!globalColourTable.isEmpty()) {
+                // The global colour table of the encoded frame belongs to that
+                // frame only, so it becomes a local colour table in our GIF.
+                colourTable = globalColourTable;
+                descriptorFields = (descriptorFields & 0x40) | 0x80 | (screenFields & 0x07);
+            }
+            // Skip the LZW minimum code size and then the image data.
+            const int imageDataEnd = skipGifSubBlocks(encodedFrame, imageDataStart + 1);
+            if (imageDataEnd == -1)
+                return false;
+
+            // Graphic control extension: disposal method 1 ("do not dispose"),
+            // keeping whatever transparency the encoder chose.
+            data.append("\x21\xF9\x04", 3);
+            data.append(char((1 << 2) | (controlFields & 0x01)));
+            appendGifUInt16(data, delayInCentiseconds);
+            data.append(char(transparentIndex));
+            data.append(char(0));
+
+            data.append(char(0x2C));
+            appendGifUInt16(data, position.x());
+            appendGifUInt16(data, position.y());
+            // Width and height.
+            data.append(encodedFrame.mid(index + 5, 4));
+            data.append(char(descriptorFields));
+            data.append(colourTable);
+            data.append(encodedFrame.mid(imageDataStart, imageDataEnd - imageDataStart));
+            return true;
+        } else {
+            // Either the trailer or something we don't understand; either way, no image.
+            return false;
+        }
+    }
+    return false;
+}
+
+// gif-h reserves one palette entry for transparency. If the rest can hold every
+// colour of the image, it's encoded exactly and dithering has no effect.
+static bool hasExactGifPalette(const QImage &image)
+{
+    static const int maxColourCount = 255;
+    QSet<QRgb> colours;
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            colours.insert(image.pixel(x, y));
+            if (colours.size() > maxColourCount)
+                return false;
+        }
+    }
+    return true;
+}
+
 bool ImageUtils::exportGif(const QImage &gifSourceImage, const QUrl &url, const AnimationPlayback &playback, QString &errorMessage)
 {
     const QString path = url.toLocalFile();
@@ -430,6 +1170,8 @@ bool ImageUtils::exportGif(const QImage &gifSourceImage, const QUrl &url, const
     // http://giflib.sourceforge.net/gifstandard/GIF89a.html
     const int frameDelayInCentiseconds = 100.0 / animation->fps();
     static const bool dither = true;
+    // The delay is stored as an unsigned 16 bit integer.
+    static const int maxDelayInCentiseconds = 0xFFFF;
 
     qCDebug(lcUtils) << "original width:" << animation->frameWidth()
         << "original height:" << animation->frameHeight()
@@ -441,13 +1183,84 @@ bool ImageUtils::exportGif(const QImage &gifSourceImage, const QUrl &url, const
     // Convert it to an 8 bit image so that the byte order is as we expect.
     const QImage eightBitImage = gifSourceImage.convertToFormat(QImage::Format_RGBA8888);
 
+    struct GifFrame {
+        QImage image;
+        QPoint position;
+        int delayInCentiseconds;
+    };
+
+    // Sprite animations typically only change a small part of the frame from one
+    // frame to the next, so only the area that differs from the previous frame is
+    // encoded. Frames that are identical to the previous one just make it last longer.
+    //
+    // That's only done while every encoded area fits in a palette without dithering.
+    // Otherwise, an area would be dithered differently to the pixels around it
+    // (which belong to earlier frames), leaving visible seams, so we go back to
+    // letting gif-h encode whole frames, which it does relative to the previous one.
     std::vector<QImage> frameImages;
+    std::vector<GifFrame> gifFrames;
+    bool encodeChangedAreas = true;
+    const bool isIntegerScale = playback.scale() >= 1 && qFuzzyCompare(playback.scale(), qRound(playback.scale()));
+    QImage previousFrameImage;
+    int encodedPixelCount = 0;
 
     const int frameStartIndex = playback.animation()->startIndex(gifSourceImage.width());
     for (int frameIndex = frameStartIndex; frameIndex < frameStartIndex + animation->frameCount(); ++frameIndex) {
         const QImage frameSourceImage = imageForAnimationFrame(eightBitImage, playback, frameIndex - frameStartIndex);
-        const QImage scaledFrameSourceImage = frameSourceImage.scaled(frameSourceImage.size() * playback.scale());
+        const QImage scaledFrameSourceImage = isIntegerScale
+            ? upscale(frameSourceImage, qRound(playback.scale()), static_cast<Upscaler>(playback.upscaler()))
+            : frameSourceImage.scaled(frameSourceImage.size() * playback.scale());
         frameImages.push_back(scaledFrameSourceImage);
+        if (!encodeChangedAreas)
+            continue;
+
+        if (previousFrameImage.isNull()) {
+            gifFrames.push_back({ scaledFrameSourceImage, QPoint(0, 0), frameDelayInCentiseconds });
+        } else {
+            const QRect changedArea = differingArea(scaledFrameSourceImage, previousFrameImage);
+            GifFrame &lastGifFrame = gifFrames.back();
+            if (changedArea.isNull() && lastGifFrame.delayInCentiseconds + frameDelayInCentiseconds <= maxDelayInCentiseconds) {
+                lastGifFrame.delayInCentiseconds += frameDelayInCentiseconds;
+                continue;
+            }
+
+            // If the frame is identical but we can't extend the delay any further,
+            // encode a single pixel so that it still gets a frame of its own.
+            const QRect area = changedArea.isNull() ? QRect(0, 0, 1, 1) : changedArea;
+            gifFrames.push_back({ scaledFrameSourceImage.copy(area), area.topLeft(), frameDelayInCentiseconds });
+        }
+
+        if (!hasExactGifPalette(gifFrames.back().image)) {
+            qCDebug(lcUtils) << "frame" << frameIndex - frameStartIndex
+                << "has too many colours to be encoded exactly; encoding whole frames instead";
+            encodeChangedAreas = false;
+            continue;
+        }
+
+        encodedPixelCount += gifFrames.back().image.width() * gifFrames.back().image.height();
+        previousFrameImage = scaledFrameSourceImage;
+    }
+
+    QByteArray gifData;
+    if (encodeChangedAreas) {
+        qCDebug(lcUtils).nospace() << "encoding " << gifFrames.size() << " GIF frames for "
+            << animation->frameCount() << " animation frames; " << encodedPixelCount << " out of "
+            << width * height * animation->frameCount() << " pixels need encoding";
+
+        appendGifHeader(gifData, width, height);
+        for (size_t gifFrameIndex = 0; gifFrameIndex < gifFrames.size(); ++gifFrameIndex) {
+            const GifFrame &gifFrame = gifFrames.at(gifFrameIndex);
+            const QByteArray encodedFrame = GifH::GifWriter::encode(
+                std::vector<QImage>{ gifFrame.image }, gifFrame.delayInCentiseconds, dither);
+            if (!appendGifFrame(gifData, encodedFrame, gifFrame.position, gifFrame.delayInCentiseconds)) {
+                errorMessage = QObject::tr("Failed to export GIF: couldn't encode frame %1").arg(gifFrameIndex);
+                return false;
+            }
+        }
+        // Trailer.
+        gifData.append(char(0x3B));
+    } else {
+        gifData = GifH::GifWriter::encode(frameImages, frameDelayInCentiseconds, dither);
     }
 
     QFile file(path);
@@ -456,8 +1269,7 @@ bool ImageUtils::exportGif(const QImage &gifSourceImage, const QUrl &url, const
         return false;
     }
 
-    const auto data = GifH::GifWriter::encode(frameImages, frameDelayInCentiseconds, dither);
-    file.write(data);
+    file.write(gifData);
 
     qCDebug(lcUtils) << "... successfully exported gif";
 
@@ -488,6 +1300,103 @@ QImage ImageUtils::imageForAnimationFrame(const QImage &sourceImage, const Anima
     return image;
 }
 
+static bool tilesHaveEqualPixels(const QImage &image, const QPoint &topLeft,
+    const QPoint &otherTopLeft, const QSize &tileSize)
+{
+    const int bytesPerTileLine = tileSize.width() * 4;
+    for (int y = 0; y < tileSize.height(); ++y) {
+        const uchar *line = image.constScanLine(topLeft.y() + y) + topLeft.x() * 4;
+        const uchar *otherLine = image.constScanLine(otherTopLeft.y() + y) + otherTopLeft.x() * 4;
+        if (memcmp(line, otherLine, bytesPerTileLine) != 0)
+            return false;
+    }
+    return true;
+}
+
+/*!
+    Splits \a image into cells of \a tileSize and collapses cells with
+    identical pixels into one tile, so that the returned tileset image
+    contains each unique tile once.
+
+    Cells are hashed in parallel (one row of cells per task), and only
+    cells whose hashes are equal have their pixels compared. Any partial
+    cells at the right and bottom edges of the image are ignored.
+*/
+ImageUtils::ExtractedTiles ImageUtils::extractTiles(const QImage &sourceImage, const QSize &tileSize)
+{
+    ExtractedTiles extractedTiles;
+    if (sourceImage.isNull() || tileSize.isEmpty())
+        return extractedTiles;
+
+    const int cellsWide = sourceImage.width() / tileSize.width();
+    const int cellsHigh = sourceImage.height() / tileSize.height();
+    if (cellsWide == 0 || cellsHigh == 0)
+        return extractedTiles;
+
+    // Work on raw 32-bit pixels; this is a no-op for most images.
+    const QImage image = sourceImage.depth() == 32
+        ? sourceImage : sourceImage.convertToFormat(QImage::Format_ARGB32);
+    const int bytesPerTileLine = tileSize.width() * 4;
+
+    QVector<size_t> cellHashes(cellsWide * cellsHigh);
+    // Detach once up front; calling the non-const operator[] from the
+    // workers would race on the (shared) vector's reference count.
+    size_t *hashes = cellHashes.data();
+    QThreadPool threadPool;
+    for (int cellRow = 0; cellRow < cellsHigh; ++cellRow) {
+        threadPool.start([&, hashes, cellRow]() {
+            for (int cellColumn = 0; cellColumn < cellsWide; ++cellColumn) {
+                size_t hash = 0;
+                const int x = cellColumn * tileSize.width();
+                for (int y = cellRow * tileSize.height(); y < (cellRow + 1) * tileSize.height(); ++y)
+                    hash = qHashBits(image.constScanLine(y) + x * 4, bytesPerTileLine, hash);
+                hashes[cellRow * cellsWide + cellColumn] = hash;
+            }
+        });
+    }
+    threadPool.waitForDone();
+
+    // Hashes can collide, so each hash maps to all of the unique tiles that have it.
+    QHash<size_t, QVarLengthArray<int, 1>> uniqueTileIndicesForHash;
+    QVector<QPoint> uniqueTileTopLefts;
+    extractedTiles.tileIndices.resize(cellHashes.size());
+    for (int cellIndex = 0; cellIndex < cellHashes.size(); ++cellIndex) {
+        const QPoint topLeft((cellIndex % cellsWide) * tileSize.width(), (cellIndex / cellsWide) * tileSize.height());
+        QVarLengthArray<int, 1> &candidateIndices = uniqueTileIndicesForHash[cellHashes.at(cellIndex)];
+        int tileIndex = -1;
+        for (const int candidateIndex : candidateIndices) {
+            if (tilesHaveEqualPixels(image, topLeft, uniqueTileTopLefts.at(candidateIndex), tileSize)) {
+                tileIndex = candidateIndex;
+                break;
+            }
+        }
+
+        if (tileIndex == -1) {
+            tileIndex = uniqueTileTopLefts.size();
+            uniqueTileTopLefts.append(topLeft);
+            candidateIndices.append(tileIndex);
+        }
+        extractedTiles.tileIndices[cellIndex] = tileIndex;
+    }
+
+    // Lay the unique tiles out in a roughly square grid.
+    const int uniqueTileCount = uniqueTileTopLefts.size();
+    extractedTiles.tilesetTilesWide = qCeil(qSqrt(uniqueTileCount));
+    extractedTiles.tilesetTilesHigh = (uniqueTileCount + extractedTiles.tilesetTilesWide - 1) / extractedTiles.tilesetTilesWide;
+    extractedTiles.tilesetImage = QImage(extractedTiles.tilesetTilesWide * tileSize.width(),
+        extractedTiles.tilesetTilesHigh * tileSize.height(), image.format());
+    extractedTiles.tilesetImage.fill(Qt::transparent);
+    for (int tileIndex = 0; tileIndex < uniqueTileCount; ++tileIndex) {
+        const QPoint targetTopLeft((tileIndex % extractedTiles.tilesetTilesWide) * tileSize.width(),
+            (tileIndex / extractedTiles.tilesetTilesWide) * tileSize.height());
+        copyPixels(image, QRect(uniqueTileTopLefts.at(tileIndex), tileSize), extractedTiles.tilesetImage, targetTopLeft);
+    }
+
+    qCDebug(lcUtils).nospace() << "extracted " << uniqueTileCount << " unique tiles from "
+        << cellsWide * cellsHigh << " cells of size " << tileSize;
+    return extractedTiles;
+}
+
 ImageUtils::FindUniqueColoursResult ImageUtils::findUniqueColours(const QImage &image,
     int maximumUniqueColours, QVector<QColor> &uniqueColoursFound)
 {
@@ -28,6 +28,7 @@
 
 class AnimationPlayback;
 class ImageLayer;
+struct CopiedLayerImage;
 
 namespace ImageUtils {
     SLATE_EXPORT QImage filledImage(int width, int height, const QColor &colour = Qt::transparent);
@@ -39,31 +40,74 @@ namespace ImageUtils {
 
     QImage erasePortionOfImage(const QImage &image, const QRect &portion);
 
-    QImage rotate(const QImage &image, int angle);
+    SLATE_EXPORT QImage rotate(const QImage &image, int angle);
     QImage rotateAreaWithinImage(const QImage &image, const QRect &area, int angle, QRect &inRotatedArea);
+    SLATE_EXPORT void flip(QImage &image, const QRect &area, Qt::Orientation orientation);
 
-    SLATE_EXPORT QImage moveContents(const QImage &image, int xDistance, int yDistance);
+    SLATE_EXPORT void copyPixels(const QImage &sourceImage, const QRect &sourceArea, QImage &targetImage, const QPoint &targetTopLeft);
+    SLATE_EXPORT void erasePixels(QImage &image, const QRect &area);
+    SLATE_EXPORT QRect unerasedPixelBounds(const QImage &image, const QRect &area);
+
+    // Raw pixel access for pixel-by-pixel tools. For 32-bit images these are the
+    // values stored in the scanlines; other formats go through QColor::rgba().
+    SLATE_EXPORT uint rawPixelValue(const QImage &image, const QColor &colour);
+    SLATE_EXPORT uint rawPixel(const QImage &image, int x, int y);
+    SLATE_EXPORT void setRawPixel(QImage &image, int x, int y, uint value);
+
+    SLATE_EXPORT QImage moveContents(const QImage &image, int xDistance, int yDistance, bool wrapAround = false);
     SLATE_EXPORT QImage resizeContents(const QImage &image, int newWidth, int newHeight, bool smooth = false);
     SLATE_EXPORT QImage resizeContents(const QImage &image, const QSize &newSize, bool smooth = false);
+
+    enum Upscaler {
+        // Each pixel becomes a block of identical pixels.
+        NearestNeighbourUpscaler,
+        // Scale2x (also known as EPX) and Scale3x smooth out diagonal edges without
+        // introducing new colours. Factors that aren't a power of the kernel's own factor
+        // are upscaled by the kernel as far as possible, and then by nearest neighbour.
+        Scale2xUpscaler,
+        Scale3xUpscaler
+    };
+
+    // The result has the same format as image.
+    SLATE_EXPORT QImage upscale(const QImage &image, int factor, Upscaler upscaler = NearestNeighbourUpscaler);
     SLATE_EXPORT QVector<QImage> rearrangeContentsIntoGrid(const QVector<QImage> &images,
         uint cellWidth, uint cellHeight, uint columns, uint rows);
+    SLATE_EXPORT CopiedLayerImage copyLayerImage(const QImage &image, const QRect &copyArea);
+    SLATE_EXPORT void pasteCopiedLayerImage(QImage &image, const QRect &pasteRect, const CopiedLayerImage &copiedLayerImage);
     SLATE_EXPORT QVector<QImage> pasteAcrossLayers(const QVector<ImageLayer*> &layers,
         const QVector<QImage> &layerImagesBeforeLivePreview, int pasteX, int pasteY, bool onlyPasteIntoVisibleLayers);
 
-    void modifyHsl(QImage &image, qreal hue, qreal saturation, qreal lightness, qreal alpha,
+    SLATE_EXPORT void modifyHsl(QImage &image, qreal hue, qreal saturation, qreal lightness, qreal alpha,
         ImageCanvas::AlphaAdjustmentFlags alphaAdjustmentFlags);
 
     void strokeRectWithDashes(QPainter *painter, const QRect &rect);
 
     SLATE_EXPORT QRect ensureWithinArea(const QRect &rect, const QSize &boundsSize);
 
+    SLATE_EXPORT QRect downsampleSourceRect(const QSize &sourceSize, const QSize &targetSize, const QRect &targetRect);
+    SLATE_EXPORT QRect downsampleTargetRect(const QSize &sourceSize, const QSize &targetSize, const QRect &sourceRect);
+    SLATE_EXPORT QImage downsample(const QImage &source, const QPoint &sourceOffset, const QSize &sourceSize,
+        const QSize &targetSize, const QRect &targetRect);
+
+    struct ExtractedTiles
+    {
+        // The unique tiles, laid out left-to-right, top-to-bottom.
+        QImage tilesetImage;
+        int tilesetTilesWide = 0;
+        int tilesetTilesHigh = 0;
+        // The index (into the unique tiles) of each cell of the source image, row by row.
+        QVector<int> tileIndices;
+    };
+
+    SLATE_EXPORT ExtractedTiles extractTiles(const QImage &image, const QSize &tileSize);
+
     enum FindUniqueColoursResult {
         ThreadInterrupted,
         MaximumUniqueColoursExceeded,
         FindUniqueColoursSucceeded
     };
 
-    FindUniqueColoursResult findUniqueColours(const QImage &image, int maximumUniqueColours, QVector<QColor> &uniqueColoursFound);
+    SLATE_EXPORT FindUniqueColoursResult findUniqueColours(const QImage &image, int maximumUniqueColours, QVector<QColor> &uniqueColoursFound);
     FindUniqueColoursResult findUniqueColoursAndProbabilities(const QImage &image, int maximumUniqueColours,
         QVector<QColor> &uniqueColoursFound, QVector<qreal> &probabilities);
     QVarLengthArray<unsigned int> findMax256UniqueArgbColours(const QImage &image);
@@ -0,0 +1,276 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inputrecorder.h"
+
+#include <QJsonDocument>
+#include <QKeyEvent>
+#include <QLoggingCategory>
+#include <QMetaEnum>
+#include <QMouseEvent>
+#include <QSaveFile>
+#include <QWheelEvent>
+
+#include "canvaspane.h"
+#include "imagecanvas.h"
+#include "project.h"
+
+Q_LOGGING_CATEGORY(lcInputRecorder, "app.inputRecorder")
+
+QBasicAtomicInt InputRecorder::sRecording = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+Q_GLOBAL_STATIC(InputRecorder, inputRecorderInstance)
+
+template<typename T>
+static QString enumToString(T value)
+{
+    return QString::fromLatin1(QMetaEnum::fromType<T>().valueToKey(value));
+}
+
+static QJsonObject paneToJson(const CanvasPane *pane)
+{
+    QJsonObject paneObject;
+    pane->write(paneObject);
+    return paneObject;
+}
+
+InputRecorder::InputRecorder()
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+}
+
+InputRecorder *InputRecorder::instance()
+{
+    return inputRecorderInstance();
+}
+
+void InputRecorder::setRecording(bool recording)
+{
+    if (recording == isRecording())
+        return;
+
+    qCDebug(lcInputRecorder) << "setting recording to" << recording;
+
+    if (recording) {
+        sRecording.storeRelaxed(1);
+    } else {
+        sRecording.storeRelaxed(0);
+        write();
+    }
+}
+
+QString InputRecorder::filePath() const
+{
+    return mFilePath;
+}
+
+void InputRecorder::setFilePath(const QString &filePath)
+{
+    mFilePath = filePath;
+}
+
+void InputRecorder::recordEvent(ImageCanvas *canvas, const QEvent *event)
+{
+    if (!isSessionCanvas(canvas))
+        return;
+
+    QJsonObject eventObject;
+    QString type;
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseMove:
+    case QEvent::MouseButtonRelease: {
+        const QMouseEvent *mouseEvent = static_cast<const QMouseEvent*>(event);
+        type = event->type() == QEvent::MouseButtonPress ? QLatin1String("mousePress")
+            : event->type() == QEvent::MouseMove ? QLatin1String("mouseMove") : QLatin1String("mouseRelease");
+        eventObject.insert(QLatin1String("x"), mouseEvent->position().x());
+        eventObject.insert(QLatin1String("y"), mouseEvent->position().y());
+        eventObject.insert(QLatin1String("button"), int(mouseEvent->button()));
+        eventObject.insert(QLatin1String("buttons"), int(mouseEvent->buttons()));
+        eventObject.insert(QLatin1String("modifiers"), int(mouseEvent->modifiers()));
+        break;
+    }
+    case QEvent::HoverMove: {
+        const QHoverEvent *hoverEvent = static_cast<const QHoverEvent*>(event);
+        type = QLatin1String("hoverMove");
+        eventObject.insert(QLatin1String("x"), hoverEvent->position().x());
+        eventObject.insert(QLatin1String("y"), hoverEvent->position().y());
+        eventObject.insert(QLatin1String("modifiers"), int(hoverEvent->modifiers()));
+        break;
+    }
+    case QEvent::Wheel: {
+        const QWheelEvent *wheelEvent = static_cast<const QWheelEvent*>(event);
+        type = QLatin1String("wheel");
+        eventObject.insert(QLatin1String("x"), wheelEvent->position().x());
+        eventObject.insert(QLatin1String("y"), wheelEvent->position().y());
+        eventObject.insert(QLatin1String("pixelDeltaX"), wheelEvent->pixelDelta().x());
+        eventObject.insert(QLatin1String("pixelDeltaY"), wheelEvent->pixelDelta().y());
+        eventObject.insert(QLatin1String("angleDeltaX"), wheelEvent->angleDelta().x());
+        eventObject.insert(QLatin1String("angleDeltaY"), wheelEvent->angleDelta().y());
+        eventObject.insert(QLatin1String("modifiers"), int(wheelEvent->modifiers()));
+        break;
+    }
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease: {
+        const QKeyEvent *keyEvent = static_cast<const QKeyEvent*>(event);
+        type = event->type() == QEvent::KeyPress ? QLatin1String("keyPress") : QLatin1String("keyRelease");
+        eventObject.insert(QLatin1String("key"), keyEvent->key());
+        eventObject.insert(QLatin1String("modifiers"), int(keyEvent->modifiers()));
+        eventObject.insert(QLatin1String("text"), keyEvent->text());
+        eventObject.insert(QLatin1String("autoRepeat"), keyEvent->isAutoRepeat());
+        break;
+    }
+    default:
+        return;
+    }
+
+    appendEvent(type, eventObject);
+}
+
+void InputRecorder::recordAction(ImageCanvas *canvas, const QString &action)
+{
+    if (!isSessionCanvas(canvas))
+        return;
+
+    appendEvent(action);
+}
+
+bool InputRecorder::write()
+{
+    if (mSession.isEmpty())
+        return true;
+
+    QJsonObject sessionObject = mSession;
+    sessionObject.insert(QLatin1String("events"), mEvents);
+    const int eventCount = mEvents.size();
+
+    if (mCanvas) {
+        disconnect(mCanvas, nullptr, this, nullptr);
+        mCanvas.clear();
+    }
+    mProject.clear();
+    mSession = QJsonObject();
+    mEvents = QJsonArray();
+
+    QSaveFile file(mFilePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open input recording file" << mFilePath << "for writing:" << file.errorString();
+        return false;
+    }
+
+    file.write(QJsonDocument(sessionObject).toJson());
+    if (!file.commit()) {
+        qWarning() << "Failed to write input recording file" << mFilePath << ":" << file.errorString();
+        return false;
+    }
+
+    qInfo() << "Wrote" << eventCount << "input events to" << mFilePath;
+    return true;
+}
+
+void InputRecorder::onToolChanged()
+{
+    QJsonObject eventObject;
+    eventObject.insert(QLatin1String("tool"), enumToString(mCanvas->tool()));
+    appendEvent(QLatin1String("tool"), eventObject);
+}
+
+void InputRecorder::onToolShapeChanged()
+{
+    QJsonObject eventObject;
+    eventObject.insert(QLatin1String("toolShape"), enumToString(mCanvas->toolShape()));
+    appendEvent(QLatin1String("toolShape"), eventObject);
+}
+
+void InputRecorder::onToolSizeChanged()
+{
+    QJsonObject eventObject;
+    eventObject.insert(QLatin1String("toolSize"), mCanvas->toolSize());
+    appendEvent(QLatin1String("toolSize"), eventObject);
+}
+
+void InputRecorder::onPenForegroundColourChanged()
+{
+    QJsonObject eventObject;
+    eventObject.insert(QLatin1String("colour"), mCanvas->penForegroundColour().name(QColor::HexArgb));
+    appendEvent(QLatin1String("penForegroundColour"), eventObject);
+}
+
+void InputRecorder::onPenBackgroundColourChanged()
+{
+    QJsonObject eventObject;
+    eventObject.insert(QLatin1String("colour"), mCanvas->penBackgroundColour().name(QColor::HexArgb));
+    appendEvent(QLatin1String("penBackgroundColour"), eventObject);
+}
+
+bool InputRecorder::isSessionCanvas(ImageCanvas *canvas)
+{
+    if (!canvas->project() || !canvas->project()->hasLoaded())
+        return false;
+
+    if (mSession.isEmpty())
+        startSession(canvas);
+
+    return canvas == mCanvas && canvas->project() == mProject;
+}
+
+void InputRecorder::startSession(ImageCanvas *canvas)
+{
+    Project *project = canvas->project();
+    qCDebug(lcInputRecorder) << "starting session with" << canvas << "and" << project;
+
+    mCanvas = canvas;
+    mProject = project;
+    mSessionTimer.start();
+
+    mSession.insert(QLatin1String("version"), sessionVersion);
+    mSession.insert(QLatin1String("projectType"), project->typeString());
+    mSession.insert(QLatin1String("projectUrl"), project->url().toString());
+    mSession.insert(QLatin1String("imageWidth"), project->widthInPixels());
+    mSession.insert(QLatin1String("imageHeight"), project->heightInPixels());
+    mSession.insert(QLatin1String("canvasWidth"), canvas->width());
+    mSession.insert(QLatin1String("canvasHeight"), canvas->height());
+    mSession.insert(QLatin1String("splitScreen"), canvas->isSplitScreen());
+    mSession.insert(QLatin1String("firstPane"), paneToJson(canvas->firstPane()));
+    mSession.insert(QLatin1String("secondPane"), paneToJson(canvas->secondPane()));
+    mSession.insert(QLatin1String("tool"), enumToString(canvas->tool()));
+    mSession.insert(QLatin1String("toolShape"), enumToString(canvas->toolShape()));
+    mSession.insert(QLatin1String("toolSize"), canvas->toolSize());
+    mSession.insert(QLatin1String("penForegroundColour"), canvas->penForegroundColour().name(QColor::HexArgb));
+    mSession.insert(QLatin1String("penBackgroundColour"), canvas->penBackgroundColour().name(QColor::HexArgb));
+
+    connect(canvas, &ImageCanvas::toolChanged, this, &InputRecorder::onToolChanged);
+    connect(canvas, &ImageCanvas::toolShapeChanged, this, &InputRecorder::onToolShapeChanged);
+    connect(canvas, &ImageCanvas::toolSizeChanged, this, &InputRecorder::onToolSizeChanged);
+    connect(canvas, &ImageCanvas::penForegroundColourChanged, this, &InputRecorder::onPenForegroundColourChanged);
+    connect(canvas, &ImageCanvas::penBackgroundColourChanged, this, &InputRecorder::onPenBackgroundColourChanged);
+}
+
+void InputRecorder::appendEvent(const QString &type, QJsonObject eventObject)
+{
+    if (!isRecording())
+        return;
+
+    eventObject.insert(QLatin1String("type"), type);
+    eventObject.insert(QLatin1String("time"), mSessionTimer.elapsed());
+    mEvents.append(eventObject);
+}
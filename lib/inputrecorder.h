@@ -0,0 +1,110 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include "slate-global.h"
+
+class QEvent;
+
+class ImageCanvas;
+class Project;
+
+/*
+    Records the input that a canvas receives so that a session can be replayed
+    later, e.g. as a performance test (see tests/manual/memory-usage).
+
+    Recording is off by default, in which case each hook in ImageCanvas costs
+    one relaxed atomic load. It's turned on at startup by setting the
+    SLATE_INPUT_RECORDING_FILE environment variable to the path of the file to
+    write. The session is written when recording is disabled (which includes
+    when the application exits).
+
+    A session is tied to the first canvas and project that receive input after
+    recording starts; input for any other canvas or project is ignored.
+    It's a JSON object containing the state needed to set up the replay
+    (the project type and size, the canvas size, pane zoom levels and offsets,
+    the tool, etc.) and an "events" array. Each event has a "type" and a "time"
+    in milliseconds since the session started. Positions are in canvas item
+    coordinates, so the canvas must be the same size when replaying.
+    Shortcuts are handled before the canvas sees them, so their effects
+    (tool changes, undo, redo, etc.) are recorded instead of the key presses.
+*/
+class SLATE_EXPORT InputRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    InputRecorder();
+    ~InputRecorder() override;
+
+    static InputRecorder *instance();
+
+    static inline bool isRecording()
+    {
+        return sRecording.loadRelaxed() != 0;
+    }
+
+    void setRecording(bool recording);
+
+    QString filePath() const;
+    void setFilePath(const QString &filePath);
+
+    // Records event if it's one of the input events that can be replayed.
+    void recordEvent(ImageCanvas *canvas, const QEvent *event);
+    // Records an action that doesn't come from an input event that the canvas receives, e.g. "undo".
+    void recordAction(ImageCanvas *canvas, const QString &action);
+
+    // Writes the session recorded so far to filePath() and clears it.
+    bool write();
+
+    static const int sessionVersion = 1;
+
+private slots:
+    void onToolChanged();
+    void onToolShapeChanged();
+    void onToolSizeChanged();
+    void onPenForegroundColourChanged();
+    void onPenBackgroundColourChanged();
+
+private:
+    bool isSessionCanvas(ImageCanvas *canvas);
+    void startSession(ImageCanvas *canvas);
+    void appendEvent(const QString &type, QJsonObject eventObject = QJsonObject());
+
+    static QBasicAtomicInt sRecording;
+
+    QString mFilePath;
+    QPointer<ImageCanvas> mCanvas;
+    QPointer<Project> mProject;
+    QElapsedTimer mSessionTimer;
+    QJsonObject mSession;
+    QJsonArray mEvents;
+};
+
+#endif // INPUTRECORDER_H
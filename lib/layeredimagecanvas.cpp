@@ -24,6 +24,7 @@
 
 #include "imagelayer.h"
 #include "layeredimageproject.h"
+#include "tracer.h"
 
 LayeredImageCanvas::LayeredImageCanvas() :
     mLayeredImageProject(nullptr)
@@ -42,7 +43,7 @@ void LayeredImageCanvas::onPostLayerAdded(int index)
     // TODO: could we move these to LayeredImageProject and save a few connections?
     connect(layer, &ImageLayer::visibleChanged, this, &LayeredImageCanvas::onLayerVisibleChanged);
     connect(layer, &ImageLayer::opacityChanged, this, &LayeredImageCanvas::onLayerOpacityChanged);
-    requestContentPaint();
+    onContentChanged();
 }
 
 void LayeredImageCanvas::onPreLayerRemoved(int index)
@@ -54,22 +55,22 @@ void LayeredImageCanvas::onPreLayerRemoved(int index)
 
 void LayeredImageCanvas::onPostLayerRemoved()
 {
-    requestContentPaint();
+    onContentChanged();
 }
 
 void LayeredImageCanvas::onPostLayerMoved()
 {
-    requestContentPaint();
+    onContentChanged();
 }
 
 void LayeredImageCanvas::onPostLayerImageChanged()
 {
-    requestContentPaint();
+    onContentChanged();
 }
 
 void LayeredImageCanvas::onLayerVisibleChanged()
 {
-    requestContentPaint();
+    onContentChanged();
 
     ImageLayer *layer = qobject_cast<ImageLayer*>(sender());
     if (layer == mLayeredImageProject->currentLayer())
@@ -82,7 +83,7 @@ void LayeredImageCanvas::onLayerOpacityChanged()
     Q_ASSERT(layer);
     // We don't care about opacity changes of invisible layers.
     if (layer->isVisible())
-        requestContentPaint();
+        onContentChanged();
 }
 
 void LayeredImageCanvas::onPreCurrentLayerChanged()
@@ -115,7 +116,7 @@ void LayeredImageCanvas::connectSignals()
     connect(mLayeredImageProject, &LayeredImageProject::postLayerImageChanged, this, &LayeredImageCanvas::onPostLayerImageChanged);
     connect(mLayeredImageProject, &LayeredImageProject::preCurrentLayerChanged, this, &LayeredImageCanvas::onPreCurrentLayerChanged);
     connect(mLayeredImageProject, &LayeredImageProject::postCurrentLayerChanged, this, &LayeredImageCanvas::onPostCurrentLayerChanged);
-    connect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::requestContentPaint);
+    connect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::onContentChanged);
 
     // Connect to all existing layers, as onPostLayerAdded() won't get called for them automatically.
     for (int i = 0; i < mLayeredImageProject->layerCount(); ++i) {
@@ -134,7 +135,7 @@ void LayeredImageCanvas::disconnectSignals()
     disconnect(mLayeredImageProject, &LayeredImageProject::postLayerImageChanged, this, &LayeredImageCanvas::onPostLayerImageChanged);
     disconnect(mLayeredImageProject, &LayeredImageProject::preCurrentLayerChanged, this, &LayeredImageCanvas::onPreCurrentLayerChanged);
     disconnect(mLayeredImageProject, &LayeredImageProject::postCurrentLayerChanged, this, &LayeredImageCanvas::onPostCurrentLayerChanged);
-    disconnect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::requestContentPaint);
+    disconnect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::onContentChanged);
 
     mLayeredImageProject = nullptr;
 }
@@ -161,28 +162,41 @@ int LayeredImageCanvas::currentLayerIndex() const
 
 QImage LayeredImageCanvas::getContentImage()
 {
+    SLATE_TRACE_SCOPE("composite", "LayeredImageCanvas::getContentImage");
+
+    QVector<LayeredImageProject::LayerPatch> selectionPreview;
+    if (shouldDrawSelectionPreview()) {
+        // Only the areas affected by the selection are composited; they're drawn
+        // over the unmodified current layer while flattening.
+        const int layerIndex = mLayeredImageProject->currentLayerIndex();
+        const QVector<SelectionPreviewPatch> patches = selectionPreviewPatches(*mLayeredImageProject->currentLayer()->image());
+        for (const SelectionPreviewPatch &patch : patches)
+            selectionPreview.append({ layerIndex, patch.pos, patch.image });
+    }
+
     return mLayeredImageProject->flattenedImage([=](int index) {
         QImage layerImage;
-        if (index == mLayeredImageProject->currentLayerIndex()) {
-            if (shouldDrawSelectionPreviewImage()) {
-                layerImage = mSelectionPreviewImage;
-            } else if (isLineVisible()) {
-                layerImage = *mLayeredImageProject->currentLayer()->image();
-                QPainter linePainter(&layerImage);
-                // Draw the line on top of what has already been painted using a special composition mode.
-                // This ensures that e.g. a translucent red overwrites whatever pixels it
-                // lies on, rather than blending with them.
-                drawLine(&linePainter, linePoint1(), linePoint2(), QPainter::CompositionMode_Source);
-            }
+        if (index == mLayeredImageProject->currentLayerIndex() && !shouldDrawSelectionPreview() && isLineVisible()) {
+            layerImage = *mLayeredImageProject->currentLayer()->image();
+            // Draw the line on top of what has already been painted using a special composition mode.
+            // This ensures that e.g. a translucent red overwrites whatever pixels it
+            // lies on, rather than blending with them.
+            drawPixelLine(&layerImage, linePoint1(), linePoint2(), QPainter::CompositionMode_Source, layerImage.rect());
         }
         return layerImage;
-    });
+    }, selectionPreview);
+}
+
+void LayeredImageCanvas::notifyLayerImageModified(int layerIndex, const QRect &sceneRect)
+{
+    mLayeredImageProject->layerThumbnails()->layerImageModified(layerIndex, sceneRect);
 }
 
 void LayeredImageCanvas::replaceImage(int layerIndex, const QImage &replacementImage)
 {
     *mLayeredImageProject->layerAt(layerIndex)->image() = replacementImage;
-    requestContentPaint();
+    notifyLayerImageModified(layerIndex, replacementImage.rect());
+    onContentChanged();
 }
 
 void LayeredImageCanvas::updateToolsForbidden()
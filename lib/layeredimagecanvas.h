@@ -59,6 +59,7 @@ protected:
     int currentLayerIndex() const override;
     QImage getContentImage() override;
 
+    void notifyLayerImageModified(int layerIndex, const QRect &sceneRect) override;
     void replaceImage(int layerIndex, const QImage &replacementImage) override;
 
     void updateToolsForbidden() override;
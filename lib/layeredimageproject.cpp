@@ -48,6 +48,7 @@
 #include "movelayeredimagecontentscommand.h"
 #include "pasteacrosslayerscommand.h"
 #include "rearrangelayeredimagecontentsintogridcommand.h"
+#include "tracer.h"
 
 Q_LOGGING_CATEGORY(lcLivePreview, "app.layeredimageproject.livepreview")
 Q_LOGGING_CATEGORY(lcMoveContents, "app.layeredimageproject.movecontents")
@@ -60,15 +61,28 @@ LayeredImageProject::LayeredImageProject() :
     mAutoExportEnabled(false),
     mUsingAnimation(false),
     mHasUsedAnimation(false),
-    mAnimationHelper(this, &mAnimationSystem, &mUsingAnimation)
+    mAnimationHelper(this, &mAnimationSystem, &mUsingAnimation),
+    mLayerThumbnails(this)
 {
     setObjectName(QLatin1String("LayeredImageProject"));
     qCDebug(lcProjectLifecycle) << "constructing" << this;
 }
 
+struct LayeredImageProject::LivePreviewJob
+{
+    int generation = 0;
+    QVector<QImage> newImages;
+    QAtomicInt remainingLayers;
+};
+
 LayeredImageProject::~LayeredImageProject()
 {
     qCDebug(lcProjectLifecycle) << "destructing" << this;
+
+    // The tasks refer to us, so they must be done before we're gone.
+    mLivePreviewGeneration.fetchAndAddOrdered(1);
+    mLivePreviewThreadPool.clear();
+    mLivePreviewThreadPool.waitForDone();
 }
 
 ImageLayer *LayeredImageProject::currentLayer()
@@ -177,13 +191,17 @@ QRect LayeredImageProject::bounds() const
     return QRect(0, 0, ourSize.width(), ourSize.height());
 }
 
-QImage LayeredImageProject::flattenedImage(const std::function<QImage(int)> &layerSubstituteFunction) const
+QImage LayeredImageProject::flattenedImage(const std::function<QImage(int)> &layerSubstituteFunction,
+    const QVector<LayerPatch> &layerPatches) const
 {
-    return flattenedImage(0, layerCount() - 1, layerSubstituteFunction);
+    return flattenedImage(0, layerCount() - 1, layerSubstituteFunction, layerPatches);
 }
 
-QImage LayeredImageProject::flattenedImage(int fromIndex, int toIndex, const std::function<QImage(int)> &layerSubstituteFunction) const
+QImage LayeredImageProject::flattenedImage(int fromIndex, int toIndex, const std::function<QImage(int)> &layerSubstituteFunction,
+    const QVector<LayerPatch> &layerPatches) const
 {
+    SLATE_TRACE_SCOPE("composite", "LayeredImageProject::flattenedImage");
+
     Q_ASSERT(isValidIndex(fromIndex));
     Q_ASSERT(isValidIndex(toIndex));
     // If there's only one layer, the from and to indices will be the same.
@@ -206,7 +224,27 @@ QImage LayeredImageProject::flattenedImage(int fromIndex, int toIndex, const std
         if (layerImage.isNull()) {
             layerImage = *layer->image();
         }
-        painter.drawImage(0, 0, layerImage);
+
+        QRegion patchRegion;
+        for (const LayerPatch &layerPatch : layerPatches) {
+            if (layerPatch.layerIndex == i)
+                patchRegion += QRect(layerPatch.pos, layerPatch.image.size());
+        }
+
+        if (!patchRegion.isEmpty()) {
+            // Draw the layer around the patches, and then the patches themselves
+            // over the layers below, as if they were part of the layer.
+            painter.save();
+            painter.setClipRegion(QRegion(finalImage.rect()).subtracted(patchRegion));
+            painter.drawImage(0, 0, layerImage);
+            painter.restore();
+            for (const LayerPatch &layerPatch : layerPatches) {
+                if (layerPatch.layerIndex == i)
+                    painter.drawImage(layerPatch.pos, layerPatch.image);
+            }
+        } else {
+            painter.drawImage(0, 0, layerImage);
+        }
     }
 
     return finalImage;
@@ -345,7 +383,7 @@ QHash<QString, QImage> LayeredImageProject::flattenedImages() const
     return images;
 }
 
-QImage LayeredImageProject::exportedImage() const
+QImage LayeredImageProject::createExportedImage() const
 {
     return flattenedImage();
 }
@@ -364,6 +402,13 @@ QVector<QImage> LayeredImageProject::layerImagesBeforeLivePreview() const
     return mLayerImagesBeforeLivePreview;
 }
 
+// Returns true if a live preview modification has been requested
+// but its result isn't shown yet.
+bool LayeredImageProject::isLivePreviewModificationPending() const
+{
+    return !mPendingLivePreviewJob.isNull();
+}
+
 bool LayeredImageProject::isAutoExportEnabled() const
 {
     return mAutoExportEnabled;
@@ -425,6 +470,8 @@ const AnimationSystem *LayeredImageProject::animationSystem() const
 
 void LayeredImageProject::exportGif(const QUrl &url)
 {
+    SLATE_TRACE_SCOPE("export", "LayeredImageProject::exportGif");
+
     if (!mUsingAnimation) {
         error(tr("Cannot export as GIF because the project isn't using animation"));
         return;
@@ -435,6 +482,11 @@ void LayeredImageProject::exportGif(const QUrl &url)
         error(errorMessage);
 }
 
+LayerThumbnailCache *LayeredImageProject::layerThumbnails()
+{
+    return &mLayerThumbnails;
+}
+
 void LayeredImageProject::createNew(int imageWidth, int imageHeight, bool transparentBackground)
 {
     if (hasLoaded()) {
@@ -471,6 +523,8 @@ void LayeredImageProject::beginLivePreview()
     // the dialog opens instead of as the sliders etc. are being interacted with.
 
     mLayerImagesBeforeLivePreview = layerImages();
+    mLayersPastedIntoDuringLivePreview = QBitArray(mLayers.size());
+    mLastLivePreviewPasteRect = QRect();
 
     mLivePreviewActive = true;
 
@@ -487,8 +541,19 @@ void LayeredImageProject::endLivePreview(LivePreviewModificationAction modificat
         return;
     }
 
+    if (modificationAction == CommitModificaton) {
+        // Commit what was last requested, not what happened to finish last.
+        finishPendingLivePreviewJob();
+    } else {
+        // Nothing that's still being computed is needed anymore.
+        mLivePreviewGeneration.fetchAndAddOrdered(1);
+        mPendingLivePreviewJob.reset();
+    }
+
     auto cleanup = [&](){
         mLayerImagesBeforeLivePreview.clear();
+        mLayersPastedIntoDuringLivePreview.clear();
+        mLastLivePreviewPasteRect = QRect();
         mLivePreviewActive = false;
     };
 
@@ -735,6 +800,8 @@ bool LayeredImageProject::doSaveAs(const QUrl &url)
 // Returns true because the auto-export feature in saveAs() needs to know whether or not it should return early.
 bool LayeredImageProject::exportImage(const QUrl &url)
 {
+    SLATE_TRACE_SCOPE("export", "LayeredImageProject::exportImage");
+
     if (!hasLoaded())
         return false;
 
@@ -770,19 +837,14 @@ void LayeredImageProject::resize(int width, int height, bool smooth)
     if (warnIfLivePreviewNotActive(QLatin1String("resize")))
         return;
 
+    // If a resize is still being computed, this one replaces it, even if it's the current size.
     const QSize newSize(width, height);
-    if (newSize == size())
+    if (newSize == size() && !mPendingLivePreviewJob)
         return;
 
-    QVector<QImage> newImages;
-    newImages.reserve(mLayers.size());
-
-    for (const QImage &originalLayerImage : qAsConst(mLayerImagesBeforeLivePreview)) {
-        const QImage resized = ImageUtils::resizeContents(originalLayerImage, newSize, smooth);
-        newImages.append(resized);
-    }
-
-    makeLivePreviewModification(LivePreviewModification::Resize, newImages);
+    makeAsyncLivePreviewModification(LivePreviewModification::Resize, [=](const QImage &originalLayerImage) {
+        return ImageUtils::resizeContents(originalLayerImage, newSize, smooth);
+    });
 }
 
 void LayeredImageProject::crop(const QRect &rect)
@@ -809,10 +871,10 @@ void LayeredImageProject::crop(const QRect &rect)
     endMacro();
 }
 
-void LayeredImageProject::moveContents(int xDistance, int yDistance, bool onlyVisibleContents)
+void LayeredImageProject::moveContents(int xDistance, int yDistance, bool onlyVisibleContents, bool wrapAround)
 {
     qCDebug(lcMoveContents) << "moveContents called with xDistance" << xDistance
-        << "yDistance" << yDistance << "onlyVisibleContents" << onlyVisibleContents;
+        << "yDistance" << yDistance << "onlyVisibleContents" << onlyVisibleContents << "wrapAround" << wrapAround;
 
     if (warnIfLivePreviewNotActive(QLatin1String("move contents")))
         return;
@@ -820,20 +882,15 @@ void LayeredImageProject::moveContents(int xDistance, int yDistance, bool onlyVi
     if (xDistance == 0 && yDistance == 0)
         return;
 
-    QVector<QImage> newImages;
-    for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex) {
-        const bool layerVisible = mLayers.at(layerIndex)->isVisible();
-        const QImage oldImage = mLayerImagesBeforeLivePreview.at(layerIndex);
-        if (onlyVisibleContents && !layerVisible) {
-            // This is lazy and inefficient (we could e.g. store a null QImage),
-            // but it avoids adding more code paths elsewhere.
-            newImages.append(oldImage);
-        } else {
-            newImages.append(ImageUtils::moveContents(oldImage, xDistance, yDistance));
-        }
+    QBitArray layersToMove(mLayers.size(), true);
+    if (onlyVisibleContents) {
+        for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex)
+            layersToMove.setBit(layerIndex, mLayers.at(layerIndex)->isVisible());
     }
 
-    makeLivePreviewModification(LivePreviewModification::MoveContents, newImages);
+    makeAsyncLivePreviewModification(LivePreviewModification::MoveContents, [=](const QImage &oldImage) {
+        return ImageUtils::moveContents(oldImage, xDistance, yDistance, wrapAround);
+    }, layersToMove);
 }
 
 void LayeredImageProject::rearrangeContentsIntoGrid(int cellWidth, int cellHeight, int columns, int rows)
@@ -844,9 +901,10 @@ void LayeredImageProject::rearrangeContentsIntoGrid(int cellWidth, int cellHeigh
     if (warnIfLivePreviewNotActive(QLatin1String("rearrange contents into grid")))
         return;
 
-    const QVector<QImage> newImages = ImageUtils::rearrangeContentsIntoGrid(
-        mLayerImagesBeforeLivePreview, cellWidth, cellHeight, columns, rows);
-    makeLivePreviewModification(LivePreviewModification::MoveContents, newImages);
+    makeAsyncLivePreviewModification(LivePreviewModification::MoveContents, [=](const QImage &oldImage) {
+        const QVector<QImage> newImages = ImageUtils::rearrangeContentsIntoGrid({ oldImage }, cellWidth, cellHeight, columns, rows);
+        return !newImages.isEmpty() ? newImages.first() : QImage();
+    });
 }
 
 void LayeredImageProject::doMoveContents(const QVector<QImage> &newImages)
@@ -974,12 +1032,13 @@ void LayeredImageProject::setLayerOpacity(int layerIndex, qreal opacity)
 
 void LayeredImageProject::copyAcrossLayers(const QRect &copyArea)
 {
-    QVector<QImage> copiedImages;
-    const QVector<QImage> imagesToCopy = layerImages();
-    copiedImages.reserve(imagesToCopy.size());
-    for (auto layerImage : imagesToCopy)
-        copiedImages.append(layerImage.copy(copyArea));
-    Clipboard::instance()->setCopiedLayerImages(copiedImages);
+    // Only store what's actually in each layer within the area, so that copying
+    // a small area of a large project with lots of layers stays cheap.
+    QVector<CopiedLayerImage> copiedImages;
+    copiedImages.reserve(mLayers.size());
+    for (const ImageLayer *layer : qAsConst(mLayers))
+        copiedImages.append(ImageUtils::copyLayerImage(*layer->image(), copyArea));
+    Clipboard::instance()->setCopiedLayerImages(copyArea.size(), copiedImages);
 }
 
 void LayeredImageProject::pasteAcrossLayers(int pasteX, int pasteY, bool onlyPasteIntoVisibleLayers)
@@ -993,9 +1052,30 @@ void LayeredImageProject::pasteAcrossLayers(int pasteX, int pasteY, bool onlyPas
     if (pasteX == 0 && pasteY == 0)
         return;
 
-    const QVector<QImage> newImages = ImageUtils::pasteAcrossLayers(mLayers, mLayerImagesBeforeLivePreview,
-        pasteX, pasteY, onlyPasteIntoVisibleLayers);
-    makeLivePreviewModification(LivePreviewModification::PasteAcrossLayers, newImages);
+    if (!prepareLivePreviewModification(LivePreviewModification::PasteAcrossLayers))
+        return;
+
+    // Rather than rebuilding every layer's image for each change in the dialog,
+    // restore the area that the last change pasted into and paste into the new one.
+    const QVector<CopiedLayerImage> copiedLayerImages = Clipboard::instance()->copiedLayerImages();
+    Q_ASSERT(copiedLayerImages.size() == mLayers.size());
+    const QRect pasteRect(QPoint(pasteX, pasteY), Clipboard::instance()->copiedLayerAreaSize());
+    for (int i = 0; i < mLayers.size(); ++i) {
+        ImageLayer *layer = mLayers.at(i);
+        if (mLayersPastedIntoDuringLivePreview.testBit(i)) {
+            ImageUtils::copyPixels(mLayerImagesBeforeLivePreview.at(i), mLastLivePreviewPasteRect,
+                *layer->image(), mLastLivePreviewPasteRect.topLeft());
+        }
+
+        const bool pasteIntoLayer = !onlyPasteIntoVisibleLayers || layer->isVisible();
+        if (pasteIntoLayer)
+            ImageUtils::pasteCopiedLayerImage(*layer->image(), pasteRect, copiedLayerImages.at(i));
+        mLayersPastedIntoDuringLivePreview.setBit(i, pasteIntoLayer);
+    }
+    mLastLivePreviewPasteRect = pasteRect;
+
+    // Let the canvas know that it should repaint.
+    emit contentsModified();
 }
 
 void LayeredImageProject::addAnimation()
@@ -1038,12 +1118,11 @@ bool LayeredImageProject::isValidIndex(int index) const
     return index >= 0 && index < mLayers.size();
 }
 
-void LayeredImageProject::makeLivePreviewModification(LivePreviewModification modification, const QVector<QImage> &newImages)
+// Returns true if modification can be made to the layers' images as part of the current live preview.
+bool LayeredImageProject::prepareLivePreviewModification(LivePreviewModification modification)
 {
-    qCDebug(lcLivePreview) << "makeLivePreviewModification called with modification" << modification;
-
     if (warnIfLivePreviewNotActive(QLatin1String("make live preview modification")))
-        return;
+        return false;
 
     if (mCurrentLivePreviewModification == LivePreviewModification::None)
         mCurrentLivePreviewModification = modification;
@@ -1051,9 +1130,19 @@ void LayeredImageProject::makeLivePreviewModification(LivePreviewModification mo
     if (modification != mCurrentLivePreviewModification) {
         qWarning() << "Cannot make live preview modification" << modification << "as it is different"
             << "to the current modification of" << mCurrentLivePreviewModification;
-        return;
+        return false;
     }
 
+    return true;
+}
+
+void LayeredImageProject::makeLivePreviewModification(LivePreviewModification modification, const QVector<QImage> &newImages)
+{
+    qCDebug(lcLivePreview) << "makeLivePreviewModification called with modification" << modification;
+
+    if (!prepareLivePreviewModification(modification))
+        return;
+
     Q_ASSERT(newImages.size() == mLayers.size());
 
     assignNewImagesToLayers(newImages);
@@ -1062,6 +1151,80 @@ void LayeredImageProject::makeLivePreviewModification(LivePreviewModification mo
     emit contentsModified();
 }
 
+/*!
+    Starts computing the new image of each layer from its image before the live preview
+    began by calling \a modifyImage on a worker thread, one task per layer. Layers whose bit
+    in \a layersToModify is cleared keep their original image.
+
+    Only the most recently requested modification is applied; tasks belonging to
+    modifications that have been superseded skip their work, and their results are discarded.
+    Until the new images are ready, the canvas keeps showing the last modification that was applied.
+*/
+void LayeredImageProject::makeAsyncLivePreviewModification(LivePreviewModification modification,
+    const std::function<QImage(const QImage &)> &modifyImage, const QBitArray &layersToModify)
+{
+    qCDebug(lcLivePreview) << "makeAsyncLivePreviewModification called with modification" << modification;
+
+    if (!prepareLivePreviewModification(modification))
+        return;
+
+    const int generation = mLivePreviewGeneration.fetchAndAddOrdered(1) + 1;
+    QSharedPointer<LivePreviewJob> job(new LivePreviewJob);
+    job->generation = generation;
+    job->newImages = mLayerImagesBeforeLivePreview;
+    job->remainingLayers.storeRelaxed(mLayers.size());
+    mPendingLivePreviewJob = job;
+    // Detach here so that the tasks can each write to their own element without detaching.
+    QImage *newImages = job->newImages.data();
+
+    for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex) {
+        const bool modifyLayer = layersToModify.isEmpty() || layersToModify.testBit(layerIndex);
+        mLivePreviewThreadPool.start([=]() {
+            // Don't bother if a more recent modification has been requested since.
+            if (modifyLayer && mLivePreviewGeneration.loadAcquire() == generation)
+                newImages[layerIndex] = modifyImage(newImages[layerIndex]);
+
+            if (job->remainingLayers.fetchAndSubOrdered(1) == 1)
+                QMetaObject::invokeMethod(this, [=]() { applyLivePreviewJob(job); }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void LayeredImageProject::applyLivePreviewJob(const QSharedPointer<LivePreviewJob> &job)
+{
+    if (job != mPendingLivePreviewJob) {
+        qCDebug(lcLivePreview) << "discarding superseded live preview modification" << job->generation;
+        return;
+    }
+
+    mPendingLivePreviewJob.reset();
+
+    for (const QImage &newImage : qAsConst(job->newImages)) {
+        if (newImage.isNull()) {
+            // The modification was invalid; keep showing the last valid one.
+            qCDebug(lcLivePreview) << "discarding invalid live preview modification" << job->generation;
+            return;
+        }
+    }
+
+    qCDebug(lcLivePreview) << "applying live preview modification" << job->generation;
+    assignNewImagesToLayers(job->newImages);
+
+    // Let the canvas know that it should repaint.
+    emit contentsModified();
+}
+
+// Blocks until the most recently requested asynchronous modification
+// (if any) has been computed, and then applies it.
+void LayeredImageProject::finishPendingLivePreviewJob()
+{
+    if (!mPendingLivePreviewJob)
+        return;
+
+    mLivePreviewThreadPool.waitForDone();
+    applyLivePreviewJob(mPendingLivePreviewJob);
+}
+
 void LayeredImageProject::assignNewImagesToLayers(const QVector<QImage> &newImages)
 {
     for (int i = 0; i < newImages.size(); ++i) {
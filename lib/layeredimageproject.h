@@ -20,11 +20,17 @@
 #ifndef LAYEREDIMAGEPROJECT_H
 #define LAYEREDIMAGEPROJECT_H
 
+#include <QAtomicInt>
+#include <QBitArray>
 #include <QDebug>
 #include <QImage>
 #include <QQmlEngine>
+#include <QRect>
+#include <QSharedPointer>
+#include <QThreadPool>
 
 #include "animationsystem.h"
+#include "layerthumbnailcache.h"
 #include "project.h"
 #include "projectanimationhelper.h"
 #include "slate-global.h"
@@ -57,6 +63,7 @@ public:
     const ImageLayer *layerAt(const QString &name) const;
     int layerCount() const;
     QVector<QImage> layerImagesBeforeLivePreview() const;
+    bool isLivePreviewModificationPending() const;
 
     Type type() const override;
     QSize size() const override;
@@ -65,10 +72,20 @@ public:
     int heightInPixels() const override;
     QRect bounds() const override;
 
-    QImage flattenedImage(const std::function<QImage(int)> &layerSubstituteFunction = nullptr) const;
-    QImage flattenedImage(int fromIndex, int toIndex, const std::function<QImage(int)> &layerSubstituteFunction = nullptr) const;
+    // Replaces the pixels of the layer at layerIndex within the bounds of image
+    // (positioned at pos) when flattening, without copying the layer's image.
+    struct LayerPatch
+    {
+        int layerIndex = -1;
+        QPoint pos;
+        QImage image;
+    };
+
+    QImage flattenedImage(const std::function<QImage(int)> &layerSubstituteFunction = nullptr,
+        const QVector<LayerPatch> &layerPatches = QVector<LayerPatch>()) const;
+    QImage flattenedImage(int fromIndex, int toIndex, const std::function<QImage(int)> &layerSubstituteFunction = nullptr,
+        const QVector<LayerPatch> &layerPatches = QVector<LayerPatch>()) const;
     QHash<QString, QImage> flattenedImages() const;
-    QImage exportedImage() const override;
     QVector<QImage> layerImages() const;
 
     bool isAutoExportEnabled() const;
@@ -83,6 +100,8 @@ public:
 
     Q_INVOKABLE void exportGif(const QUrl &url);
 
+    LayerThumbnailCache *layerThumbnails();
+
 signals:
     void currentLayerIndexChanged();
     void preCurrentLayerChanged();
@@ -113,7 +132,7 @@ public slots:
     bool exportImage(const QUrl &url);
     void resize(int width, int height, bool smooth);
     void crop(const QRect &rect);
-    void moveContents(int xDistance, int yDistance, bool onlyVisibleContents);
+    void moveContents(int xDistance, int yDistance, bool onlyVisibleContents, bool wrapAround = false);
     void rearrangeContentsIntoGrid(int cellWidth, int cellHeight, int columns, int rows);
 
     void addNewLayer();
@@ -149,6 +168,7 @@ protected:
     void doLoad(const QUrl &url) override;
     void doClose() override;
     bool doSaveAs(const QUrl &url) override;
+    QImage createExportedImage() const override;
 
 private:
     friend class AddLayerCommand;
@@ -167,8 +187,17 @@ private:
 
     bool isValidIndex(int index) const;
 
+    struct LivePreviewJob;
+
+    bool prepareLivePreviewModification(LivePreviewModification modification);
     // This should be called by slots each time a change is made in the relevant dialog.
     void makeLivePreviewModification(LivePreviewModification modification, const QVector<QImage> &newImages);
+    // Like makeLivePreviewModification(), but computes each layer's new image on a worker thread.
+    void makeAsyncLivePreviewModification(LivePreviewModification modification,
+        const std::function<QImage(const QImage &imageBeforeLivePreview)> &modifyImage,
+        const QBitArray &layersToModify = QBitArray());
+    void applyLivePreviewJob(const QSharedPointer<LivePreviewJob> &job);
+    void finishPendingLivePreviewJob();
 
     void assignNewImagesToLayers(const QVector<QImage> &newImages);
     void doSetCanvasSize(const QVector<QImage> &newImages);
@@ -200,6 +229,14 @@ private:
     // Modifications that affect anything besides the layer's image (like opacity)
     // are not supported; that would require us to store layers instead.
     QList<QImage> mLayerImagesBeforeLivePreview;
+    // Paste Across Layers modifies the layers' images in place; these track
+    // what the last change did so that it can be reverted by the next one.
+    QBitArray mLayersPastedIntoDuringLivePreview;
+    QRect mLastLivePreviewPasteRect;
+    // The most recently requested asynchronous modification, until it has been applied.
+    // Older requests are cancelled by bumping mLivePreviewGeneration.
+    QSharedPointer<LivePreviewJob> mPendingLivePreviewJob;
+    QAtomicInt mLivePreviewGeneration;
 
     bool mAutoExportEnabled;
 
@@ -207,6 +244,11 @@ private:
     bool mHasUsedAnimation;
     AnimationSystem mAnimationSystem;
     ProjectAnimationHelper mAnimationHelper;
+
+    // Runs the per-layer tasks of asynchronous live preview modifications.
+    QThreadPool mLivePreviewThreadPool;
+
+    LayerThumbnailCache mLayerThumbnails;
 };
 
 #endif // LAYEREDIMAGEPROJECT_H
@@ -51,6 +51,7 @@ void LayerModel::setLayeredImageProject(LayeredImageProject *layeredImageProject
 
     if (mLayeredImageProject) {
         mLayeredImageProject->disconnect(this);
+        mLayeredImageProject->layerThumbnails()->disconnect(this);
     }
 
     beginResetModel();
@@ -67,6 +68,8 @@ void LayerModel::setLayeredImageProject(LayeredImageProject *layeredImageProject
         connect(mLayeredImageProject, &LayeredImageProject::postLayerRemoved, this, &LayerModel::onPostLayerRemoved);
         connect(mLayeredImageProject, &LayeredImageProject::preLayerMoved, this, &LayerModel::onPreLayerMoved);
         connect(mLayeredImageProject, &LayeredImageProject::postLayerMoved, this, &LayerModel::onPostLayerMoved);
+        connect(mLayeredImageProject->layerThumbnails(), &LayerThumbnailCache::thumbnailChanged,
+            this, &LayerModel::onThumbnailChanged);
     }
 }
 
@@ -81,6 +84,8 @@ QVariant LayerModel::data(const QModelIndex &index, int role) const
 
     if (role == LayerRole) {
         return QVariant::fromValue(layer);
+    } else if (role == ThumbnailUrlRole) {
+        return mLayeredImageProject->layerThumbnails()->thumbnailUrl(layer);
     }
     return QVariant();
 }
@@ -97,6 +102,7 @@ QHash<int, QByteArray> LayerModel::roleNames() const
 {
     QHash<int, QByteArray> names;
     names.insert(LayerRole, "layer");
+    names.insert(ThumbnailUrlRole, "thumbnailUrl");
     return names;
 }
 
@@ -155,3 +161,13 @@ void LayerModel::onPostLayerMoved(int, int)
 {
     endMoveRows();
 }
+
+void LayerModel::onThumbnailChanged(ImageLayer *layer)
+{
+    const int row = mLayeredImageProject->layers().indexOf(layer);
+    if (row == -1)
+        return;
+
+    const QModelIndex modelIndex = index(row);
+    emit dataChanged(modelIndex, modelIndex, { ThumbnailUrlRole });
+}
@@ -38,6 +38,7 @@ class SLATE_EXPORT LayerModel : public QAbstractListModel
 public:
     enum LayerModelRoles {
         LayerRole = Qt::UserRole,
+        ThumbnailUrlRole
     };
 
     explicit LayerModel(QObject *parent = nullptr);
@@ -62,6 +63,7 @@ public slots:
     void onPostLayerRemoved(int index);
     void onPreLayerMoved(int fromIndex, int toIndex);
     void onPostLayerMoved(int fromIndex, int toIndex);
+    void onThumbnailChanged(ImageLayer *layer);
 
 private:
     LayeredImageProject *mLayeredImageProject;
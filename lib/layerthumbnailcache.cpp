@@ -0,0 +1,293 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "layerthumbnailcache.h"
+
+#include <QLoggingCategory>
+
+#include "imagelayer.h"
+#include "imageutils.h"
+#include "layeredimageproject.h"
+#include "tracer.h"
+
+Q_LOGGING_CATEGORY(lcLayerThumbnailCache, "app.layerThumbnailCache")
+
+LayerThumbnailWorker::LayerThumbnailWorker(QObject *parent) :
+    QObject(parent)
+{
+}
+
+LayerThumbnailWorker::~LayerThumbnailWorker()
+{
+}
+
+void LayerThumbnailWorker::downsample(quint64 layerId, const QImage &source, const QPoint &sourceOffset,
+    const QSize &layerSize, const QSize &thumbnailSize, const QRect &thumbnailRect)
+{
+    SLATE_TRACE_SCOPE("thumbnails", "LayerThumbnailWorker::downsample");
+
+    const QImage thumbnailPortion = ImageUtils::downsample(source, sourceOffset, layerSize, thumbnailSize, thumbnailRect);
+    emit downsampled(layerId, thumbnailPortion, thumbnailSize, thumbnailRect);
+}
+
+LayerThumbnailCache::LayerThumbnailCache(LayeredImageProject *project) :
+    mProject(project)
+{
+    // Wait until control returns to the event loop so that e.g. all of the
+    // changes made by a stroke end up in one update.
+    mUpdateTimer.setSingleShot(true);
+    mUpdateTimer.setInterval(0);
+    connect(&mUpdateTimer, &QTimer::timeout, this, &LayerThumbnailCache::sendPendingUpdates);
+
+    mWorker.moveToThread(&mWorkerThread);
+    connect(&mWorker, &LayerThumbnailWorker::downsampled, this, &LayerThumbnailCache::onDownsampled);
+
+    // These are the signals that are emitted when a layer's image might have
+    // changed without going through layerImageModified().
+    connect(mProject, &Project::projectCreated, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject, &Project::projectClosed, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject, &Project::sizeChanged, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject, &Project::contentsModified, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject->undoStack(), &QUndoStack::indexChanged, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject, &LayeredImageProject::layerCountChanged, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject, &LayeredImageProject::postLayerImageChanged, this, &LayerThumbnailCache::checkLayerImages);
+    connect(mProject, &LayeredImageProject::contentsMoved, this, &LayerThumbnailCache::checkLayerImages);
+}
+
+LayerThumbnailCache::~LayerThumbnailCache()
+{
+    mWorkerThread.quit();
+    mWorkerThread.wait();
+}
+
+/*!
+    Returns the size of the thumbnail for a layer of size \a layerSize.
+
+    Layers that are already small enough are used as-is; we never upscale.
+*/
+QSize LayerThumbnailCache::thumbnailSize(const QSize &layerSize)
+{
+    if (layerSize.isEmpty())
+        return QSize();
+
+    if (layerSize.width() <= maxThumbnailSize && layerSize.height() <= maxThumbnailSize)
+        return layerSize;
+
+    return layerSize.scaled(maxThumbnailSize, maxThumbnailSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+}
+
+QImage LayerThumbnailCache::thumbnail(const ImageLayer *layer) const
+{
+    return mEntries.value(layer).thumbnail;
+}
+
+QImage LayerThumbnailCache::thumbnail(const QString &id) const
+{
+    // The generation is only there to make the URL unique; we always return the latest thumbnail.
+    bool isValidId = false;
+    const quint64 layerId = id.section(QLatin1Char('/'), 0, 0).toULongLong(&isValidId);
+    if (!isValidId)
+        return QImage();
+
+    for (const Entry &entry : mEntries) {
+        if (entry.id == layerId)
+            return entry.thumbnail;
+    }
+    return QImage();
+}
+
+QString LayerThumbnailCache::thumbnailUrl(const ImageLayer *layer) const
+{
+    const auto it = mEntries.constFind(layer);
+    if (it == mEntries.constEnd() || it->thumbnail.isNull())
+        return QString();
+
+    return QString::fromLatin1("image://layerthumbnail/%1/%2").arg(it->id).arg(it->generation);
+}
+
+bool LayerThumbnailCache::isUpdatePending() const
+{
+    if (mUpdateTimer.isActive())
+        return true;
+
+    for (const Entry &entry : mEntries) {
+        if (entry.fullUpdatePending || !entry.pendingLayerRect.isEmpty() || entry.jobsInProgress > 0)
+            return true;
+    }
+    return false;
+}
+
+void LayerThumbnailCache::layerImageModified(int layerIndex, const QRect &sceneRect)
+{
+    const ImageLayer *layer = mProject->layerAt(layerIndex);
+    if (!layer)
+        return;
+
+    const QImage *image = layer->image();
+    auto it = mEntries.find(layer);
+    if (it == mEntries.end() || it->layerSize != image->size()) {
+        // It needs a full update anyway.
+        checkLayerImages();
+        return;
+    }
+
+    // We know exactly what changed, so there's no need for checkLayerImages() to do a full update.
+    it->imageCacheKey = image->cacheKey();
+    if (!it->fullUpdatePending)
+        it->pendingLayerRect |= sceneRect.intersected(image->rect());
+    scheduleUpdate();
+}
+
+void LayerThumbnailCache::checkLayerImages()
+{
+    const QVector<ImageLayer*> layers = mProject->layers();
+    bool updateNeeded = false;
+    for (const ImageLayer *layer : layers) {
+        Entry &entry = mEntries[layer];
+        if (entry.id == 0)
+            entry.id = mNextLayerId++;
+
+        const QImage *image = layer->image();
+        if (image->cacheKey() != entry.imageCacheKey || image->size() != entry.layerSize) {
+            entry.imageCacheKey = image->cacheKey();
+            entry.layerSize = image->size();
+            entry.fullUpdatePending = true;
+            entry.pendingLayerRect = QRect();
+        }
+
+        if (entry.fullUpdatePending || !entry.pendingLayerRect.isEmpty())
+            updateNeeded = true;
+    }
+
+    if (mEntries.size() != layers.size()) {
+        // Forget about the layers that are no longer in the project. Note that
+        // the keys might be dangling at this point, so they must not be dereferenced.
+        for (auto it = mEntries.begin(); it != mEntries.end(); ) {
+            if (!layers.contains(const_cast<ImageLayer*>(it.key())))
+                it = mEntries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    if (updateNeeded)
+        scheduleUpdate();
+}
+
+void LayerThumbnailCache::sendPendingUpdates()
+{
+    const QVector<ImageLayer*> layers = mProject->layers();
+    for (const ImageLayer *layer : layers) {
+        auto it = mEntries.find(layer);
+        if (it == mEntries.end())
+            continue;
+
+        Entry &entry = it.value();
+        const QImage *image = layer->image();
+        const QSize thumbnailSize = LayerThumbnailCache::thumbnailSize(entry.layerSize);
+        if (image->isNull() || thumbnailSize.isEmpty()) {
+            entry.fullUpdatePending = false;
+            entry.pendingLayerRect = QRect();
+            continue;
+        }
+
+        QImage source;
+        QPoint sourceOffset;
+        QRect thumbnailRect;
+        if (entry.fullUpdatePending) {
+            // The worker's copy shares its data with the layer's image,
+            // so it's only copied if the layer is modified in the meantime.
+            source = *image;
+            thumbnailRect = QRect(QPoint(0, 0), thumbnailSize);
+        } else if (!entry.pendingLayerRect.isEmpty()) {
+            thumbnailRect = ImageUtils::downsampleTargetRect(entry.layerSize, thumbnailSize, entry.pendingLayerRect);
+            const QRect sourceRect = ImageUtils::downsampleSourceRect(entry.layerSize, thumbnailSize, thumbnailRect);
+            source = image->copy(sourceRect);
+            sourceOffset = sourceRect.topLeft();
+        } else {
+            continue;
+        }
+
+        qCDebug(lcLayerThumbnailCache).nospace() << "requesting " << (entry.fullUpdatePending ? "full" : "partial")
+            << " update of thumbnail " << entry.id << " (" << layer->name() << "): " << thumbnailRect;
+
+        entry.fullUpdatePending = false;
+        entry.pendingLayerRect = QRect();
+        ++entry.jobsInProgress;
+
+        if (!mWorkerThread.isRunning())
+            mWorkerThread.start();
+
+        const bool invokeSucceeded = QMetaObject::invokeMethod(&mWorker, "downsample", Qt::QueuedConnection,
+            Q_ARG(quint64, entry.id), Q_ARG(QImage, source), Q_ARG(QPoint, sourceOffset),
+            Q_ARG(QSize, entry.layerSize), Q_ARG(QSize, thumbnailSize), Q_ARG(QRect, thumbnailRect));
+        Q_ASSERT(invokeSucceeded);
+    }
+}
+
+void LayerThumbnailCache::onDownsampled(quint64 layerId, const QImage &thumbnailPortion,
+    const QSize &thumbnailSize, const QRect &thumbnailRect)
+{
+    ImageLayer *layer = nullptr;
+    Entry *entry = entryForId(layerId, &layer);
+    if (!entry) {
+        // The layer was removed in the meantime.
+        return;
+    }
+
+    --entry->jobsInProgress;
+
+    if (thumbnailSize != LayerThumbnailCache::thumbnailSize(entry->layerSize)) {
+        // The layer was resized in the meantime, and a full update has been requested since.
+        return;
+    }
+
+    if (thumbnailRect == QRect(QPoint(0, 0), thumbnailSize)) {
+        entry->thumbnail = thumbnailPortion;
+    } else if (entry->thumbnail.size() == thumbnailSize) {
+        ImageUtils::copyPixels(thumbnailPortion, thumbnailPortion.rect(), entry->thumbnail, thumbnailRect.topLeft());
+    } else {
+        // We can't update part of a thumbnail that doesn't exist yet;
+        // the full update that's been requested will take care of it.
+        return;
+    }
+
+    ++entry->generation;
+    emit thumbnailChanged(layer);
+}
+
+LayerThumbnailCache::Entry *LayerThumbnailCache::entryForId(quint64 layerId, ImageLayer **layer)
+{
+    const QVector<ImageLayer*> layers = mProject->layers();
+    for (ImageLayer *projectLayer : layers) {
+        auto it = mEntries.find(projectLayer);
+        if (it != mEntries.end() && it->id == layerId) {
+            if (layer)
+                *layer = projectLayer;
+            return &it.value();
+        }
+    }
+    return nullptr;
+}
+
+void LayerThumbnailCache::scheduleUpdate()
+{
+    if (!mUpdateTimer.isActive())
+        mUpdateTimer.start();
+}
@@ -0,0 +1,130 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LAYERTHUMBNAILCACHE_H
+#define LAYERTHUMBNAILCACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QRect>
+#include <QThread>
+#include <QTimer>
+
+#include "slate-global.h"
+
+class ImageLayer;
+class LayeredImageProject;
+
+class LayerThumbnailWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    LayerThumbnailWorker(QObject *parent = nullptr);
+    ~LayerThumbnailWorker() override;
+
+    // source contains the pixels of the layer image (of size layerSize)
+    // that thumbnailRect needs, starting at sourceOffset.
+    Q_INVOKABLE void downsample(quint64 layerId, const QImage &source, const QPoint &sourceOffset,
+        const QSize &layerSize, const QSize &thumbnailSize, const QRect &thumbnailRect);
+
+signals:
+    void downsampled(quint64 layerId, const QImage &thumbnailPortion, const QSize &thumbnailSize, const QRect &thumbnailRect);
+};
+
+/*
+    Keeps a small downsampled copy of each layer of a LayeredImageProject.
+
+    Edits made through the canvas report the rect that they changed via
+    layerImageModified(), and only the part of the thumbnail covering that
+    rect is recomputed. Any other change to a layer's image (loading,
+    resizing, live previews, etc.) is caught by comparing the image's
+    cacheKey() whenever the project signals that something changed, and
+    results in the whole thumbnail being recomputed.
+
+    Changes are collected until control returns to the event loop and the
+    downsampling is done on a worker thread. Each time a thumbnail is updated
+    its generation is incremented, which is part of thumbnailUrl() so that
+    QML only reloads the thumbnails that actually changed.
+
+    All functions must be called on the GUI thread.
+*/
+class SLATE_EXPORT LayerThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    // The thumbnail's largest dimension.
+    static const int maxThumbnailSize = 64;
+
+    explicit LayerThumbnailCache(LayeredImageProject *project);
+    ~LayerThumbnailCache() override;
+
+    static QSize thumbnailSize(const QSize &layerSize);
+
+    // Returns the thumbnail for layer, which is null until it has been created.
+    QImage thumbnail(const ImageLayer *layer) const;
+    // id is the part of a thumbnailUrl() after the provider name.
+    QImage thumbnail(const QString &id) const;
+    // Returns an "image://layerthumbnail/..." URL for layer, or an empty
+    // URL if the thumbnail hasn't been created yet.
+    QString thumbnailUrl(const ImageLayer *layer) const;
+
+    // Returns true if there are changes that haven't made it into the thumbnails yet.
+    bool isUpdatePending() const;
+
+    // Should be called after the pixels within sceneRect of the layer at layerIndex are modified.
+    void layerImageModified(int layerIndex, const QRect &sceneRect);
+
+signals:
+    void thumbnailChanged(ImageLayer *layer);
+
+private slots:
+    void checkLayerImages();
+    void sendPendingUpdates();
+    void onDownsampled(quint64 layerId, const QImage &thumbnailPortion, const QSize &thumbnailSize, const QRect &thumbnailRect);
+
+private:
+    struct Entry
+    {
+        quint64 id = 0;
+        quint64 generation = 0;
+        QImage thumbnail;
+        // The cacheKey() of the layer's image when we last accounted for its changes.
+        qint64 imageCacheKey = 0;
+        QSize layerSize;
+        bool fullUpdatePending = false;
+        QRect pendingLayerRect;
+        int jobsInProgress = 0;
+    };
+
+    Entry *entryForId(quint64 layerId, ImageLayer **layer = nullptr);
+    void scheduleUpdate();
+
+    LayeredImageProject *mProject;
+    QHash<const ImageLayer*, Entry> mEntries;
+    quint64 mNextLayerId = 1;
+
+    QTimer mUpdateTimer;
+    LayerThumbnailWorker mWorker;
+    QThread mWorkerThread;
+};
+
+#endif // LAYERTHUMBNAILCACHE_H
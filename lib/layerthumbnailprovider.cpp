@@ -0,0 +1,38 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "layerthumbnailprovider.h"
+
+#include "layeredimageproject.h"
+#include "projectmanager.h"
+
+LayerThumbnailProvider::LayerThumbnailProvider(ProjectManager *projectManager) :
+    QQuickImageProvider(QQmlImageProviderBase::Image),
+    mProjectManager(projectManager)
+{
+}
+
+QImage LayerThumbnailProvider::requestImage(const QString &id, QSize *size, const QSize &)
+{
+    QImage image;
+    if (auto layeredImageProject = qobject_cast<LayeredImageProject*>(mProjectManager->project()))
+        image = layeredImageProject->layerThumbnails()->thumbnail(id);
+    *size = image.size();
+    return image;
+}
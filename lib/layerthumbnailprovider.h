@@ -0,0 +1,49 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LAYERTHUMBNAILPROVIDER_H
+#define LAYERTHUMBNAILPROVIDER_H
+
+#include <QImage>
+#include <QString>
+#include <QQuickImageProvider>
+
+#include "slate-global.h"
+
+class ProjectManager;
+
+/*
+    Provides the thumbnails of the current layered image project's layers.
+    The URLs come from LayerThumbnailCache::thumbnailUrl(), which changes
+    each time a layer's thumbnail does.
+
+    Images using this provider must not be asynchronous, as the cache can
+    only be accessed on the GUI thread.
+*/
+class SLATE_EXPORT LayerThumbnailProvider : public QQuickImageProvider
+{
+public:
+    LayerThumbnailProvider(ProjectManager *projectManager);
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+private:
+    ProjectManager *mProjectManager;
+};
+
+#endif // LAYERTHUMBNAILPROVIDER_H
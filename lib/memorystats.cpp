@@ -0,0 +1,291 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "memorystats.h"
+
+#include <algorithm>
+
+#include <QHash>
+#include <QLoggingCategory>
+#include <QSet>
+#include <QUndoStack>
+
+#include "autoswatchmodel.h"
+#include "clipboard.h"
+#include "imagecanvas.h"
+#include "imagelayer.h"
+#include "imageproject.h"
+#include "layeredimageproject.h"
+#include "project.h"
+#include "tileset.h"
+#include "tilesetproject.h"
+#include "undocommand.h"
+
+Q_LOGGING_CATEGORY(lcMemoryStats, "app.memoryStats")
+
+namespace {
+
+// Counts the bytes of images whose data hasn't already been counted.
+class ImageDataCounter
+{
+public:
+    qint64 add(const QImage &image)
+    {
+        if (image.isNull())
+            return 0;
+
+        // constBits() doesn't detach, so copies that share data give the same pointer.
+        const uchar *data = image.constBits();
+        if (mCountedData.contains(data))
+            return 0;
+
+        mCountedData.insert(data);
+        return image.sizeInBytes();
+    }
+
+    qint64 add(const QVector<QImage> &images)
+    {
+        qint64 bytes = 0;
+        for (const QImage &image : images)
+            bytes += add(image);
+        return bytes;
+    }
+
+private:
+    QSet<const uchar*> mCountedData;
+};
+
+qint64 undoCommandBytes(const QUndoCommand *command, ImageDataCounter &counter)
+{
+    qint64 bytes = 0;
+    if (const UndoCommand *undoCommand = dynamic_cast<const UndoCommand*>(command))
+        bytes += counter.add(undoCommand->heldImages()) + undoCommand->heldBytes();
+
+    for (int i = 0; i < command->childCount(); ++i)
+        bytes += undoCommandBytes(command->child(i), counter);
+    return bytes;
+}
+
+}
+
+MemoryStats::MemoryStats(QObject *parent) :
+    QObject(parent)
+{
+}
+
+MemoryStats::~MemoryStats()
+{
+}
+
+ImageCanvas *MemoryStats::canvas() const
+{
+    return mCanvas;
+}
+
+void MemoryStats::setCanvas(ImageCanvas *canvas)
+{
+    if (canvas == mCanvas)
+        return;
+
+    mCanvas = canvas;
+    emit canvasChanged();
+}
+
+AutoSwatchModel *MemoryStats::autoSwatchModel() const
+{
+    return mAutoSwatchModel;
+}
+
+void MemoryStats::setAutoSwatchModel(AutoSwatchModel *autoSwatchModel)
+{
+    if (autoSwatchModel == mAutoSwatchModel)
+        return;
+
+    mAutoSwatchModel = autoSwatchModel;
+    emit autoSwatchModelChanged();
+}
+
+qint64 MemoryStats::layerBytes() const
+{
+    return mLayerBytes;
+}
+
+qint64 MemoryStats::undoStackBytes() const
+{
+    return mUndoStackBytes;
+}
+
+qint64 MemoryStats::livePreviewBytes() const
+{
+    return mLivePreviewBytes;
+}
+
+qint64 MemoryStats::selectionBytes() const
+{
+    return mSelectionBytes;
+}
+
+qint64 MemoryStats::contentImageCacheBytes() const
+{
+    return mContentImageCacheBytes;
+}
+
+qint64 MemoryStats::clipboardBytes() const
+{
+    return mClipboardBytes;
+}
+
+qint64 MemoryStats::autoSwatchBytes() const
+{
+    return mAutoSwatchBytes;
+}
+
+qint64 MemoryStats::totalBytes() const
+{
+    return mLayerBytes + mUndoStackBytes + mLivePreviewBytes + mSelectionBytes
+        + mContentImageCacheBytes + mClipboardBytes + mAutoSwatchBytes;
+}
+
+QVariantList MemoryStats::layers() const
+{
+    return mLayers;
+}
+
+QVariantList MemoryStats::undoCommands() const
+{
+    return mUndoCommands;
+}
+
+void MemoryStats::refresh()
+{
+    reset();
+
+    ImageDataCounter counter;
+    Project *project = mCanvas ? mCanvas->project() : nullptr;
+
+    if (project && project->hasLoaded()) {
+        auto addLayer = [&](const QString &name, const QImage &image) {
+            const qint64 bytes = counter.add(image);
+            mLayerBytes += bytes;
+
+            QVariantMap layerMap;
+            layerMap.insert(QLatin1String("name"), name);
+            layerMap.insert(QLatin1String("bytes"), bytes);
+            mLayers.append(layerMap);
+        };
+
+        if (auto layeredImageProject = qobject_cast<LayeredImageProject*>(project)) {
+            for (int i = 0; i < layeredImageProject->layerCount(); ++i) {
+                const ImageLayer *layer = layeredImageProject->layerAt(i);
+                addLayer(layer->name(), *layer->image());
+            }
+        } else if (auto imageProject = qobject_cast<ImageProject*>(project)) {
+            addLayer(tr("Image"), *imageProject->image());
+        } else if (auto tilesetProject = qobject_cast<TilesetProject*>(project)) {
+            if (tilesetProject->tileset())
+                addLayer(tr("Tileset"), *tilesetProject->tileset()->image());
+        }
+
+        // Group the commands by type so that it's obvious which tools are expensive to undo.
+        struct UndoCommandTypeStats
+        {
+            int count = 0;
+            qint64 bytes = 0;
+        };
+        QHash<QString, UndoCommandTypeStats> undoCommandTypeStats;
+        const QUndoStack *undoStack = project->undoStack();
+        for (int i = 0; i < undoStack->count(); ++i) {
+            const QUndoCommand *command = undoStack->command(i);
+            const qint64 bytes = undoCommandBytes(command, counter);
+            mUndoStackBytes += bytes;
+
+            UndoCommandTypeStats &typeStats = undoCommandTypeStats[
+                command->text().isEmpty() ? tr("Unnamed") : command->text()];
+            ++typeStats.count;
+            typeStats.bytes += bytes;
+        }
+
+        QVector<QPair<QString, UndoCommandTypeStats>> sortedUndoCommandTypeStats;
+        for (auto it = undoCommandTypeStats.constBegin(); it != undoCommandTypeStats.constEnd(); ++it)
+            sortedUndoCommandTypeStats.append(qMakePair(it.key(), it.value()));
+        std::sort(sortedUndoCommandTypeStats.begin(), sortedUndoCommandTypeStats.end(),
+            [](const QPair<QString, UndoCommandTypeStats> &a, const QPair<QString, UndoCommandTypeStats> &b) {
+                return a.second.bytes > b.second.bytes;
+            });
+        for (const auto &typeStats : qAsConst(sortedUndoCommandTypeStats)) {
+            QVariantMap typeMap;
+            typeMap.insert(QLatin1String("type"), typeStats.first);
+            typeMap.insert(QLatin1String("count"), typeStats.second.count);
+            typeMap.insert(QLatin1String("bytes"), typeStats.second.bytes);
+            mUndoCommands.append(typeMap);
+        }
+
+        if (auto layeredImageProject = qobject_cast<LayeredImageProject*>(project))
+            mLivePreviewBytes = counter.add(layeredImageProject->layerImagesBeforeLivePreview());
+
+        // For image and tileset projects this shares its data with the project's image,
+        // in which case it won't be counted twice.
+        mContentImageCacheBytes += counter.add(project->mCachedExportedImage);
+    }
+
+    if (mCanvas) {
+        mSelectionBytes = counter.add(mCanvas->mSelectionContents)
+            + counter.add(mCanvas->mSelectionContentsBeforeImageAdjustment)
+            + counter.add(mCanvas->mLastCopiedSelectionContents);
+        mContentImageCacheBytes += counter.add(mCanvas->mCachedContentImage);
+        for (const ImageCanvas::SelectionPreviewPatch &patch : qAsConst(mCanvas->mCachedSelectionPreviewPatches))
+            mContentImageCacheBytes += counter.add(patch.image);
+    }
+
+    Clipboard *clipboard = Clipboard::instance();
+    if (ClipboardImage *clipboardImage = clipboard->image())
+        mClipboardBytes += counter.add(clipboardImage->image());
+    const QVector<CopiedLayerImage> copiedLayerImages = clipboard->copiedLayerImages();
+    for (const CopiedLayerImage &copiedLayerImage : copiedLayerImages)
+        mClipboardBytes += counter.add(copiedLayerImage.image);
+
+    if (mAutoSwatchModel)
+        mAutoSwatchBytes = mAutoSwatchModel->rowCount() * qint64(sizeof(QColor));
+
+    qCDebug(lcMemoryStats).nospace() << "total=" << totalBytes()
+        << " layers=" << mLayerBytes
+        << " undoStack=" << mUndoStackBytes
+        << " livePreview=" << mLivePreviewBytes
+        << " selection=" << mSelectionBytes
+        << " contentImageCache=" << mContentImageCacheBytes
+        << " clipboard=" << mClipboardBytes
+        << " autoSwatch=" << mAutoSwatchBytes;
+    for (const QVariant &typeMap : qAsConst(mUndoCommands))
+        qCDebug(lcMemoryStats) << "  undo command type:" << typeMap.toMap();
+
+    emit statsChanged();
+}
+
+void MemoryStats::reset()
+{
+    mLayerBytes = 0;
+    mUndoStackBytes = 0;
+    mLivePreviewBytes = 0;
+    mSelectionBytes = 0;
+    mContentImageCacheBytes = 0;
+    mClipboardBytes = 0;
+    mAutoSwatchBytes = 0;
+    mLayers.clear();
+    mUndoCommands.clear();
+}
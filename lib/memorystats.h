@@ -0,0 +1,119 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <QObject>
+#include <QPointer>
+#include <QQmlEngine>
+#include <QVariantList>
+
+#include "slate-global.h"
+
+class AutoSwatchModel;
+class ImageCanvas;
+
+/*
+    Reports how much memory the big image buffers of a canvas, its project,
+    the clipboard and the auto swatch are holding on to, so that it's possible
+    to tell where it's going when memory usage is high.
+
+    The stats are only gathered when refresh() is called, which also logs
+    them under the "app.memoryStats" category.
+
+    QImage shares its data between copies (e.g. an undo command usually holds
+    a copy of a layer's image), so each buffer is only counted once, against
+    the first category that it's found in. Categories are visited in the
+    order of the byte properties below.
+*/
+class SLATE_EXPORT MemoryStats : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(ImageCanvas *canvas READ canvas WRITE setCanvas NOTIFY canvasChanged)
+    Q_PROPERTY(AutoSwatchModel *autoSwatchModel READ autoSwatchModel WRITE setAutoSwatchModel NOTIFY autoSwatchModelChanged)
+    Q_PROPERTY(qint64 layerBytes READ layerBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 undoStackBytes READ undoStackBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 livePreviewBytes READ livePreviewBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 selectionBytes READ selectionBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 contentImageCacheBytes READ contentImageCacheBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 clipboardBytes READ clipboardBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 autoSwatchBytes READ autoSwatchBytes NOTIFY statsChanged)
+    Q_PROPERTY(qint64 totalBytes READ totalBytes NOTIFY statsChanged)
+    Q_PROPERTY(QVariantList layers READ layers NOTIFY statsChanged)
+    Q_PROPERTY(QVariantList undoCommands READ undoCommands NOTIFY statsChanged)
+    QML_ELEMENT
+    Q_MOC_INCLUDE("autoswatchmodel.h")
+    Q_MOC_INCLUDE("imagecanvas.h")
+
+public:
+    explicit MemoryStats(QObject *parent = nullptr);
+    ~MemoryStats() override;
+
+    ImageCanvas *canvas() const;
+    void setCanvas(ImageCanvas *canvas);
+
+    AutoSwatchModel *autoSwatchModel() const;
+    void setAutoSwatchModel(AutoSwatchModel *autoSwatchModel);
+
+    // The images of each layer (or the single image/tileset image for other project types).
+    qint64 layerBytes() const;
+    // Everything held by the commands in the project's undo stack, including undone ones.
+    qint64 undoStackBytes() const;
+    // The layer images that are kept while a live preview (e.g. Hue/Saturation) is active.
+    qint64 livePreviewBytes() const;
+    // The canvas's selection contents and the images that it keeps to modify them.
+    qint64 selectionBytes() const;
+    // The composited image that the canvas caches for picking the colour under the cursor.
+    qint64 contentImageCacheBytes() const;
+    qint64 clipboardBytes() const;
+    qint64 autoSwatchBytes() const;
+    qint64 totalBytes() const;
+
+    // One map per layer, each containing "name" and "bytes".
+    QVariantList layers() const;
+    // One map per type of undo command, each containing "type", "count" and "bytes".
+    // The type is the text of the top-level command; sorted by bytes, largest first.
+    QVariantList undoCommands() const;
+
+    Q_INVOKABLE void refresh();
+
+signals:
+    void canvasChanged();
+    void autoSwatchModelChanged();
+    void statsChanged();
+
+private:
+    void reset();
+
+    QPointer<ImageCanvas> mCanvas;
+    QPointer<AutoSwatchModel> mAutoSwatchModel;
+
+    qint64 mLayerBytes = 0;
+    qint64 mUndoStackBytes = 0;
+    qint64 mLivePreviewBytes = 0;
+    qint64 mSelectionBytes = 0;
+    qint64 mContentImageCacheBytes = 0;
+    qint64 mClipboardBytes = 0;
+    qint64 mAutoSwatchBytes = 0;
+    QVariantList mLayers;
+    QVariantList mUndoCommands;
+};
+
+#endif // MEMORYSTATS_H
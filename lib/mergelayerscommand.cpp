@@ -70,6 +70,15 @@ bool MergeLayersCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> MergeLayersCommand::heldImages() const
+{
+    // The source layer is only ours while it's merged; otherwise it's counted as part of the project.
+    QVector<QImage> images = { mPreviousTargetLayerImage };
+    if (mSourceLayerGuard)
+        images.append(*mSourceLayerGuard->image());
+    return images;
+}
+
 QDebug operator<<(QDebug debug, const MergeLayersCommand *command)
 {
     QDebugStateSaver saver(debug);
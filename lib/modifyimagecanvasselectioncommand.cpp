@@ -111,6 +111,11 @@ bool ModifyImageCanvasSelectionCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> ModifyImageCanvasSelectionCommand::heldImages() const
+{
+    return { mSouceAreaImage, mTargetAreaImageBeforeModification, mTargetAreaImageAfterModification, mPasteContents };
+}
+
 QDebug operator<<(QDebug debug, const ModifyImageCanvasSelectionCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -57,6 +57,11 @@ bool MoveLayeredImageContentsCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> MoveLayeredImageContentsCommand::heldImages() const
+{
+    return mPreviousImages + mNewImages;
+}
+
 QDebug operator<<(QDebug debug, const MoveLayeredImageContentsCommand *)
 {
     debug.nospace() << "(MoveLayeredImageContentsCommand)";
@@ -35,7 +35,9 @@ PaneDrawingHelper::PaneDrawingHelper(const ImageCanvas *canvas, QPainter *painte
     painter->translate(translateDistance);
 
     const int paneWidth = mCanvas->width() * mPane->size();
-    painter->setClipRect(-pane->integerOffset().x(), -pane->integerOffset().y(), paneWidth, mCanvas->height());
+    // Keep any existing clip (e.g. when only part of the item is being repainted).
+    painter->setClipRect(-pane->integerOffset().x(), -pane->integerOffset().y(), paneWidth, mCanvas->height(),
+        painter->hasClipping() ? Qt::IntersectClip : Qt::ReplaceClip);
 }
 
 PaneDrawingHelper::~PaneDrawingHelper()
@@ -58,6 +58,11 @@ bool PasteAcrossLayersCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> PasteAcrossLayersCommand::heldImages() const
+{
+    return mPreviousImages + mNewImages;
+}
+
 QDebug operator<<(QDebug debug, const PasteAcrossLayersCommand *)
 {
     debug.nospace() << "(PasteAcrossLayersCommand)";
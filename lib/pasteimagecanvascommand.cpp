@@ -73,6 +73,11 @@ bool PasteImageCanvasCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> PasteImageCanvasCommand::heldImages() const
+{
+    return { mNewImage, mPreviousImage };
+}
+
 QDebug operator<<(QDebug debug, const PasteImageCanvasCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -0,0 +1,246 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pixelbrush.h"
+
+#include <QtMath>
+
+#include <algorithm>
+
+/*!
+    Creates a brush of \a size pixels with the given \a shape.
+
+    The footprint is rendered with QPainter at a fixed anchor and stored as
+    a list of spans, so that stamping it is just a few scanline fills.
+*/
+PixelBrush::PixelBrush(int size, ImageCanvas::ToolShape shape) :
+    mSize(qMax(1, size)),
+    mShape(shape)
+{
+    // Leave enough room around the anchor for any cap style.
+    const int margin = mSize + 1;
+    const QPoint anchor(margin, margin);
+    QImage footprint(margin * 2 + 1, margin * 2 + 1, QImage::Format_ARGB32_Premultiplied);
+    footprint.fill(Qt::transparent);
+
+    QPainter painter(&footprint);
+    painter.setPen(pen(Qt::black));
+    painter.drawPoint(penPosition(anchor));
+    painter.end();
+
+    for (int y = 0; y < footprint.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(footprint.constScanLine(y));
+        int x = 0;
+        while (x < footprint.width()) {
+            if (qAlpha(line[x]) == 0) {
+                ++x;
+                continue;
+            }
+
+            const int spanStart = x;
+            while (x < footprint.width() && qAlpha(line[x]) != 0)
+                ++x;
+
+            const Span span = { y - anchor.y(), spanStart - anchor.x(), x - 1 - anchor.x() };
+            mSpans.append(span);
+            mBounds |= QRect(QPoint(span.x1, span.y), QPoint(span.x2, span.y));
+        }
+    }
+}
+
+int PixelBrush::size() const
+{
+    return mSize;
+}
+
+ImageCanvas::ToolShape PixelBrush::shape() const
+{
+    return mShape;
+}
+
+/*!
+    Returns the pen that QPainter-based drawing should use to match this brush.
+*/
+QPen PixelBrush::pen(const QColor &colour) const
+{
+    QPen pen;
+    pen.setColor(colour);
+    pen.setWidth(mSize);
+    if (mShape == ImageCanvas::SquareToolShape) {
+        pen.setCapStyle(Qt::PenCapStyle::SquareCap);
+        pen.setJoinStyle(Qt::PenJoinStyle::MiterJoin);
+    } else {
+        pen.setCapStyle(Qt::PenCapStyle::RoundCap);
+        pen.setJoinStyle(Qt::PenJoinStyle::RoundJoin);
+    }
+    return pen;
+}
+
+/*!
+    Snaps \a scenePos to the pixel grid, returning the integer position
+    that the brush is anchored to.
+*/
+QPoint PixelBrush::snappedPosition(const QPointF &scenePos) const
+{
+    if (mSize > 1) {
+        // Offset odd sized pens to pixel centre to centre pen.
+        const QPointF penOffset = (mSize % 2 == 1) ? QPointF(0.5, 0.5) : QPointF(0.0, 0.0);
+        return (scenePos + penOffset).toPoint();
+    }
+
+    // Handle inconsistent width 1 pen behaviour; this is off pixel centres,
+    // but it's what single pixel strokes have always done.
+    return QPoint(qFloor(scenePos.x()), qFloor(scenePos.y()));
+}
+
+/*!
+    Returns the position that a QPainter should draw at for \a snappedPos.
+*/
+QPointF PixelBrush::penPosition(const QPoint &snappedPos) const
+{
+    if (mSize > 1 && mSize % 2 == 1)
+        return QPointF(snappedPos) - QPointF(0.5, 0.5);
+    return QPointF(snappedPos);
+}
+
+/*!
+    Returns the pixels covered by a single stamp at \a snappedPos.
+*/
+QRect PixelBrush::stampRect(const QPoint &snappedPos) const
+{
+    return mBounds.translated(snappedPos);
+}
+
+/*!
+    Returns the pixels covered by a line from \a snappedPos1 to \a snappedPos2.
+*/
+QRect PixelBrush::lineRect(const QPoint &snappedPos1, const QPoint &snappedPos2) const
+{
+    return stampRect(snappedPos1).united(stampRect(snappedPos2));
+}
+
+/*!
+    Returns \c true if drawLine() can be used to draw on \a image with
+    \a mode; i.e. the image uses a 32-bit format and the result of
+    \a mode doesn't depend on what was already there.
+*/
+bool PixelBrush::canDraw(const QImage &image, QPainter::CompositionMode mode)
+{
+    return !image.isNull() && image.depth() == 32
+        && (mode == QPainter::CompositionMode_Source || mode == QPainter::CompositionMode_Clear);
+}
+
+// Lets QPainter do the colour conversion so that the result is identical
+// to what it would have written for a fully covered pixel.
+static uint pixelValue(QImage::Format format, const QColor &colour, QPainter::CompositionMode mode)
+{
+    QImage pixel(1, 1, format);
+    pixel.fill(0);
+    QPainter painter(&pixel);
+    painter.setCompositionMode(mode);
+    painter.fillRect(0, 0, 1, 1, colour);
+    painter.end();
+    return *reinterpret_cast<const uint*>(pixel.constScanLine(0));
+}
+
+/*!
+    Stamps the brush at every point of the line from \a snappedPos1 to
+    \a snappedPos2 (inclusive) in \a image, restricted to \a clipRect.
+
+    Callers must check canDraw() first.
+*/
+void PixelBrush::drawLine(QImage *image, const QPoint &snappedPos1, const QPoint &snappedPos2,
+    const QColor &colour, QPainter::CompositionMode mode, const QRect &clipRect) const
+{
+    drawPolyline(image, { snappedPos1, snappedPos2 }, colour, mode, clipRect);
+}
+
+/*!
+    Like drawLine(), but draws a line between each consecutive pair of
+    \a snappedPositions. A single position results in a single stamp.
+*/
+void PixelBrush::drawPolyline(QImage *image, const QVector<QPoint> &snappedPositions,
+    const QColor &colour, QPainter::CompositionMode mode, const QRect &clipRect) const
+{
+    Q_ASSERT(canDraw(*image, mode));
+
+    const QRect clip = clipRect.intersected(image->rect());
+    if (clip.isEmpty() || snappedPositions.isEmpty())
+        return;
+
+    const uint pixel = pixelValue(image->format(), colour, mode);
+    if (snappedPositions.size() == 1) {
+        stamp(image, snappedPositions.first(), pixel, clip);
+        return;
+    }
+
+    for (int i = 1; i < snappedPositions.size(); ++i)
+        drawSegment(image, snappedPositions.at(i - 1), snappedPositions.at(i), pixel, clip);
+}
+
+void PixelBrush::drawSegment(QImage *image, const QPoint &snappedPos1, const QPoint &snappedPos2,
+    uint pixel, const QRect &clipRect) const
+{
+    if (!lineRect(snappedPos1, snappedPos2).intersects(clipRect))
+        return;
+
+    // Bresenham.
+    int x = snappedPos1.x();
+    int y = snappedPos1.y();
+    const int dx = qAbs(snappedPos2.x() - x);
+    const int dy = -qAbs(snappedPos2.y() - y);
+    const int stepX = x < snappedPos2.x() ? 1 : -1;
+    const int stepY = y < snappedPos2.y() ? 1 : -1;
+    int error = dx + dy;
+    forever {
+        stamp(image, QPoint(x, y), pixel, clipRect);
+        if (x == snappedPos2.x() && y == snappedPos2.y())
+            break;
+
+        const int doubledError = error * 2;
+        if (doubledError >= dy) {
+            error += dy;
+            x += stepX;
+        }
+        if (doubledError <= dx) {
+            error += dx;
+            y += stepY;
+        }
+    }
+}
+
+void PixelBrush::stamp(QImage *image, const QPoint &snappedPos, uint pixel, const QRect &clipRect) const
+{
+    if (!stampRect(snappedPos).intersects(clipRect))
+        return;
+
+    for (const Span &span : mSpans) {
+        const int y = snappedPos.y() + span.y;
+        if (y < clipRect.top() || y > clipRect.bottom())
+            continue;
+
+        const int x1 = qMax(snappedPos.x() + span.x1, clipRect.left());
+        const int x2 = qMin(snappedPos.x() + span.x2, clipRect.right());
+        if (x1 > x2)
+            continue;
+
+        uint *line = reinterpret_cast<uint*>(image->scanLine(y));
+        std::fill(line + x1, line + x2 + 1, pixel);
+    }
+}
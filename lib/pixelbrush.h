@@ -0,0 +1,85 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PIXELBRUSH_H
+#define PIXELBRUSH_H
+
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QPen>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <QVector>
+
+#include "imagecanvas.h"
+#include "slate-global.h"
+
+/*!
+    Rasterises pixel-art strokes by stamping a brush footprint along a
+    Bresenham line, writing straight into the scanlines of 32-bit images.
+
+    The footprint is rendered once with the same pen that ImageCanvas uses
+    for its QPainter-based lines, so a single click produces exactly the
+    same pixels either way.
+
+    All positions passed to the drawing functions are snapped positions
+    (see snappedPosition()); snapping commutes with integer translations,
+    so callers can offset them freely.
+*/
+class SLATE_EXPORT PixelBrush
+{
+public:
+    PixelBrush(int size, ImageCanvas::ToolShape shape);
+
+    int size() const;
+    ImageCanvas::ToolShape shape() const;
+
+    QPen pen(const QColor &colour) const;
+    QPoint snappedPosition(const QPointF &scenePos) const;
+    QPointF penPosition(const QPoint &snappedPos) const;
+
+    QRect stampRect(const QPoint &snappedPos) const;
+    QRect lineRect(const QPoint &snappedPos1, const QPoint &snappedPos2) const;
+
+    static bool canDraw(const QImage &image, QPainter::CompositionMode mode);
+    void drawLine(QImage *image, const QPoint &snappedPos1, const QPoint &snappedPos2,
+        const QColor &colour, QPainter::CompositionMode mode, const QRect &clipRect) const;
+    void drawPolyline(QImage *image, const QVector<QPoint> &snappedPositions,
+        const QColor &colour, QPainter::CompositionMode mode, const QRect &clipRect) const;
+
+private:
+    // A horizontal run of covered pixels, relative to the brush's anchor.
+    struct Span {
+        int y;
+        int x1;
+        int x2;
+    };
+
+    void drawSegment(QImage *image, const QPoint &snappedPos1, const QPoint &snappedPos2, uint pixel, const QRect &clipRect) const;
+    void stamp(QImage *image, const QPoint &snappedPos, uint pixel, const QRect &clipRect) const;
+
+    int mSize;
+    ImageCanvas::ToolShape mShape;
+    QVector<Span> mSpans;
+    QRect mBounds;
+};
+
+#endif // PIXELBRUSH_H
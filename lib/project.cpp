@@ -29,8 +29,10 @@
 #include <QMetaEnum>
 
 #include "applicationsettings.h"
+#include "frametimings.h"
 #include "imageutils.h"
 #include "qtutils.h"
+#include "tracer.h"
 
 Q_LOGGING_CATEGORY(lcProject, "app.project")
 Q_LOGGING_CATEGORY(lcProjectGuides, "app.project.guides")
@@ -44,9 +46,25 @@ Project::Project() :
     mLivePreviewActive(false),
     mCurrentLivePreviewModification(LivePreviewModification::None),
     mComposingMacro(false),
-    mHadUnsavedChangesBeforeMacroBegan(false)
+    mHadUnsavedChangesBeforeMacroBegan(false),
+    mContentsGeneration(1),
+    mCachedExportedImageGeneration(0)
 {
     connect(&mUndoStack, SIGNAL(cleanChanged(bool)), this, SIGNAL(unsavedChangesChanged()));
+
+    // Anything that could change what exportedImage() returns needs to invalidate it.
+    // Undoing and redoing doesn't emit contentsModified(), hence indexChanged.
+    const auto invalidateExportedImage = [=]() { ++mContentsGeneration; };
+    connect(this, &Project::contentsModified, this, invalidateExportedImage);
+    connect(this, &Project::projectCreated, this, invalidateExportedImage);
+    connect(this, &Project::projectClosed, this, [=]() {
+        ++mContentsGeneration;
+        // Don't hold on to the old project's image until someone asks for the new one.
+        mCachedExportedImage = QImage();
+    });
+    connect(this, &Project::loadedChanged, this, invalidateExportedImage);
+    connect(this, &Project::sizeChanged, this, invalidateExportedImage);
+    connect(&mUndoStack, &QUndoStack::indexChanged, this, invalidateExportedImage);
 }
 
 Project::Type Project::type() const
@@ -163,6 +181,8 @@ bool Project::canSave() const
 
 void Project::load(const QUrl &url)
 {
+    SLATE_TRACE_SCOPE("io", "Project::load");
+
     qCDebug(lcProject) << "loading project:" << url;
 
     close();
@@ -201,6 +221,8 @@ bool Project::save()
 
 bool Project::saveAs(const QUrl &url)
 {
+    SLATE_TRACE_SCOPE("io", "Project::saveAs");
+
     emit preProjectSaved();
 
     if (!hasLoaded()) {
@@ -343,7 +365,15 @@ QUrl Project::createTemporaryImage(int width, int height, const QColor &colour)
         return QUrl();
     }
 
-    QImage tempImage = ImageUtils::filledImage(width, height, colour);
+    return createTemporaryImage(ImageUtils::filledImage(width, height, colour));
+}
+
+QUrl Project::createTemporaryImage(const QImage &tempImage)
+{
+    if (!mTempDir.isValid()) {
+        error(QString::fromLatin1("Failed to create temporary image directory: %1").arg(mTempDir.errorString()));
+        return QUrl();
+    }
 
     const QString dateString = QDateTime::currentDateTime().toString(QLatin1String("hh-mm-ss-zzz"));
     const QString fileName = QString::fromLatin1("%1/tmp-image-%2.png").arg(mTempDir.path(), dateString);
@@ -520,6 +550,11 @@ void Project::setSettings(ApplicationSettings *settings)
     emit settingsChanged();
 }
 
+void Project::setFrameTimings(FrameTimings *frameTimings)
+{
+    mFrameTimings = frameTimings;
+}
+
 SerialisableState *Project::uiState()
 {
     return &mUiState;
@@ -674,6 +709,21 @@ int Project::currentLayerIndex() const
 }
 
 QImage Project::exportedImage() const
+{
+    if (mCachedExportedImageGeneration != mContentsGeneration) {
+        mCachedExportedImage = createExportedImage();
+        mCachedExportedImageGeneration = mContentsGeneration;
+        qCDebug(lcProject) << "created exported image for contents generation" << mContentsGeneration;
+    }
+    return mCachedExportedImage;
+}
+
+quint64 Project::contentsGeneration() const
+{
+    return mContentsGeneration;
+}
+
+QImage Project::createExportedImage() const
 {
     return QImage();
 }
@@ -755,6 +805,9 @@ QDebug operator<<(QDebug debug, const QUndoCommand *command)
 
 void Project::addChange(UndoCommand *undoCommand)
 {
+    SLATE_TRACE_SCOPE("undo", "Project::addChange");
+    const FrameTimings::ScopedStageTimer stageTimer(mFrameTimings, FrameTimings::UndoPushStage);
+
     qCDebug(lcProject) << "adding change" << undoCommand;
 
     const bool modifiedContents = undoCommand->modifiesContents();
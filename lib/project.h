@@ -24,6 +24,7 @@
 #include <QJsonObject>
 #include <QLoggingCategory>
 #include <QObject>
+#include <QPointer>
 #include <QSize>
 #include <QTemporaryDir>
 #include <QVersionNumber>
@@ -42,6 +43,7 @@ Q_DECLARE_LOGGING_CATEGORY(lcProject)
 Q_DECLARE_LOGGING_CATEGORY(lcProjectLifecycle)
 
 class ApplicationSettings;
+class FrameTimings;
 
 class SLATE_EXPORT Project : public QObject
 {
@@ -121,8 +123,11 @@ public:
     virtual int currentLayerIndex() const;
 
     // Used by animation system (only image projects need to implement this)
-    // and MoveContentsDialog.
-    Q_INVOKABLE virtual QImage exportedImage() const;
+    // and MoveContentsDialog. The image is cached until the contents are next
+    // modified, so consumers can call this as often as they like.
+    Q_INVOKABLE QImage exportedImage() const;
+    // Incremented each time the contents might have changed.
+    quint64 contentsGeneration() const;
 
     QUndoStack *undoStack();
 
@@ -135,6 +140,9 @@ public:
     ApplicationSettings *settings() const;
     void setSettings(ApplicationSettings *settings);
 
+    // Set by the canvas so that undo pushes show up in the frame-time overlay.
+    void setFrameTimings(FrameTimings *frameTimings);
+
     SerialisableState *uiState();
 
     enum SwatchImportFormat {
@@ -209,17 +217,22 @@ public slots:
     virtual void endLivePreview(LivePreviewModificationAction modificationAction);
 
 protected:
+    friend class MemoryStats;
+
     void error(const QString &message);
 
     virtual void doLoad(const QUrl &url);
     virtual void doClose();
     virtual bool doSaveAs(const QUrl &url);
+    // Creates the image returned by exportedImage() when the cached one is stale.
+    virtual QImage createExportedImage() const;
 
     bool warnIfLivePreviewNotActive(const QString &actionName) const;
 
     void setComposingMacro(bool composingMacro, const QString &macroText = QString());
 
     QUrl createTemporaryImage(int width, int height, const QColor &colour);
+    QUrl createTemporaryImage(const QImage &image);
 
     void readVersionNumbers(const QJsonObject &projectJson);
     void writeVersionNumbers(QJsonObject &projectJson);
@@ -254,10 +267,15 @@ protected:
     LivePreviewModification mCurrentLivePreviewModification;
 
     QUndoStack mUndoStack;
+    QPointer<FrameTimings> mFrameTimings;
     bool mComposingMacro;
     QString mCurrentlyComposingMacroText;
     bool mHadUnsavedChangesBeforeMacroBegan;
 
+    quint64 mContentsGeneration;
+    mutable QImage mCachedExportedImage;
+    mutable quint64 mCachedExportedImageGeneration;
+
     QList<Guide> mGuides;
     QList<Note> mNotes;
 
@@ -57,6 +57,11 @@ bool RearrangeImageContentsIntoGridCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> RearrangeImageContentsIntoGridCommand::heldImages() const
+{
+    return { mPreviousImage, mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const RearrangeImageContentsIntoGridCommand *command)
 {
     QDebugStateSaver saver(debug);
@@ -57,6 +57,11 @@ bool RearrangeLayeredImageContentsIntoGridCommand::modifiesContents() const
     return true;
 }
 
+QVector<QImage> RearrangeLayeredImageContentsIntoGridCommand::heldImages() const
+{
+    return mPreviousImages + mNewImages;
+}
+
 QDebug operator<<(QDebug debug, const RearrangeLayeredImageContentsIntoGridCommand *)
 {
     debug.nospace() << "(RearrangeLayeredImageContentsIntoGridCommand)";
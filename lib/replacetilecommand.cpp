@@ -0,0 +1,72 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replacetilecommand.h"
+
+#include <QLoggingCategory>
+
+#include "tilesetproject.h"
+
+Q_LOGGING_CATEGORY(lcReplaceTileCommand, "app.undo.replaceTileCommand")
+
+ReplaceTileCommand::ReplaceTileCommand(TilesetProject *project, int tileId, int replacementTileId,
+    const QVector<int> &tileIndices, UndoCommand *parent) :
+    UndoCommand(parent),
+    mProject(project),
+    mTileId(tileId),
+    mReplacementTileId(replacementTileId),
+    mTileIndices(tileIndices)
+{
+    qCDebug(lcReplaceTileCommand) << "constructed" << this;
+}
+
+void ReplaceTileCommand::undo()
+{
+    qCDebug(lcReplaceTileCommand) << "undoing" << this;
+    mProject->setTilesAtIndices(mTileIndices, mTileId);
+}
+
+void ReplaceTileCommand::redo()
+{
+    qCDebug(lcReplaceTileCommand) << "redoing" << this;
+    mProject->setTilesAtIndices(mTileIndices, mReplacementTileId);
+}
+
+int ReplaceTileCommand::id() const
+{
+    return -1;
+}
+
+bool ReplaceTileCommand::modifiesContents() const
+{
+    return true;
+}
+
+QDebug operator<<(QDebug debug, const ReplaceTileCommand *command)
+{
+    QDebugStateSaver saver(debug);
+    if (!command)
+        return debug << "ReplaceTileCommand(0x0)";
+
+    debug.nospace() << "(ReplaceTileCommand tileId=" << command->mTileId
+        << " replacementTileId=" << command->mReplacementTileId
+        << " uses=" << command->mTileIndices.size()
+        << ")";
+    return debug;
+}
@@ -17,41 +17,39 @@
     along with Slate. If not, see <http://www.gnu.org/licenses/>.
 */
 
-#ifndef APPLYPENPIXELCOMMAND_H
-#define APPLYPENPIXELCOMMAND_H
+#ifndef REPLACETILECOMMAND_H
+#define REPLACETILECOMMAND_H
 
-#include <QColor>
 #include <QDebug>
-#include <QPoint>
 #include <QVector>
 
-#include "imagecanvas.h"
 #include "slate-global.h"
 #include "undocommand.h"
 
-class SLATE_EXPORT ApplyPixelPenCommand : public UndoCommand
+class TilesetProject;
+
+class SLATE_EXPORT ReplaceTileCommand : public UndoCommand
 {
 public:
-    ApplyPixelPenCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions, const QVector<QColor> &previousColours,
-        const QColor &colour, UndoCommand *parent = nullptr);
+    ReplaceTileCommand(TilesetProject *project, int tileId, int replacementTileId,
+        const QVector<int> &tileIndices, UndoCommand *parent = nullptr);
 
     void undo() override;
     void redo() override;
 
     int id() const override;
-    bool mergeWith(const QUndoCommand *other) override;
 
     bool modifiesContents() const override;
 
 private:
-    friend QDebug operator<<(QDebug debug, const ApplyPixelPenCommand *command);
+    friend QDebug operator<<(QDebug debug, const ReplaceTileCommand *command);
 
-    ImageCanvas *mCanvas;
-    int mLayerIndex;
-    QVector<QPoint> mScenePositions;
-    QVector<QColor> mPreviousColours;
-    QColor mColour;
+    TilesetProject *mProject;
+    int mTileId;
+    int mReplacementTileId;
+    // The indices into the project's tiles that used mTileId.
+    QVector<int> mTileIndices;
 };
 
 
-#endif // APPLYPENPIXELCOMMAND_H
+#endif // REPLACETILECOMMAND_H
@@ -20,6 +20,7 @@
 #include "tilecanvas.h"
 
 #include <QCursor>
+#include <QHash>
 #include <QLoggingCategory>
 #include <QPainter>
 #include <QQuickWindow>
@@ -28,7 +29,6 @@
 #include "applypixelerasercommand.h"
 #include "applypixelfillcommand.h"
 #include "applypixellinecommand.h"
-#include "applypixelpencommand.h"
 #include "applytilecanvaspixelfillcommand.h"
 #include "applytileerasercommand.h"
 #include "applytilefillcommand.h"
@@ -46,7 +46,9 @@ TileCanvas::TileCanvas() :
     mMode(TileMode),
     mPenTile(nullptr),
     mTilePenPreview(false),
-    mGridVisible(false)
+    mGridVisible(false),
+    mHighlightedTileId(-1),
+    mHighlightColour(Qt::red)
 {
     qCDebug(lcImageCanvasLifecycle) << "constructing TileCanvas" << this;
 }
@@ -97,6 +99,38 @@ void TileCanvas::setGridVisible(bool gridVisible)
     emit gridVisibleChanged();
 }
 
+int TileCanvas::highlightedTileId() const
+{
+    return mHighlightedTileId;
+}
+
+void TileCanvas::setHighlightedTileId(int highlightedTileId)
+{
+    if (highlightedTileId == mHighlightedTileId)
+        return;
+
+    const int oldHighlightedTileId = mHighlightedTileId;
+    mHighlightedTileId = highlightedTileId;
+    requestTileUsagesPaint(oldHighlightedTileId);
+    requestTileUsagesPaint(mHighlightedTileId);
+    emit highlightedTileIdChanged();
+}
+
+QColor TileCanvas::highlightColour() const
+{
+    return mHighlightColour;
+}
+
+void TileCanvas::setHighlightColour(const QColor &highlightColour)
+{
+    if (highlightColour == mHighlightColour)
+        return;
+
+    mHighlightColour = highlightColour;
+    requestTileUsagesPaint(mHighlightedTileId);
+    emit highlightColourChanged();
+}
+
 int TileCanvas::cursorTilePixelX() const
 {
     return mCursorTilePixelX;
@@ -133,6 +167,7 @@ void TileCanvas::reset()
     setCursorTilePixelY(0);
     setPenTile(nullptr);
     setTilePenPreview(false);
+    setHighlightedTileId(Tile::invalidId());
 
     // Things that we don't want to set, as they
     // don't really need to be reset each time:
@@ -178,14 +213,48 @@ void TileCanvas::swatchDown()
 void TileCanvas::onTilesetChanged(Tileset *oldTileset, Tileset *newTileset)
 {
     if (oldTileset) {
-        disconnect(oldTileset, &Tileset::imageChanged, this, &TileCanvas::requestContentPaint);
+        disconnect(oldTileset, &Tileset::imageChanged, this, &TileCanvas::onTilesetImageChanged);
     }
 
     if (newTileset) {
-        connect(newTileset, &Tileset::imageChanged, this, &TileCanvas::requestContentPaint);
+        connect(newTileset, &Tileset::imageChanged, this, &TileCanvas::onTilesetImageChanged);
     }
 }
 
+void TileCanvas::onTilesetImageChanged(const QRegion &changedRegion)
+{
+    // The tile pen preview can show any tile anywhere, so just repaint everything.
+    if (mTilePenPreview) {
+        requestContentPaint();
+        return;
+    }
+
+    // Only repaint the parts of the map that show the tiles that changed.
+    const Tileset *tileset = mTilesetProject->tileset();
+    const int tileWidth = mTilesetProject->tileWidth();
+    const int tileHeight = mTilesetProject->tileHeight();
+    const QRect changedTilesetRect = changedRegion.boundingRect().intersected(tileset->image()->rect());
+    if (changedTilesetRect.isEmpty())
+        return;
+
+    QRect changedSceneRect;
+    for (int y = changedTilesetRect.top() / tileHeight; y <= changedTilesetRect.bottom() / tileHeight; ++y) {
+        for (int x = changedTilesetRect.left() / tileWidth; x <= changedTilesetRect.right() / tileWidth; ++x) {
+            const Tile *tile = mTilesetProject->tilesetTileAtTilePos(QPoint(x, y));
+            if (!tile)
+                continue;
+
+            const QVector<QPoint> tilePositions = mTilesetProject->tilePositionsUsingTile(tile->id());
+            for (const QPoint &tilePos : tilePositions) {
+                changedSceneRect |= QRect(tilePos.x() * tileWidth, tilePos.y() * tileHeight, tileWidth, tileHeight);
+            }
+        }
+    }
+
+    if (!changedSceneRect.isEmpty())
+        requestContentRectPaint(changedSceneRect);
+}
+
 void TileCanvas::restoreState()
 {
     ImageCanvas::restoreState();
@@ -209,6 +278,7 @@ void TileCanvas::connectSignals()
     Q_ASSERT_X(mTilesetProject, Q_FUNC_INFO, "Non-tileset project set on TileCanvas");
 
     connect(mTilesetProject, &TilesetProject::tilesCleared, this, &TileCanvas::requestContentPaint);
+    connect(mTilesetProject, &TilesetProject::tilesChanged, this, &TileCanvas::requestContentPaint);
     connect(mTilesetProject, &TilesetProject::tilesetChanged, this, &TileCanvas::onTilesetChanged);
 
     setPenTile(mTilesetProject->tilesetTileAt(0, 0));
@@ -223,6 +293,7 @@ void TileCanvas::disconnectSignals()
     ImageCanvas::disconnectSignals();
 
     disconnect(mTilesetProject, &TilesetProject::tilesCleared, this, &TileCanvas::requestContentPaint);
+    disconnect(mTilesetProject, &TilesetProject::tilesChanged, this, &TileCanvas::requestContentPaint);
     disconnect(mTilesetProject, &TilesetProject::tilesetChanged, this, &TileCanvas::onTilesetChanged);
 
     setPenTile(nullptr);
@@ -240,34 +311,55 @@ bool TileCanvas::supportsSelectionTool() const
     return false;
 }
 
-TileCanvas::PixelCandidateData TileCanvas::penEraserPixelCandidates(Tool tool) const
+TileCanvas::PixelBufferData TileCanvas::penEraserPixelBuffer(Tool tool) const
 {
-    PixelCandidateData candidateData;
+    PixelBufferData pixelData;
 
     const QPoint topLeft(qRound(mCursorSceneFX - mToolSize / 2.0), qRound(mCursorSceneFY - mToolSize / 2.0));
     const QPoint bottomRight(qRound(mCursorSceneFX + mToolSize / 2.0), qRound(mCursorSceneFY + mToolSize / 2.0));
-    QPoint scenePos(topLeft);
-    for (; scenePos.y() < bottomRight.y(); ++scenePos.ry()) {
-        for (scenePos.rx() = topLeft.x(); scenePos.x() < bottomRight.x(); ++scenePos.rx()) {
-            const Tile *tile = mTilesetProject->tileAt(scenePos);
-            if (tile) {
-                const QPoint tilePixelPos = scenePosToTilePixelPos(scenePos);
-                const QColor previousColour = tile->pixelColor(tilePixelPos);
-                // Don't do anything if the colours are the same; this prevents issues
-                // with undos not undoing everything across tiles.
-                const bool hasEffect = tool == PenTool ? penColour() != previousColour : previousColour != QColor(Qt::transparent);
-                if (hasEffect) {
-                    candidateData.scenePositions.append(scenePos);
-                    candidateData.previousColours.append(previousColour);
-                }
-            }
+    pixelData.sceneRect = QRect(topLeft, QSize(bottomRight.x() - topLeft.x(), bottomRight.y() - topLeft.y()));
+    if (pixelData.sceneRect.isEmpty())
+        return pixelData;
+
+    const QImage *tilesetImage = mTilesetProject->tileset()->image();
+    const uint newPixel = ImageUtils::rawPixelValue(*tilesetImage, tool == PenTool ? penColour() : QColor(Qt::transparent));
+    const int pixelCount = pixelData.sceneRect.width() * pixelData.sceneRect.height();
+    pixelData.previousPixels.resize(pixelCount);
+    pixelData.newPixels.fill(newPixel, pixelCount);
+    pixelData.mask.resize(pixelCount);
+
+    int i = 0;
+    for (int y = pixelData.sceneRect.top(); y <= pixelData.sceneRect.bottom(); ++y) {
+        for (int x = pixelData.sceneRect.left(); x <= pixelData.sceneRect.right(); ++x, ++i) {
+            const QPoint scenePos(x, y);
+            const int tileId = mTilesetProject->tileIdAt(scenePos);
+            if (tileId == Tile::invalidId())
+                continue;
+
+            const QPoint tilesetPos = mTilesetProject->tileSourceRect(tileId).topLeft() + scenePosToTilePixelPos(scenePos);
+            const uint previousPixel = ImageUtils::rawPixel(*tilesetImage, tilesetPos.x(), tilesetPos.y());
+            pixelData.previousPixels[i] = previousPixel;
+            // Don't do anything if the colours are the same; this prevents issues
+            // with undos not undoing everything across tiles.
+            if (previousPixel != newPixel)
+                pixelData.mask.setBit(i);
         }
     }
 
-    return candidateData;
+    return pixelData;
 }
 
 TileCanvas::PixelCandidateData TileCanvas::fillPixelCandidates() const
+{
+    return tilePixelFillCandidates(tilesetPixelFloodFill);
+}
+
+ImageCanvas::PixelCandidateData TileCanvas::greedyFillPixelCandidates() const
+{
+    return tilePixelFillCandidates(tilesetGreedyPixelFill);
+}
+
+TileCanvas::PixelCandidateData TileCanvas::tilePixelFillCandidates(TilePixelFillFunction fillFunction) const
 {
     PixelCandidateData candidateData;
 
@@ -286,8 +378,9 @@ TileCanvas::PixelCandidateData TileCanvas::fillPixelCandidates() const
     }
 
     QVector<QPoint> tilePixelPositions;
-    tilesetPixelFloodFill(tile, tilePixelPos, previousColour, penColour(), tilePixelPositions);
+    fillFunction(tile, tilePixelPos, previousColour, penColour(), tilePixelPositions);
 
+    candidateData.scenePositions.reserve(tilePixelPositions.size());
     for (const QPoint &pixelPos : tilePixelPositions) {
         candidateData.scenePositions.append(tileTopLeftScenePos + pixelPos);
     }
@@ -296,12 +389,6 @@ TileCanvas::PixelCandidateData TileCanvas::fillPixelCandidates() const
     return candidateData;
 }
 
-ImageCanvas::PixelCandidateData TileCanvas::greedyFillPixelCandidates() const
-{
-    // TODO
-    return PixelCandidateData();
-}
-
 TileCanvas::TileCandidateData TileCanvas::fillTileCandidates() const
 {
     TileCandidateData candidateData;
@@ -317,7 +404,7 @@ TileCanvas::TileCandidateData TileCanvas::fillTileCandidates() const
 
     const int xTile = scenePos.x() / mTilesetProject->tileWidth();
     const int yTile = scenePos.y() / mTilesetProject->tileHeight();
-    tilesetTileFloodFill(mTilesetProject, tile, QPoint(xTile, yTile), previousTileId, newTileId, candidateData.tilePositions);
+    tilesetTileFloodFill(mTilesetProject, QPoint(xTile, yTile), previousTileId, newTileId, candidateData.tilePositions);
 
     candidateData.previousTile = previousTileId;
     candidateData.newTileId = newTileId;
@@ -367,13 +454,13 @@ void TileCanvas::applyCurrentTool()
     }
     case EraserTool: {
         if (mMode == PixelMode) {
-            const PixelCandidateData candidateData = penEraserPixelCandidates(EraserTool);
-            if (candidateData.scenePositions.isEmpty()) {
+            const PixelBufferData pixelData = penEraserPixelBuffer(EraserTool);
+            if (pixelData.isEmpty()) {
                 return;
             }
 
             mTilesetProject->beginMacro(QLatin1String("PixelEraserTool"));
-            mTilesetProject->addChange(new ApplyPixelEraserCommand(this, -1, candidateData.scenePositions, candidateData.previousColours));
+            mTilesetProject->addChange(new ApplyPixelEraserCommand(this, -1, pixelData));
         } else {
             const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
             const Tile *tile = mTilesetProject->tileAt(scenePos);
@@ -391,7 +478,8 @@ void TileCanvas::applyCurrentTool()
     }
     case FillTool: {
         if (mMode == PixelMode) {
-            const PixelCandidateData candidateData = fillPixelCandidates();
+            const PixelCandidateData candidateData = !isShiftPressed()
+                ? fillPixelCandidates() : greedyFillPixelCandidates();
             if (candidateData.scenePositions.isEmpty()) {
                 return;
             }
@@ -416,6 +504,19 @@ void TileCanvas::applyCurrentTool()
     }
 }
 
+bool TileCanvas::canCoalesceStrokePoints() const
+{
+    // Only the pen draws lines; the eraser works on the pixels under the cursor.
+    return mMode == PixelMode && effectiveTool() == PenTool;
+}
+
+void TileCanvas::applyPixelStroke(const QVector<QPointF> &points)
+{
+    mProject->beginMacro(QLatin1String("PixelLineTool"));
+    mProject->addChange(new ApplyPixelLineCommand(this, -1, *mTilesetProject->tileset()->image(), points,
+        points.last(), mLastPixelPenPressScenePositionF, QPainter::CompositionMode_Source));
+}
+
 QPoint TileCanvas::scenePosToTilePixelPos(const QPoint &scenePos) const
 {
     return QPoint(scenePos.x() % mTilesetProject->tileWidth(),
@@ -434,15 +535,21 @@ QList<ImageCanvas::SubImage> TileCanvas::subImagesInBounds(const QRect &bounds)
     QList<ImageCanvas::SubImage> subImages;
     for (int y = tileRect.top(); y <= tileRect.bottom(); ++y) {
         for (int x = tileRect.left(); x <= tileRect.right(); ++x) {
-            const Tile *const tile = mTilesetProject->tileAtTilePos({x, y});
-            if (tile) {
-                subImages.append({tile->sourceRect(), {x * mTilesetProject->tileWidth(), y * mTilesetProject->tileHeight()}});
+            const int tileId = mTilesetProject->tileIdAtTilePos({x, y});
+            if (tileId != Tile::invalidId()) {
+                subImages.append({mTilesetProject->tileSourceRect(tileId), {x * mTilesetProject->tileWidth(), y * mTilesetProject->tileHeight()}});
             }
         }
     }
     return subImages;
 }
 
+QImage *TileCanvas::imageForLayerAt(int layerIndex)
+{
+    Q_ASSERT(layerIndex == -1);
+    return mTilesetProject->tileset()->image();
+}
+
 // This function actually operates on the image.
 void TileCanvas::applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease)
 {
@@ -453,10 +560,52 @@ void TileCanvas::applyPixelPenTool(int layerIndex, const QPoint &scenePos, const
         "No tile at scene pos {%1, %2}").arg(scenePos.x()).arg(scenePos.y())));
     const QPoint pixelPos = scenePosToTilePixelPos(scenePos);
     const QPoint tilsetPixelPos = tile->sourceRect().topLeft() + pixelPos;
+    // The tileset notifies us of the change, which causes a repaint.
     mTilesetProject->tileset()->setPixelColor(tilsetPixelPos.x(), tilsetPixelPos.y(), colour);
     if (markAsLastRelease)
         mLastPixelPenPressScenePositionF = scenePos;
-    requestContentPaint();
+}
+
+// This function actually operates on the image.
+void TileCanvas::applyPixelBuffer(int layerIndex, const QRect &sceneRect, const QVector<uint> &pixels, const QBitArray &mask)
+{
+    Q_ASSERT(layerIndex == -1);
+
+    QImage *tilesetImage = mTilesetProject->tileset()->image();
+    // Track the changed area of each tile rather than each pixel.
+    QHash<int, QRect> changedTileRects;
+    int i = 0;
+    for (int y = sceneRect.top(); y <= sceneRect.bottom(); ++y) {
+        for (int x = sceneRect.left(); x <= sceneRect.right(); ++x, ++i) {
+            if (!mask.testBit(i))
+                continue;
+
+            const QPoint scenePos(x, y);
+            const int tileId = mTilesetProject->tileIdAt(scenePos);
+            Q_ASSERT_X(tileId != Tile::invalidId(), Q_FUNC_INFO, qPrintable(QString::fromLatin1(
+                "No tile at scene pos {%1, %2}").arg(x).arg(y)));
+            const QPoint tilesetPos = mTilesetProject->tileSourceRect(tileId).topLeft() + scenePosToTilePixelPos(scenePos);
+            ImageUtils::setRawPixel(*tilesetImage, tilesetPos.x(), tilesetPos.y(), pixels.at(i));
+            changedTileRects[tileId] |= QRect(tilesetPos, QSize(1, 1));
+        }
+    }
+
+    QRegion changedRegion;
+    for (const QRect &rect : qAsConst(changedTileRects))
+        changedRegion += rect;
+    // The tileset notifies us of the change, which causes a repaint.
+    if (!changedRegion.isEmpty())
+        mTilesetProject->tileset()->notifyImageChanged(changedRegion);
+}
+
+void TileCanvas::beginPixelPenChanges()
+{
+    mTilesetProject->tileset()->beginChanges();
+}
+
+void TileCanvas::endPixelPenChanges()
+{
+    mTilesetProject->tileset()->commitChanges();
 }
 
 void TileCanvas::applyTilePenTool(const QPoint &tilePos, int id)
@@ -465,14 +614,11 @@ void TileCanvas::applyTilePenTool(const QPoint &tilePos, int id)
     requestContentPaint();
 }
 
-void TileCanvas::applyPixelLineTool(int, const QImage &lineImage, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition)
+void TileCanvas::notifyPixelLineDrawn(int, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition)
 {
     mLastPixelPenPressScenePositionF = lastPixelPenReleaseScenePosition;
-    QPainter painter(mTilesetProject->tileset()->image());
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.drawImage(lineRect, lineImage);
-    requestContentPaint();
-    mTilesetProject->tileset()->notifyImageChanged();
+    if (!lineRect.isEmpty())
+        mTilesetProject->tileset()->notifyImageChanged(lineRect);
 }
 
 void TileCanvas::updateCursorPos(const QPoint &eventPos)
@@ -571,6 +717,18 @@ void TileCanvas::setTilePenPreview(bool tilePenPreview)
     requestContentPaint();
 }
 
+void TileCanvas::requestTileUsagesPaint(int tileId)
+{
+    if (tileId == Tile::invalidId() || !mTilesetProject || !mTilesetProject->hasLoaded())
+        return;
+
+    const int tileWidth = mTilesetProject->tileWidth();
+    const int tileHeight = mTilesetProject->tileHeight();
+    const QVector<QPoint> tilePositions = mTilesetProject->tilePositionsUsingTile(tileId);
+    for (const QPoint &tilePos : tilePositions)
+        requestContentRectPaint(QRect(tilePos.x() * tileWidth, tilePos.y() * tileHeight, tileWidth, tileHeight));
+}
+
 void TileCanvas::hoverLeaveEvent(QHoverEvent *event)
 {
     ImageCanvas::hoverLeaveEvent(event);
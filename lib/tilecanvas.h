@@ -20,6 +20,7 @@
 #ifndef TILECANVAS_H
 #define TILECANVAS_H
 
+#include <QBitArray>
 #include <QObject>
 #include <QImage>
 #include <QQuickPaintedItem>
@@ -44,6 +45,8 @@ class SLATE_EXPORT TileCanvas : public ImageCanvas
     Q_PROPERTY(Mode mode READ mode WRITE setMode NOTIFY modeChanged)
     Q_PROPERTY(Tile *penTile READ penTile WRITE setPenTile NOTIFY penTileChanged)
     Q_PROPERTY(bool gridVisible READ isGridVisible WRITE setGridVisible NOTIFY gridVisibleChanged)
+    Q_PROPERTY(int highlightedTileId READ highlightedTileId WRITE setHighlightedTileId NOTIFY highlightedTileIdChanged)
+    Q_PROPERTY(QColor highlightColour READ highlightColour WRITE setHighlightColour NOTIFY highlightColourChanged)
     QML_ELEMENT
     Q_MOC_INCLUDE("tile.h")
     Q_MOC_INCLUDE("tileset.h")
@@ -74,17 +77,29 @@ public:
     bool isGridVisible() const;
     void setGridVisible(bool isGridVisible);
 
+    // The id of the tileset tile whose uses on the map are highlighted, or -1 for none.
+    int highlightedTileId() const;
+    void setHighlightedTileId(int highlightedTileId);
+
+    QColor highlightColour() const;
+    void setHighlightColour(const QColor &highlightColour);
+
     QPoint scenePosToTilePixelPos(const QPoint &scenePos) const;
     QRect sceneRectToTileRect(const QRect &sceneRect) const;
 
     QList<SubImage> subImagesInBounds(const QRect &bounds) const override;
 
+    // Pixel-level drawing on tile canvases goes into the tileset image.
+    QImage *imageForLayerAt(int layerIndex) override;
+
 signals:
     void cursorTilePixelXChanged();
     void cursorTilePixelYChanged();
     void modeChanged();
     void penTileChanged();
     void gridVisibleChanged();
+    void highlightedTileIdChanged();
+    void highlightColourChanged();
 
 public slots:
 //    void createNew(int width, int height, const QColor &penBackgroundColour);
@@ -100,6 +115,7 @@ public slots:
 
 protected slots:
     void reset() override;
+    void onTilesetImageChanged(const QRegion &changedRegion);
 
 protected:
     void connectSignals() override;
@@ -117,10 +133,30 @@ private:
     friend class ApplyTileEraserCommand;
     friend class ApplyTileFillCommand;
     friend class ApplyTileCanvasPixelFillCommand;
+    friend class ApplyPixelEraserCommand;
 
-    PixelCandidateData penEraserPixelCandidates(Tool tool) const override;
+    // The pixels under the brush that a pen or eraser would change. Pixels are
+    // stored row by row over sceneRect as raw values (see ImageUtils::rawPixel())
+    // of the image being drawn on; only those whose bit is set in mask change.
+    struct PixelBufferData
+    {
+        bool isEmpty() const { return mask.count(true) == 0; }
+        qint64 sizeInBytes() const
+        {
+            return (previousPixels.size() + newPixels.size()) * qint64(sizeof(uint)) + mask.size() / 8;
+        }
+
+        QRect sceneRect;
+        QVector<uint> previousPixels;
+        QVector<uint> newPixels;
+        QBitArray mask;
+    };
+    PixelBufferData penEraserPixelBuffer(Tool tool) const;
     PixelCandidateData fillPixelCandidates() const;
     PixelCandidateData greedyFillPixelCandidates() const;
+    typedef void (*TilePixelFillFunction)(const Tile *tile, const QPoint &pos, const QColor &targetColour,
+        const QColor &replacementColour, QVector<QPoint> &filledPositions);
+    PixelCandidateData tilePixelFillCandidates(TilePixelFillFunction fillFunction) const;
 
     struct TileCandidateData
     {
@@ -133,14 +169,21 @@ private:
     TileCandidateData fillTileCandidates() const;
 
     void applyCurrentTool() override;
+    bool canCoalesceStrokePoints() const override;
+    void applyPixelStroke(const QVector<QPointF> &points) override;
     void applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease = false) override;
+    // Writes the masked pixels of a PixelBufferData (either its previous or new pixels).
+    void applyPixelBuffer(int layerIndex, const QRect &sceneRect, const QVector<uint> &pixels, const QBitArray &mask);
+    void beginPixelPenChanges() override;
+    void endPixelPenChanges() override;
     void applyTilePenTool(const QPoint &tilePos, int id);
-    void applyPixelLineTool(int layerIndex, const QImage &lineImage, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition) override;
+    void notifyPixelLineDrawn(int layerIndex, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition) override;
 
     void updateCursorPos(const QPoint &eventPos) override;
     QColor penColour() const;
     void updateTilePenPreview();
     void setTilePenPreview(bool tilePenPreview);
+    void requestTileUsagesPaint(int tileId);
 
     void hoverLeaveEvent(QHoverEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
@@ -155,6 +198,8 @@ private:
     Tile *mPenTile;
     bool mTilePenPreview;
     bool mGridVisible;
+    int mHighlightedTileId;
+    QColor mHighlightColour;
 };
 
 #endif // TILECANVAS_H
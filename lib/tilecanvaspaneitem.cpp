@@ -20,9 +20,11 @@
 #include "tilecanvaspaneitem.h"
 
 #include "canvaspane.h"
+#include "frametimings.h"
 #include "panedrawinghelper.h"
 #include "tilecanvas.h"
 #include "tilesetproject.h"
+#include "tracer.h"
 
 #include <QPainter>
 
@@ -43,6 +45,9 @@ TileCanvasPaneItem::~TileCanvasPaneItem()
 
 void TileCanvasPaneItem::paint(QPainter *painter)
 {
+    SLATE_TRACE_SCOPE("paint", "TileCanvasPaneItem::paint");
+    const FrameTimings::ScopedStageTimer stageTimer(mCanvas->frameTimings(), FrameTimings::PaintStage);
+
     if (!mCanvas->project() || !mCanvas->project()->hasLoaded())
         return;
 
@@ -55,18 +60,23 @@ void TileCanvasPaneItem::paint(QPainter *painter)
     Q_ASSERT(tilesetProject);
 
     const QSize zoomedTileSize = mPane->zoomedSize(tilesetProject->tileSize());
-    // Try to only draw as much as could possibly fit within the pane.
-//    const int horizontalStartTile = pane.offset().x() < 0 ? qFloor(qAbs(pane.offset().x()) / zoomedTileSize.width()) : 0;
-//    const int verticalStartTile = pane.offset().y() < 0 ? qFloor(qAbs(pane.offset().y()) / zoomedTileSize.height()) : 0;
-    const int tilesAcross = tilesetProject->tilesWide();//qMin(mProject->tilesWide(), qCeil(paneWidth / zoomedTileSize.width()) + 1);
-    const int tilesDown = tilesetProject->tilesHigh();//qMin(mProject->tilesHigh(), qCeil(height() / zoomedTileSize.width()) + 1);
+    const int tilesAcross = tilesetProject->tilesWide();
+    const int tilesDown = tilesetProject->tilesHigh();
 
     // Draw the checkered pixmap that acts as an indicator for transparency.
     // We use the unbounded canvas size here, otherwise the drawn area is too small past a certain zoom level.
     painter->drawTiledPixmap(0, 0, zoomedTileSize.width() * tilesAcross, zoomedTileSize.height() * tilesDown, mCanvas->mCheckerPixmap);
 
-    for (int y = 0; y < tilesDown; ++y) {
-        for (int x = 0; x < tilesAcross; ++x) {
+    // Only draw the tiles that are within the area being repainted.
+    const QRect clipRect = painter->clipBoundingRect().toAlignedRect();
+    const int firstColumn = qBound(0, clipRect.left() / zoomedTileSize.width(), tilesAcross);
+    const int lastColumn = qBound(-1, clipRect.right() / zoomedTileSize.width(), tilesAcross - 1);
+    const int firstRow = qBound(0, clipRect.top() / zoomedTileSize.height(), tilesDown);
+    const int lastRow = qBound(-1, clipRect.bottom() / zoomedTileSize.height(), tilesDown - 1);
+
+    const QImage *tilesetImage = tilesetProject->tileset()->image();
+    for (int y = firstRow; y <= lastRow; ++y) {
+        for (int x = firstColumn; x <= lastColumn; ++x) {
             const QPoint topLeftInScene(x * tilesetProject->tileWidth(), y * tilesetProject->tileHeight());
             const QRect rect(x * zoomedTileSize.width(), y * zoomedTileSize.height(),
                 zoomedTileSize.width(), zoomedTileSize.height());
@@ -79,12 +89,12 @@ void TileCanvasPaneItem::paint(QPainter *painter)
                 previewTile = tileSceneRect.contains(tileCanvas->cursorSceneX(), tileCanvas->cursorSceneY());
             }
 
+            const int tileId = tilesetProject->tileIdAtTilePos(QPoint(x, y));
             if (previewTile) {
                 painter->drawImage(rect, *tileCanvas->mPenTile->tileset()->image(), tileCanvas->mPenTile->sourceRect());
             } else {
-                const Tile *tile = tilesetProject->tileAt(topLeftInScene);
-                if (tile) {
-                    painter->drawImage(rect, *tile->tileset()->image(), tile->sourceRect());
+                if (tileId != Tile::invalidId()) {
+                    painter->drawImage(rect, *tilesetImage, tilesetProject->tileSourceRect(tileId));
                 }
             }
 
@@ -108,6 +118,15 @@ void TileCanvasPaneItem::paint(QPainter *painter)
                         rect.x() + rect.width(), rect.y() + zoomedTileSize.width());
                 }
             }
+
+            // Outline the uses of the highlighted tile inside the cell so that the grid doesn't cover it.
+            if (tileId != Tile::invalidId() && tileId == tileCanvas->mHighlightedTileId) {
+                QPen highlightPen(tileCanvas->mHighlightColour, 2);
+                highlightPen.setJoinStyle(Qt::MiterJoin);
+                painter->setPen(highlightPen);
+                painter->setBrush(Qt::NoBrush);
+                painter->drawRect(QRectF(rect).adjusted(1, 1, -1, -1));
+            }
         }
     }
 }
@@ -20,7 +20,6 @@
 #include "tileset.h"
 
 #include <QDebug>
-#include <QPainter>
 
 #include "imageutils.h"
 
@@ -29,7 +28,8 @@ Tileset::Tileset(const QString &fileName, int tilesWide, int tilesHigh, QObject
     mFileName(fileName),
     mImage(fileName),
     mTilesWide(tilesWide),
-    mTilesHigh(tilesHigh)
+    mTilesHigh(tilesHigh),
+    mChangeBatchDepth(0)
 {
 }
 
@@ -64,25 +64,21 @@ QImage *Tileset::image()
 void Tileset::setPixelColor(int x, int y, const QColor &colour)
 {
     mImage.setPixelColor(x, y, colour);
-    emit imageChanged();
+    addChangedRegion(tileRectAt(x, y));
 }
 
 void Tileset::copy(const QPoint &sourceTopLeft, const QPoint &targetTopLeft)
 {
-    const int tileW = tileWidth();
-    const int tileH = tileWidth();
-
     if (!validTopLeft(sourceTopLeft) || !validTopLeft(targetTopLeft)) {
         return;
     }
 
-    for (int y = 0; y < tileH; ++y) {
-        for (int x = 0; x < tileW; ++x) {
-            const QColor sourceColour = mImage.pixelColor(sourceTopLeft + QPoint(x, y));
-            mImage.setPixelColor(targetTopLeft.x() + x, targetTopLeft.y() + y, sourceColour);
-        }
-    }
-    emit imageChanged();
+    if (sourceTopLeft == targetTopLeft)
+        return;
+
+    const QSize tileSize(tileWidth(), tileHeight());
+    ImageUtils::copyPixels(mImage, QRect(sourceTopLeft, tileSize), mImage, targetTopLeft);
+    addChangedRegion(QRect(targetTopLeft, tileSize));
 }
 
 void Tileset::rotateCounterClockwise(const QPoint &tileTopLeft)
@@ -105,12 +101,37 @@ int Tileset::tilesHigh() const
     return mTilesHigh;
 }
 
+/*!
+    Starts a batch of changes to the image. Until the matching
+    commitChanges() call, changes are accumulated rather than causing
+    imageChanged() to be emitted for each one, which would otherwise
+    repaint everything that shows the tileset for every single pixel.
+
+    Batches can be nested; only the outermost commitChanges() call emits.
+*/
+void Tileset::beginChanges()
+{
+    ++mChangeBatchDepth;
+}
+
+void Tileset::commitChanges()
+{
+    Q_ASSERT(mChangeBatchDepth > 0);
+    if (--mChangeBatchDepth > 0 || mChangedRegion.isEmpty())
+        return;
+
+    const QRegion changedRegion = mChangedRegion;
+    mChangedRegion = QRegion();
+    emit imageChanged(changedRegion);
+}
+
 // It's easier to just allow calling code to modify the tileset image through
 // the pointer (e.g. by painting with QPainter) and then call this than force
-// them to use setPixelColour().
-void Tileset::notifyImageChanged()
+// them to use setPixelColour(). If changedRegion is empty, the whole image
+// is assumed to have changed.
+void Tileset::notifyImageChanged(const QRegion &changedRegion)
 {
-    emit imageChanged();
+    addChangedRegion(changedRegion.isEmpty() ? QRegion(mImage.rect()) : changedRegion);
 }
 
 // TODO: this information could be set by the project
@@ -124,6 +145,13 @@ int Tileset::tileHeight() const
     return mImage.height() / mTilesHigh;
 }
 
+QRect Tileset::tileRectAt(int x, int y) const
+{
+    const int tileW = tileWidth();
+    const int tileH = tileHeight();
+    return QRect(x - x % tileW, y - y % tileH, tileW, tileH);
+}
+
 bool Tileset::validTopLeft(const QPoint &topLeft) const
 {
     const QRect imageRect(0, 0, mImage.width(), mImage.height());
@@ -148,15 +176,23 @@ void Tileset::rotate(const QPoint &tileTopLeft, int angle)
         return;
     }
 
-    const QImage tileImage = mImage.copy(tileTopLeft.x(), tileTopLeft.y(), tileWidth(), tileHeight());
-    const QImage rotatedImage = ImageUtils::rotate(tileImage, angle);
-    QPainter painter(&mImage);
-    // Make sure that we clear the previous tile image before painting on the newly rotated one.
-    for (int y = 0; y < tileImage.height(); ++y) {
-        for (int x = 0; x < tileImage.width(); ++x) {
-            mImage.setPixelColor(tileTopLeft.x() + x, tileTopLeft.y() + y, Qt::transparent);
-        }
+    const QRect tileRect(tileTopLeft, QSize(tileWidth(), tileHeight()));
+    const QImage rotatedImage = ImageUtils::rotate(mImage.copy(tileRect), angle);
+    // Non-square tiles aren't completely covered by their rotated image,
+    // so make sure that we clear the previous tile image first.
+    if (rotatedImage.size() != tileRect.size())
+        ImageUtils::erasePixels(mImage, tileRect);
+    // Don't let the rotated image spill over into neighbouring tiles.
+    ImageUtils::copyPixels(rotatedImage, QRect(QPoint(0, 0), tileRect.size()), mImage, tileTopLeft);
+    addChangedRegion(tileRect);
+}
+
+void Tileset::addChangedRegion(const QRegion &changedRegion)
+{
+    if (mChangeBatchDepth > 0) {
+        mChangedRegion += changedRegion;
+        return;
     }
-    painter.drawImage(tileTopLeft, rotatedImage);
-    emit imageChanged();
+
+    emit imageChanged(changedRegion);
 }
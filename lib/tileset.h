@@ -23,6 +23,7 @@
 #include <QObject>
 #include <QString>
 #include <QImage>
+#include <QRegion>
 
 #include "slate-global.h"
 
@@ -47,24 +48,34 @@ public:
     int tilesWide() const;
     int tilesHigh() const;
 
-    void notifyImageChanged();
+    void beginChanges();
+    void commitChanges();
+    void notifyImageChanged(const QRegion &changedRegion = QRegion());
 
 public slots:
 
 signals:
-    void imageChanged();
+    // changedRegion is in tileset image coordinates, and covers
+    // (at least) every tile that had pixels changed.
+    void imageChanged(const QRegion &changedRegion);
 
 private:
     int tileWidth() const;
     int tileHeight() const;
+    QRect tileRectAt(int x, int y) const;
     bool validTopLeft(const QPoint &topLeft) const;
 
     void rotate(const QPoint &tileTopLeft, int angle);
+    void addChangedRegion(const QRegion &changedRegion);
 
     QString mFileName;
     QImage mImage;
     int mTilesWide;
     int mTilesHigh;
+    // The number of beginChanges() calls that haven't been committed yet.
+    int mChangeBatchDepth;
+    // The area that has changed since the outermost beginChanges() call.
+    QRegion mChangedRegion;
 };
 
 #endif // TILESET_H
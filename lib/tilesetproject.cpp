@@ -28,8 +28,13 @@
 #include <QLoggingCategory>
 #include <QUndoStack>
 
+#include <limits>
+
+#include "applicationsettings.h"
 #include "changetilecanvassizecommand.h"
+#include "imageutils.h"
 #include "jsonutils.h"
+#include "replacetilecommand.h"
 
 TilesetProject::TilesetProject() :
     mTilesWide(0),
@@ -56,17 +61,24 @@ Project::Type TilesetProject::type() const
 void TilesetProject::createTilesetTiles(int tilesetTilesWide, int tilesetTilesHigh)
 {
     Q_ASSERT(mTileDatabase.isEmpty());
-    for (int row = 0; row < tilesetTilesHigh; ++row) {
-        for (int column = 0; column < tilesetTilesWide; ++column) {
-            const int x = column * mTileWidth;
-            const int y = row * mTileHeight;
-            const int tileId = tileIdFromPosInTileset(x, y);
-            mTileDatabase.insert(tileId, new Tile(tileId, mTileset, QRect(x, y, mTileWidth, mTileHeight), this));
-        }
-    }
+    // The Tile objects themselves are only created when something asks for them (see tileForId()).
+    mTileDatabase.fill(nullptr, tilesetTilesWide * tilesetTilesHigh);
     Q_ASSERT(!mTileDatabase.isEmpty());
 }
 
+Tile *TilesetProject::tileForId(int tileId) const
+{
+    if (!isValidTileId(tileId))
+        return nullptr;
+
+    Tile *&tile = mTileDatabase[tileId - 1];
+    if (!tile) {
+        tile = new Tile(tileId, mTileset, tileSourceRect(tileId),
+            const_cast<TilesetProject*>(this));
+    }
+    return tile;
+}
+
 void TilesetProject::createNew(QUrl tilesetUrl, int tileWidth, int tileHeight,
     int tilesetTilesWide, int tilesetTilesHigh,
     int canvasTilesWide, int canvasTilesHigh, bool transparentBackground)
@@ -122,6 +134,7 @@ void TilesetProject::createNew(QUrl tilesetUrl, int tileWidth, int tileHeight,
 
     mTiles.clear();
     mTiles.fill(-1, mTilesWide * mTilesHigh);
+    rebuildTileUsages();
 
     setUrl(QUrl());
     setNewProject(true);
@@ -130,6 +143,110 @@ void TilesetProject::createNew(QUrl tilesetUrl, int tileWidth, int tileHeight,
     qCDebug(lcProject) << "finished creating new project";
 }
 
+/*!
+    Creates a new project from the image at \a imageUrl (e.g. a finished level)
+    by splitting it into tiles of \a tileWidth by \a tileHeight pixels.
+    Tiles that appear more than once in the image are only added to the
+    tileset once, and the project's tiles are set to match the image.
+*/
+void TilesetProject::createFromImage(const QUrl &imageUrl, int tileWidth, int tileHeight)
+{
+    const QImage image(imageUrl.toLocalFile());
+    if (image.isNull()) {
+        error(QString::fromLatin1("Failed to open image at %1").arg(imageUrl.toLocalFile()));
+        return;
+    }
+
+    if (tileWidth <= 0 || tileHeight <= 0
+            || image.width() % tileWidth != 0 || image.height() % tileHeight != 0) {
+        error(QString::fromLatin1("The size of the image (%1x%2 pixels) is not a multiple of the tile size (%3x%4 pixels)")
+            .arg(image.width()).arg(image.height()).arg(tileWidth).arg(tileHeight));
+        return;
+    }
+
+    // Close now rather than in createNew(), as that would forget that the tileset is a temporary image.
+    if (hasLoaded()) {
+        close();
+    }
+
+    const ImageUtils::ExtractedTiles extractedTiles = ImageUtils::extractTiles(image, QSize(tileWidth, tileHeight));
+    const QUrl tilesetUrl = createTemporaryImage(extractedTiles.tilesetImage);
+    if (!tilesetUrl.isValid())
+        return;
+
+    createNew(tilesetUrl, tileWidth, tileHeight, extractedTiles.tilesetTilesWide, extractedTiles.tilesetTilesHigh,
+        image.width() / tileWidth, image.height() / tileHeight, false);
+    if (!mTileset)
+        return;
+
+    // The unique tiles are laid out in order, and IDs are one-based.
+    Q_ASSERT(mTiles.size() == extractedTiles.tileIndices.size());
+    for (int i = 0; i < mTiles.size(); ++i)
+        mTiles[i] = extractedTiles.tileIndices.at(i) + 1;
+    rebuildTileUsages();
+}
+
+static void appendVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+static bool readVarint(const QByteArray &data, int &position, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 32 && position < data.size(); shift += 7) {
+        const quint8 byte = quint8(data.at(position++));
+        value |= quint32(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Packs tile ids into runs of identical ids. Each run is written as two
+// unsigned LEB128 varints: the length of the run, followed by the id plus one
+// (so that -1, which is used for cells without a tile, is written as 0).
+// Maps tend to have large areas of the same tile, so this is much smaller
+// (and much quicker to read and write) than a JSON array with a value per cell.
+static QByteArray packTiles(const QVector<int> &tiles)
+{
+    QByteArray packedTiles;
+    for (int i = 0; i < tiles.size(); ) {
+        const int tileId = tiles.at(i);
+        int runEnd = i + 1;
+        while (runEnd < tiles.size() && tiles.at(runEnd) == tileId)
+            ++runEnd;
+
+        appendVarint(packedTiles, quint32(runEnd - i));
+        appendVarint(packedTiles, quint32(tileId + 1));
+        i = runEnd;
+    }
+    return packedTiles;
+}
+
+static bool unpackTiles(const QByteArray &packedTiles, int tileCount, QVector<int> &tiles)
+{
+    tiles.clear();
+    tiles.reserve(tileCount);
+    int position = 0;
+    while (position < packedTiles.size()) {
+        quint32 runLength = 0;
+        quint32 packedTileId = 0;
+        if (!readVarint(packedTiles, position, runLength) || !readVarint(packedTiles, position, packedTileId))
+            return false;
+
+        if (runLength == 0 || runLength > quint32(tileCount - tiles.size()) || packedTileId > quint32(std::numeric_limits<int>::max()))
+            return false;
+
+        tiles.insert(tiles.size(), int(runLength), int(packedTileId) - 1);
+    }
+    return tiles.size() == tileCount;
+}
+
 #define CONTAINS_KEY_OR_ERROR(jsonObject, key, filePath) \
     if (!(jsonObject).contains(key)) { \
         error(QString::fromLatin1("Tileset project file is missing a \"%1\" key:\n\n%2").arg(key, filePath)); \
@@ -194,16 +311,31 @@ void TilesetProject::doLoad(const QUrl &url)
     mTileDatabase.clear();
     createTilesetTiles(tilesetTilesWide, tilesetTilesHigh);
 
-    QJsonArray tileArray = projectObject["tiles"].toArray();
-    mTiles.resize(tileArray.size());
-    for (int i = 0; i < tileArray.size(); ++i) {
-        int tileId = tileArray.at(i).toInt(-2);
-        Q_ASSERT(tileId != -2);
-        mTiles[i] = tileId;
-        if (tileId > -1) {
-            Q_ASSERT(mTileDatabase.contains(tileId));
+    if (projectObject.contains("packedTiles")) {
+        const QByteArray packedTiles = QByteArray::fromBase64(projectObject.value("packedTiles").toString().toLatin1());
+        if (!unpackTiles(packedTiles, mTilesWide * mTilesHigh, mTiles)) {
+            error(QString::fromLatin1("Tileset project file has invalid tile data:\n\n%1").arg(url.toLocalFile()));
+            return;
+        }
+        for (const int tileId : qAsConst(mTiles)) {
+            if (tileId > -1) {
+                Q_ASSERT(isValidTileId(tileId));
+            }
+        }
+    } else {
+        // Projects saved without packedTiles enabled (or before it was introduced).
+        QJsonArray tileArray = projectObject["tiles"].toArray();
+        mTiles.resize(tileArray.size());
+        for (int i = 0; i < tileArray.size(); ++i) {
+            int tileId = tileArray.at(i).toInt(-2);
+            Q_ASSERT(tileId != -2);
+            mTiles[i] = tileId;
+            if (tileId > -1) {
+                Q_ASSERT(isValidTileId(tileId));
+            }
         }
     }
+    rebuildTileUsages();
 
     readGuides(projectObject);
     readNotes(projectObject);
@@ -298,11 +430,16 @@ bool TilesetProject::doSaveAs(const QUrl &url)
     tilesetObject["tilesHigh"] = mTileset->tilesHigh();
     projectObject.insert("tileset", tilesetObject);
 
-    QJsonArray tileArray;
-    foreach (int tile, mTiles) {
-        tileArray.append(QJsonValue(tile));
+    if (settings() && settings()->isPackedTilesEnabled()) {
+        // Opt-in, since older versions can't read it.
+        projectObject.insert("packedTiles", QString::fromLatin1(packTiles(mTiles).toBase64()));
+    } else {
+        QJsonArray tileArray;
+        foreach (int tile, mTiles) {
+            tileArray.append(QJsonValue(tile));
+        }
+        projectObject.insert("tiles", tileArray);
     }
-    projectObject.insert("tiles", tileArray);
 
     writeGuides(projectObject);
     writeNotes(projectObject);
@@ -416,6 +553,7 @@ void TilesetProject::changeSize(const QSize &newSize, const QVector<int> &tiles)
     } else {
         mTiles = tiles;
     }
+    rebuildTileUsages();
 
     setTilesWide(newSize.width());
     setTilesHigh(newSize.height());
@@ -514,7 +652,7 @@ QRect TilesetProject::bounds() const
     return QRect(0, 0, mTilesWide, mTilesHigh);
 }
 
-QImage TilesetProject::exportedImage() const
+QImage TilesetProject::createExportedImage() const
 {
     // Although other projects would return what's visible on the canvas,
     // tileset projects are a bit different in that the tileset is what's being
@@ -558,20 +696,40 @@ Tile *TilesetProject::tileAt(const QPoint &scenePos)
 }
 
 const Tile *TilesetProject::tileAt(const QPoint &scenePos) const
+{
+    return tileForId(tileIdAt(scenePos));
+}
+
+int TilesetProject::tileIdAt(const QPoint &scenePos) const
 {
     if (scenePos.x() < 0 || scenePos.x() >= widthInPixels()
         || scenePos.y() < 0 || scenePos.y() >= heightInPixels()) {
-        return nullptr;
+        return Tile::invalidId();
     }
 
     const int xTile = scenePos.x() / mTileWidth;
     const int yTile = scenePos.y() / mTileHeight;
     const int tileIndex = yTile * mTilesWide + xTile;
     if (tileIndex >= mTiles.size())
-        return nullptr;
+        return Tile::invalidId();
 
     const int tileId = mTiles[tileIndex];
-    return tileId != -1 ? mTileDatabase.value(tileId) : nullptr;
+    return isValidTileId(tileId) ? tileId : Tile::invalidId();
+}
+
+bool TilesetProject::isValidTileId(int tileId) const
+{
+    // IDs are one-based.
+    return tileId >= 1 && tileId <= mTileDatabase.size();
+}
+
+QRect TilesetProject::tileSourceRect(int tileId) const
+{
+    if (!isValidTileId(tileId))
+        return QRect();
+
+    const QPoint tilePosInTileset = tileIdToTilePos(tileId);
+    return QRect(tilePosInTileset.x() * mTileWidth, tilePosInTileset.y() * mTileHeight, mTileWidth, mTileHeight);
 }
 
 bool TilesetProject::isTilePosWithinBounds(const QPoint &tilePos) const
@@ -598,7 +756,7 @@ void TilesetProject::setTileAtPixelPos(const QPoint &tilePos, int id)
 
     const int tileIndex = tilePos.y() * mTilesWide + tilePos.x();
     Q_ASSERT(tileIndex < mTiles.size());
-    mTiles[tileIndex] = id;
+    setTileAtIndex(tileIndex, id);
     qCDebug(lcProject) << "set tile at tile pos" << tilePos << "and index" << tileIndex << "to id" << id;
 }
 
@@ -607,22 +765,58 @@ QVector<int> TilesetProject::tiles() const
     return mTiles;
 }
 
+/*!
+    Returns the positions (in tiles) of every place in the map where
+    the tile with \a tileId is used.
+
+    This only visits the uses of the tile, not the whole map.
+*/
+QVector<QPoint> TilesetProject::tilePositionsUsingTile(int tileId) const
+{
+    QVector<QPoint> tilePositions;
+    const auto usagesIt = mTileUsages.constFind(tileId);
+    if (usagesIt == mTileUsages.constEnd())
+        return tilePositions;
+
+    tilePositions.reserve(usagesIt->size());
+    for (const int tileIndex : *usagesIt)
+        tilePositions.append(QPoint(tileIndex % mTilesWide, tileIndex / mTilesWide));
+    return tilePositions;
+}
+
+/*!
+    Replaces every use of the tile with \a tileId in the map
+    with the tile with \a replacementTileId.
+
+    This is done as one undoable change.
+*/
+void TilesetProject::replaceTile(int tileId, int replacementTileId)
+{
+    if (tileId == replacementTileId)
+        return;
+
+    const QVector<int> tileIndices = mTileUsages.value(tileId);
+    if (tileIndices.isEmpty())
+        return;
+
+    addChange(new ReplaceTileCommand(this, tileId, replacementTileId, tileIndices));
+}
+
 const Tile *TilesetProject::tileAtTilePos(const QPoint &tilePos) const
+{
+    return tileForId(tileIdAtTilePos(tilePos));
+}
+
+int TilesetProject::tileIdAtTilePos(const QPoint &tilePos) const
 {
     if (warnIfTilePosInvalid(tilePos)) {
-        return nullptr;
+        return Tile::invalidId();
     }
 
     const int tileIndex = tilePos.y() * mTilesWide + tilePos.x();
     Q_ASSERT(tileIndex < mTiles.size());
     const int tileId = mTiles[tileIndex];
-    return tileId != -1 ? mTileDatabase.value(tileId) : nullptr;
-}
-
-int TilesetProject::tileIdAtTilePos(const QPoint &tilePos) const
-{
-    const Tile *tile = tileAtTilePos(tilePos);
-    return tile ? tile->id() : Tile::invalidId();
+    return isValidTileId(tileId) ? tileId : Tile::invalidId();
 }
 
 Tile *TilesetProject::tilesetTileAt(int xInPixels, int yInPixels)
@@ -638,7 +832,7 @@ Tile *TilesetProject::tilesetTileAt(int xInPixels, int yInPixels)
         return nullptr;
     }
 
-    return mTileDatabase.value(tileIdFromPosInTileset(xInPixels, yInPixels));
+    return tileForId(tileIdFromPosInTileset(xInPixels, yInPixels));
 }
 
 Tile *TilesetProject::tilesetTileAtTilePos(const QPoint &tilePos) const
@@ -654,7 +848,7 @@ Tile *TilesetProject::tilesetTileAtTilePos(const QPoint &tilePos) const
         return nullptr;
     }
 
-    return mTileDatabase.value(tileIdFromTilePosInTileset(tilePos.x(), tilePos.y()));
+    return tileForId(tileIdFromTilePosInTileset(tilePos.x(), tilePos.y()));
 }
 
 Tile *TilesetProject::tilesetTileAtId(int id)
@@ -664,11 +858,7 @@ Tile *TilesetProject::tilesetTileAtId(int id)
         return nullptr;
     }
 
-    QHash<int, Tile*>::iterator it = mTileDatabase.find(id);
-    if (it == mTileDatabase.end())
-        return nullptr;
-
-    return it.value();
+    return tileForId(id);
 }
 
 void TilesetProject::duplicateTile(Tile *sourceTile, int xInPixels, int yInPixels)
@@ -728,6 +918,65 @@ void TilesetProject::clearTiles()
     if (mTiles.isEmpty())
         return;
 
-    mTiles.fill(mTiles.size(), -1);
+    mTiles.fill(Tile::invalidId());
+    rebuildTileUsages();
     emit tilesCleared();
 }
+
+void TilesetProject::rebuildTileUsages()
+{
+    mTileUsages.clear();
+    mTileUsageSlots.fill(-1, mTiles.size());
+    for (int tileIndex = 0; tileIndex < mTiles.size(); ++tileIndex)
+        addTileUsage(tileIndex, mTiles.at(tileIndex));
+}
+
+void TilesetProject::addTileUsage(int tileIndex, int id)
+{
+    if (id == Tile::invalidId()) {
+        mTileUsageSlots[tileIndex] = -1;
+        return;
+    }
+
+    QVector<int> &usages = mTileUsages[id];
+    mTileUsageSlots[tileIndex] = usages.size();
+    usages.append(tileIndex);
+}
+
+void TilesetProject::removeTileUsage(int tileIndex, int id)
+{
+    auto usagesIt = mTileUsages.find(id);
+    if (usagesIt == mTileUsages.end())
+        return;
+
+    // Move the last use into the slot of the one being removed.
+    QVector<int> &usages = *usagesIt;
+    const int slot = mTileUsageSlots.at(tileIndex);
+    Q_ASSERT(usages.at(slot) == tileIndex);
+    const int lastTileIndex = usages.last();
+    usages[slot] = lastTileIndex;
+    mTileUsageSlots[lastTileIndex] = slot;
+    usages.removeLast();
+    mTileUsageSlots[tileIndex] = -1;
+    if (usages.isEmpty())
+        mTileUsages.erase(usagesIt);
+}
+
+void TilesetProject::setTileAtIndex(int tileIndex, int id)
+{
+    const int previousId = mTiles.at(tileIndex);
+    if (id == previousId)
+        return;
+
+    removeTileUsage(tileIndex, previousId);
+    mTiles[tileIndex] = id;
+    addTileUsage(tileIndex, id);
+}
+
+void TilesetProject::setTilesAtIndices(const QVector<int> &tileIndices, int id)
+{
+    for (const int tileIndex : tileIndices)
+        setTileAtIndex(tileIndex, id);
+    qCDebug(lcProject) << "set" << tileIndices.size() << "tiles to" << id;
+    emit tilesChanged();
+}
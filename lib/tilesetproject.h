@@ -61,13 +61,15 @@ public:
     int heightInPixels() const override;
     QRect bounds() const override;
 
-    QImage exportedImage() const override;
-
     QUrl tilesetUrl() const;
     Tileset *tileset() const;
 
     Tile *tileAt(const QPoint &scenePos);
     const Tile *tileAt(const QPoint &scenePos) const;
+    // These avoid creating Tile objects, and are preferable in hot paths like painting.
+    int tileIdAt(const QPoint &scenePos) const;
+    bool isValidTileId(int tileId) const;
+    QRect tileSourceRect(int tileId) const;
     // TODO: tileChanged signal that canvas connnects to repaint
     void setTileAtPixelPos(const QPoint &tilePos, int id);
     QVector<int> tiles() const;
@@ -81,6 +83,9 @@ public:
     Q_INVOKABLE void rotateTileCounterClockwise(Tile *tile);
     Q_INVOKABLE void rotateTileClockwise(Tile *tile);
 
+    Q_INVOKABLE QVector<QPoint> tilePositionsUsingTile(int tileId) const;
+    void replaceTile(int tileId, int replacementTileId);
+
     QPoint tileIdToTilePos(int tileId) const;
     Tile *tilesetTileAtTilePos(const QPoint &tilePos) const;
     Tile *tilesetTileAtId(int id);
@@ -96,20 +101,25 @@ signals:
     void tilesetUrlChanged();
     void tilesetChanged(Tileset *oldTileset, Tileset *newTileset);
     void tilesCleared();
+    // Emitted when the tiles at several positions change at once, e.g. by replaceTile().
+    void tilesChanged();
 
 public slots:
     void createNew(QUrl tilesetUrl, int tileWidth, int tileHeight,
         int tilesetTilesWide, int tilesetTilesHigh,
         int canvasTilesWide, int canvasTilesHigh,
         bool transparentBackground);
+    void createFromImage(const QUrl &imageUrl, int tileWidth, int tileHeight);
 
 protected:
     void doLoad(const QUrl &url) override;
     void doClose() override;
     bool doSaveAs(const QUrl &url) override;
+    QImage createExportedImage() const override;
 
 private:
     friend class ChangeTileCanvasSizeCommand;
+    friend class ReplaceTileCommand;
 
     int tileIdFromPosInTileset(int x, int y) const;
     int tileIdFromTilePosInTileset(int column, int row) const;
@@ -117,11 +127,17 @@ private:
     bool warnIfTilePosInvalid(const QPoint &tilePos) const;
 
     void createTilesetTiles(int tilesetTilesWide, int tilesetTilesHigh);
+    Tile *tileForId(int tileId) const;
     void setTileWidth(int tileWidth);
     void setTileHeight(int tileHeight);
     void setTilesetUrl(const QUrl &tilesetUrl);
     void setTileset(Tileset *tileset);
     void changeSize(const QSize &size, const QVector<int> &tiles = QVector<int>());
+    void rebuildTileUsages();
+    void addTileUsage(int tileIndex, int id);
+    void removeTileUsage(int tileIndex, int id);
+    void setTileAtIndex(int tileIndex, int id);
+    void setTilesAtIndices(const QVector<int> &tileIndices, int id);
 
     int mTilesWide;
     int mTilesHigh;
@@ -129,7 +145,17 @@ private:
     int mTileHeight;
     QUrl mTilesetUrl;
     QVector<int> mTiles;
-    QHash<int, Tile*> mTileDatabase;
+    // The indices into mTiles at which each (valid) tile id is used, in no
+    // particular order, so that e.g. finding every use of a tile doesn't
+    // require scanning the map.
+    QHash<int, QVector<int>> mTileUsages;
+    // For each index into mTiles, its position within the mTileUsages entry
+    // for its tile id (or -1 if it has no tile), so that it can be removed
+    // from there without searching.
+    QVector<int> mTileUsageSlots;
+    // Indexed by tile id - 1. Entries are null until the Tile is first needed
+    // (e.g. by QML), as most code only needs the id and source rect.
+    mutable QVector<Tile*> mTileDatabase;
     Tileset* mTileset;
 };
 
@@ -39,14 +39,14 @@ void TilesetSwatchImage::setTileset(Tileset *tileset)
         return;
 
     if (mTileset) {
-        disconnect(mTileset, SIGNAL(imageChanged()), this, SIGNAL(update()));
+        disconnect(mTileset, &Tileset::imageChanged, this, &TilesetSwatchImage::onImageChanged);
         setSourceRect(QRect());
     }
 
     mTileset = tileset;
 
     if (tileset) {
-        connect(mTileset, SIGNAL(imageChanged()), this, SLOT(update()));
+        connect(mTileset, &Tileset::imageChanged, this, &TilesetSwatchImage::onImageChanged);
 
         const QSize imageSize = tileset->image()->size();
         setImplicitSize(imageSize.width(), imageSize.height());
@@ -80,3 +80,13 @@ void TilesetSwatchImage::paint(QPainter *painter)
             mSourceRect.x(), mSourceRect.y(), mSourceRect.width(), mSourceRect.height());
     }
 }
+
+void TilesetSwatchImage::onImageChanged(const QRegion &changedRegion)
+{
+    // Only repaint the part of the tileset that we show, if any.
+    const QRect changedSourceRect = changedRegion.boundingRect().intersected(mSourceRect);
+    if (changedSourceRect.isEmpty())
+        return;
+
+    update(changedSourceRect.translated(-mSourceRect.topLeft()));
+}
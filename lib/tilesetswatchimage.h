@@ -49,6 +49,9 @@ signals:
     void tilesetChanged();
     void sourceRectChanged();
 
+private slots:
+    void onImageChanged(const QRegion &changedRegion);
+
 private:
     Tileset *mTileset;
     QRect mSourceRect;
@@ -0,0 +1,223 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tracer.h"
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+Q_LOGGING_CATEGORY(lcTracer, "app.tracer")
+
+// Around 32 MB worth of events; enough for several minutes of heavy use.
+static const int maxEventCount = 1000000;
+
+QBasicAtomicInt Tracer::sEnabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+Q_GLOBAL_STATIC(Tracer, tracerInstance)
+
+Tracer::Tracer()
+{
+    mTimer.start();
+}
+
+Tracer::~Tracer()
+{
+}
+
+Tracer *Tracer::instance()
+{
+    return tracerInstance();
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    if (enabled == isEnabled())
+        return;
+
+    qCDebug(lcTracer) << "setting enabled to" << enabled;
+
+    if (enabled) {
+        QMutexLocker locker(&mMutex);
+        // Don't overwrite the previous recording if there's no explicit path.
+        mRecordingFilePath = mFilePath.isEmpty() ? generateRecordingFilePath() : mFilePath;
+        qCDebug(lcTracer) << "recording to" << mRecordingFilePath;
+        sEnabled.storeRelaxed(1);
+    } else {
+        sEnabled.storeRelaxed(0);
+        write();
+    }
+}
+
+QString Tracer::filePath() const
+{
+    QMutexLocker locker(&mMutex);
+    return mFilePath;
+}
+
+void Tracer::setFilePath(const QString &filePath)
+{
+    QMutexLocker locker(&mMutex);
+    mFilePath = filePath;
+    if (isEnabled() && !mFilePath.isEmpty())
+        mRecordingFilePath = mFilePath;
+}
+
+QString Tracer::recordingFilePath() const
+{
+    QMutexLocker locker(&mMutex);
+    return mRecordingFilePath;
+}
+
+qint64 Tracer::elapsedMicroseconds() const
+{
+    return mTimer.nsecsElapsed() / 1000;
+}
+
+void Tracer::addCompleteEvent(const char *category, const char *name, qint64 startMicroseconds, qint64 durationMicroseconds)
+{
+    QMutexLocker locker(&mMutex);
+    if (mEvents.size() >= maxEventCount) {
+        ++mDroppedEventCount;
+        return;
+    }
+
+    Event event;
+    event.category = category;
+    event.name = name;
+    event.start = startMicroseconds;
+    event.duration = durationMicroseconds;
+    event.threadId = threadIdForCurrentThread();
+    mEvents.append(event);
+}
+
+bool Tracer::write()
+{
+    QVector<Event> events;
+    QHash<Qt::HANDLE, int> threadIds;
+    QString filePath;
+    int droppedEventCount = 0;
+    {
+        QMutexLocker locker(&mMutex);
+        events.swap(mEvents);
+        threadIds = mThreadIds;
+        filePath = mRecordingFilePath;
+        droppedEventCount = mDroppedEventCount;
+        mDroppedEventCount = 0;
+    }
+
+    if (events.isEmpty())
+        return true;
+
+    const qint64 processId = QCoreApplication::applicationPid();
+
+    QJsonArray traceEvents;
+    for (const Event &event : qAsConst(events)) {
+        QJsonObject eventObject;
+        eventObject.insert(QLatin1String("name"), QLatin1String(event.name));
+        eventObject.insert(QLatin1String("cat"), QLatin1String(event.category));
+        // "X" is a complete event, i.e. one with a duration.
+        eventObject.insert(QLatin1String("ph"), QLatin1String("X"));
+        eventObject.insert(QLatin1String("ts"), event.start);
+        eventObject.insert(QLatin1String("dur"), event.duration);
+        eventObject.insert(QLatin1String("pid"), processId);
+        eventObject.insert(QLatin1String("tid"), event.threadId);
+        traceEvents.append(eventObject);
+    }
+
+    // Name the threads so that they're easier to tell apart in the viewer.
+    for (auto it = threadIds.constBegin(); it != threadIds.constEnd(); ++it) {
+        QJsonObject argsObject;
+        argsObject.insert(QLatin1String("name"), it.value() == 0
+            ? QString::fromLatin1("GUI thread") : QString::fromLatin1("Thread %1").arg(it.value()));
+
+        QJsonObject metadataObject;
+        metadataObject.insert(QLatin1String("name"), QLatin1String("thread_name"));
+        metadataObject.insert(QLatin1String("ph"), QLatin1String("M"));
+        metadataObject.insert(QLatin1String("pid"), processId);
+        metadataObject.insert(QLatin1String("tid"), it.value());
+        metadataObject.insert(QLatin1String("args"), argsObject);
+        traceEvents.append(metadataObject);
+    }
+
+    QJsonObject rootObject;
+    rootObject.insert(QLatin1String("traceEvents"), traceEvents);
+    rootObject.insert(QLatin1String("displayTimeUnit"), QLatin1String("ms"));
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open trace file" << filePath << "for writing:" << file.errorString();
+        return false;
+    }
+
+    file.write(QJsonDocument(rootObject).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "Failed to write trace file" << filePath << ":" << file.errorString();
+        return false;
+    }
+
+    if (droppedEventCount > 0)
+        qWarning() << "Dropped" << droppedEventCount << "trace events because the buffer was full";
+    qInfo() << "Wrote" << events.size() << "trace events to" << filePath;
+    return true;
+}
+
+// Thread handles can't be represented exactly in JSON, so we give each
+// thread a small ID instead. The GUI thread is always 0.
+// Must be called with mMutex locked.
+int Tracer::threadIdForCurrentThread()
+{
+    const Qt::HANDLE threadHandle = QThread::currentThreadId();
+    auto it = mThreadIds.constFind(threadHandle);
+    if (it != mThreadIds.constEnd())
+        return it.value();
+
+    const bool isGuiThread = QCoreApplication::instance()
+        && QThread::currentThread() == QCoreApplication::instance()->thread();
+    int threadId = isGuiThread ? 0 : mThreadIds.size() + 1;
+    if (!isGuiThread) {
+        // Avoid clashing with the IDs of threads that we've already seen.
+        while (std::find(mThreadIds.cbegin(), mThreadIds.cend(), threadId) != mThreadIds.cend())
+            ++threadId;
+    }
+    mThreadIds.insert(threadHandle, threadId);
+    return threadId;
+}
+
+QString Tracer::generateRecordingFilePath()
+{
+    const QDir tempDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation));
+    const QString baseName = QString::fromLatin1("slate-trace-%1")
+        .arg(QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd-hhmmss")));
+    QString filePath = tempDir.filePath(baseName + QLatin1String(".json"));
+    // Recordings that are started within the same second would otherwise share a file.
+    for (int i = 2; QFile::exists(filePath); ++i)
+        filePath = tempDir.filePath(QString::fromLatin1("%1-%2.json").arg(baseName).arg(i));
+    return filePath;
+}
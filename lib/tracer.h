@@ -0,0 +1,135 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "slate-global.h"
+
+/*
+    Records timed spans of work and writes them out as a trace file in the
+    Chrome trace event format, which can be opened with chrome://tracing or
+    https://ui.perfetto.dev.
+
+    Tracing is off by default, in which case SLATE_TRACE_SCOPE costs one
+    relaxed atomic load. It can be turned on at startup by setting the
+    SLATE_TRACE_FILE environment variable to the path of the file to write,
+    or at runtime through the options dialog. The trace file is written when
+    tracing is disabled (which includes when the application exits).
+*/
+class SLATE_EXPORT Tracer
+{
+public:
+    Tracer();
+    ~Tracer();
+
+    static Tracer *instance();
+
+    static inline bool isEnabled()
+    {
+        return sEnabled.loadRelaxed() != 0;
+    }
+
+    void setEnabled(bool enabled);
+
+    // The path of the file that traces will be written to. If empty when
+    // tracing is enabled, each recording gets its own time-stamped file in
+    // the temporary directory.
+    QString filePath() const;
+    void setFilePath(const QString &filePath);
+
+    // The file that the current (or most recent) recording is written to.
+    QString recordingFilePath() const;
+
+    qint64 elapsedMicroseconds() const;
+
+    // category and name must be string literals (or otherwise outlive the tracer).
+    void addCompleteEvent(const char *category, const char *name, qint64 startMicroseconds, qint64 durationMicroseconds);
+
+    // Writes all events recorded so far to filePath() and clears them.
+    bool write();
+
+private:
+    struct Event
+    {
+        const char *category = nullptr;
+        const char *name = nullptr;
+        qint64 start = 0;
+        qint64 duration = 0;
+        int threadId = 0;
+    };
+
+    int threadIdForCurrentThread();
+    static QString generateRecordingFilePath();
+
+    static QBasicAtomicInt sEnabled;
+
+    mutable QMutex mMutex;
+    QElapsedTimer mTimer;
+    QString mFilePath;
+    QString mRecordingFilePath;
+    QVector<Event> mEvents;
+    QHash<Qt::HANDLE, int> mThreadIds;
+    int mDroppedEventCount = 0;
+};
+
+/*
+    Records the time between its construction and destruction as a span
+    in the trace. Use it via SLATE_TRACE_SCOPE.
+*/
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const char *name) :
+        mCategory(category),
+        mName(name),
+        mStart(Tracer::isEnabled() ? Tracer::instance()->elapsedMicroseconds() : -1)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (mStart == -1)
+            return;
+
+        Tracer *tracer = Tracer::instance();
+        tracer->addCompleteEvent(mCategory, mName, mStart, tracer->elapsedMicroseconds() - mStart);
+    }
+
+    Q_DISABLE_COPY(TraceSpan)
+
+private:
+    const char *mCategory;
+    const char *mName;
+    qint64 mStart;
+};
+
+#define SLATE_TRACE_CONCAT_IMPL(a, b) a##b
+#define SLATE_TRACE_CONCAT(a, b) SLATE_TRACE_CONCAT_IMPL(a, b)
+#define SLATE_TRACE_SCOPE(category, name) \
+    const TraceSpan SLATE_TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+
+#endif // TRACER_H
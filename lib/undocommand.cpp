@@ -32,3 +32,13 @@ bool UndoCommand::modifiesContents() const
 {
     return false;
 }
+
+QVector<QImage> UndoCommand::heldImages() const
+{
+    return {};
+}
+
+qint64 UndoCommand::heldBytes() const
+{
+    return 0;
+}
@@ -20,7 +20,9 @@
 #ifndef UNDOCOMMAND_H
 #define UNDOCOMMAND_H
 
+#include <QImage>
 #include <QUndoCommand>
+#include <QVector>
 
 #include "slate-global.h"
 
@@ -32,6 +34,12 @@ public:
 
     // Returns true if this undo command should cause the Project::contentsModified() signal to be emitted.
     virtual bool modifiesContents() const;
+
+    // Returns the images that this command holds on to in order to undo or redo itself.
+    // Used by MemoryStats, which takes care of not counting shared image data twice.
+    virtual QVector<QImage> heldImages() const;
+    // Returns the number of bytes held by this command for anything other than heldImages().
+    virtual qint64 heldBytes() const;
 };
 
 
@@ -20,12 +20,16 @@
 #include <QClipboard>
 #include <QCursor>
 #include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QPainter>
 #include <QQmlEngine>
 #include <QSharedPointer>
 #include <QtTest>
 #include <QQuickItemGrabResult>
 #include <QQuickWindow>
+#include <QtQuickTest>
 
 // Need this otherwise we get linker errors.
 extern "C" {
@@ -33,10 +37,14 @@ extern "C" {
 #include "bitmap/misc/gif.h"
 }
 
+#include "animation.h"
+#include "animationplayback.h"
 #include "application.h"
-#include "applypixelpencommand.h"
+#include "clipboard.h"
 #include "imagelayer.h"
 #include "imageutils.h"
+#include "layerthumbnailcache.h"
+#include "memorystats.h"
 #include "tilecanvas.h"
 #include "probabilityswatch.h"
 #include "project.h"
@@ -45,6 +53,7 @@ extern "C" {
 #include "swatch.h"
 #include "testhelper.h"
 #include "tileset.h"
+#include "tracer.h"
 
 class tst_App : public TestHelper
 {
@@ -81,21 +90,32 @@ private Q_SLOTS:
     void keyboardShortcuts();
     void optionsShortcutCancelled();
     void optionsTransparencyCancelled();
+    void traceEvents();
+    void traceRecordingsDontOverwriteEachOther();
+    void frameTimings();
+    void memoryStats();
     void showGrid();
     void undoPixels();
     void undoLargePixelPen();
+    void undoLargePixelEraser();
     void undoTiles();
     void undoWithDuplicates();
     void undoTilesetCanvasSizeChange();
     void undoImageCanvasSizeChange();
     void undoImageSizeChange();
     void undoLayeredImageSizeChange();
+    void asyncLayeredImageLivePreview();
     void undoRearrangeContentsIntoGridChange_data();
     void undoRearrangeContentsIntoGridChange();
     void undoPixelFill();
     void undoTileFill();
+    void greedyPixelFillTileCanvas();
+    void tileUsages();
+    void tilesetChangeBatches();
     void undoThickSquarePen();
     void undoThickRoundPen();
+    void undoPixelPenStroke();
+    void coalescedPixelPenStroke();
     void penSubpixelPosition();
     void penSubpixelPositionWithThickBrush_data();
     void penSubpixelPositionWithThickBrush();
@@ -138,8 +158,19 @@ private Q_SLOTS:
     void penToolRightClickBehaviour_data();
     void penToolRightClickBehaviour();
     void splitScreenRendering();
+    void contentImageSharedBetweenPanes();
+    void contentImageNotRecomputedWhenPanning();
+    void exportedImageCached();
     void formatNotModifiable();
     void models();
+    void upscale_data();
+    void upscale();
+    void rotateAndFlip_data();
+    void rotateAndFlip();
+    void moveContentsWrapAround_data();
+    void moveContentsWrapAround();
+    void extractTiles();
+    void saveAndLoadTiles();
 
     // Rulers, guides, notes, etc.
     void rulersAndGuides_data();
@@ -168,6 +199,8 @@ private Q_SLOTS:
     void moveSelectionImageCanvas_data();
     void moveSelectionImageCanvas();
     void moveSelectionWithKeysImageCanvas();
+    void selectionPreview_data();
+    void selectionPreview();
     void deleteSelectionImageCanvas_data();
     void deleteSelectionImageCanvas();
     void copyPaste_data();
@@ -178,6 +211,7 @@ private Q_SLOTS:
     void undoAfterMovedPaste();
     void undoPasteAcrossLayers_data();
     void undoPasteAcrossLayers();
+    void copyAcrossLayersCropped();
     void flipPastedImage();
     void flipOnTransparentBackground();
     void panThenMoveSelection();
@@ -200,6 +234,9 @@ private Q_SLOTS:
     void animationPlayback();
     void playNonLoopingAnimationTwice();
     void animationGifExport();
+    void animationGifExportChangedAreas();
+    void animationGifExportUpscaler_data();
+    void animationGifExportUpscaler();
     void newAnimations_data();
     void newAnimations();
     void duplicateAnimations_data();
@@ -233,6 +270,7 @@ private Q_SLOTS:
     void undoMoveContents();
     void undoMoveContentsOfVisibleLayers();
     void selectNextLayer();
+    void layerThumbnails();
 };
 
 typedef QVector<Project::Type> ProjectTypeVector;
@@ -1104,6 +1142,196 @@ void tst_App::optionsTransparencyCancelled()
     QTest::keyClick(window, Qt::Key_Escape);
 }
 
+void tst_App::traceEvents()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+
+    Tracer *tracer = Tracer::instance();
+    const QString traceFilePath = tempProjectDir->path() + "/trace.json";
+    tracer->setFilePath(traceFilePath);
+    tracer->setEnabled(true);
+
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    canvas->undo();
+    canvas->redo();
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(0, 0), QColor(Qt::black));
+
+    // Disabling tracing writes the file.
+    tracer->setEnabled(false);
+    tracer->setFilePath(QString());
+
+    QFile traceFile(traceFilePath);
+    QVERIFY2(traceFile.open(QIODevice::ReadOnly), qPrintable(traceFile.errorString()));
+    QJsonParseError parseError;
+    const QJsonDocument traceDocument = QJsonDocument::fromJson(traceFile.readAll(), &parseError);
+    QVERIFY2(!traceDocument.isNull(), qPrintable(parseError.errorString()));
+
+    QSet<QString> spanNames;
+    const QJsonArray traceEvents = traceDocument.object().value(QLatin1String("traceEvents")).toArray();
+    for (const QJsonValue &traceEvent : traceEvents) {
+        const QJsonObject traceEventObject = traceEvent.toObject();
+        if (traceEventObject.value(QLatin1String("ph")).toString() != QLatin1String("X"))
+            continue;
+
+        QVERIFY(traceEventObject.value(QLatin1String("dur")).toDouble() >= 0);
+        spanNames.insert(traceEventObject.value(QLatin1String("name")).toString());
+    }
+    QVERIFY2(spanNames.contains(QLatin1String("ImageCanvas::applyCurrentTool")), qPrintable(QDebug::toString(spanNames)));
+    QVERIFY2(spanNames.contains(QLatin1String("Project::addChange")), qPrintable(QDebug::toString(spanNames)));
+    QVERIFY2(spanNames.contains(QLatin1String("ImageCanvas::undo")), qPrintable(QDebug::toString(spanNames)));
+    QVERIFY2(spanNames.contains(QLatin1String("ImageCanvas::redo")), qPrintable(QDebug::toString(spanNames)));
+}
+
+void tst_App::traceRecordingsDontOverwriteEachOther()
+{
+    Tracer *tracer = Tracer::instance();
+    QVERIFY(tracer->filePath().isEmpty());
+
+    // Without an explicit path, each recording should get its own file.
+    tracer->setEnabled(true);
+    const QString firstTraceFilePath = tracer->recordingFilePath();
+    QVERIFY(!firstTraceFilePath.isEmpty());
+    tracer->addCompleteEvent("test", "first", tracer->elapsedMicroseconds(), 0);
+    tracer->setEnabled(false);
+    QVERIFY(QFile::exists(firstTraceFilePath));
+
+    tracer->setEnabled(true);
+    const QString secondTraceFilePath = tracer->recordingFilePath();
+    QVERIFY(secondTraceFilePath != firstTraceFilePath);
+    tracer->addCompleteEvent("test", "second", tracer->elapsedMicroseconds(), 0);
+    tracer->setEnabled(false);
+    QVERIFY(QFile::exists(secondTraceFilePath));
+
+    // Each file should only contain its own recording.
+    const QStringList traceFilePaths = { firstTraceFilePath, secondTraceFilePath };
+    const QStringList testSpanNames = { QLatin1String("first"), QLatin1String("second") };
+    for (int i = 0; i < traceFilePaths.size(); ++i) {
+        QFile traceFile(traceFilePaths.at(i));
+        QVERIFY2(traceFile.open(QIODevice::ReadOnly), qPrintable(traceFile.errorString()));
+        const QJsonArray traceEvents = QJsonDocument::fromJson(traceFile.readAll())
+            .object().value(QLatin1String("traceEvents")).toArray();
+        QStringList spanNames;
+        for (const QJsonValue &traceEvent : traceEvents) {
+            const QJsonObject traceEventObject = traceEvent.toObject();
+            if (traceEventObject.value(QLatin1String("ph")).toString() == QLatin1String("X"))
+                spanNames.append(traceEventObject.value(QLatin1String("name")).toString());
+        }
+        // The render thread could have recorded spans too, so only check ours.
+        QVERIFY2(spanNames.contains(testSpanNames.at(i)), qPrintable(spanNames.join(QLatin1String(", "))));
+        QVERIFY2(!spanNames.contains(testSpanNames.at(1 - i)), qPrintable(spanNames.join(QLatin1String(", "))));
+        traceFile.close();
+        QVERIFY(traceFile.remove());
+    }
+}
+
+void tst_App::frameTimings()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+
+    FrameTimings *frameTimings = canvas->frameTimings();
+    QVERIFY(!frameTimings->isEnabled());
+
+    // Showing the FPS counter shows the overlay, which enables the timings.
+    app.settings()->setFpsVisible(true);
+    QQuickItem *frameTimingsOverlay = window->findChild<QQuickItem*>("frameTimingsOverlay");
+    QVERIFY(frameTimingsOverlay);
+    QTRY_VERIFY(frameTimingsOverlay->isVisible());
+    QVERIFY(frameTimings->isEnabled());
+
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    // The FPS counter animates continuously, so frames keep coming and the timings get published.
+    QTRY_VERIFY(frameTimings->frameTime() > 0);
+    QTRY_VERIFY(frameTimings->toolTime() > 0);
+    QVERIFY(frameTimings->undoPushTime() > 0);
+    QVERIFY(frameTimings->contentImageTime() > 0);
+    QVERIFY(frameTimings->paintTime() > 0);
+    QVERIFY(!frameTimings->slowestFrames().isEmpty());
+
+    // All times are in milliseconds. Even without vsync a frame takes longer than a tenth of a
+    // millisecond, and even on a slow machine it takes less than a second.
+    QVERIFY2(frameTimings->frameTime() > 0.1 && frameTimings->frameTime() < 1000,
+        qPrintable(QString::number(frameTimings->frameTime())));
+    const QVariantMap slowestFrame = frameTimings->slowestFrames().first().toMap();
+    QVERIFY(slowestFrame.value("frameTime").toReal() >= frameTimings->frameTime());
+    QVERIFY2(slowestFrame.value("frameTime").toReal() < 1000,
+        qPrintable(slowestFrame.value("frameTime").toString()));
+    QVERIFY(frameTimings->paintTime() < 1000);
+
+    int histogramFrameCount = 0;
+    const QVariantList histogram = frameTimings->frameTimeHistogram();
+    QCOMPARE(histogram.size(), frameTimings->frameTimeHistogramBounds().size() + 1);
+    for (const QVariant &count : histogram)
+        histogramFrameCount += count.toInt();
+    QVERIFY(histogramFrameCount > 0);
+    // Not every frame can be faster than the fastest bucket's bound.
+    QVERIFY(histogram.first().toInt() < histogramFrameCount || frameTimings->frameTime() < 8);
+
+    app.settings()->setFpsVisible(false);
+    QTRY_VERIFY(!frameTimings->isEnabled());
+    QCOMPARE(frameTimings->frameTime(), 0.0);
+}
+
+void tst_App::memoryStats()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+
+    MemoryStats memoryStats;
+    QSignalSpy statsChangedSpy(&memoryStats, &MemoryStats::statsChanged);
+    memoryStats.setCanvas(canvas);
+    memoryStats.refresh();
+    QCOMPARE(statsChangedSpy.size(), 1);
+
+    const qint64 layerImageBytes = layeredImageProject->layerAt(0)->image()->sizeInBytes();
+    QCOMPARE(memoryStats.layerBytes(), layerImageBytes);
+    QCOMPARE(memoryStats.layers().size(), 1);
+    QCOMPARE(memoryStats.layers().first().toMap().value("bytes").toLongLong(), layerImageBytes);
+    QCOMPARE(memoryStats.undoStackBytes(), 0);
+    QVERIFY(memoryStats.undoCommands().isEmpty());
+
+    // Draw a pixel so that there's something on the undo stack.
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    memoryStats.refresh();
+    QCOMPARE(memoryStats.layerBytes(), layerImageBytes);
+    const qint64 penUndoStackBytes = memoryStats.undoStackBytes();
+    QVERIFY(penUndoStackBytes > 0);
+    QCOMPARE(memoryStats.undoCommands().size(), 1);
+    QCOMPARE(memoryStats.undoCommands().first().toMap().value("count").toInt(), 1);
+
+    // The fill command holds the image before and after the fill, but the latter is
+    // shared with the layer, so only the former should be counted against the undo stack.
+    QVERIFY2(switchTool(ImageCanvas::FillTool), failureMessage);
+    setCursorPosInScenePixels(1, 0);
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QCOMPARE(project->undoStack()->count(), 2);
+    memoryStats.refresh();
+    QCOMPARE(memoryStats.layerBytes(), layerImageBytes);
+    QCOMPARE(memoryStats.undoStackBytes(), penUndoStackBytes + layerImageBytes);
+    QCOMPARE(memoryStats.undoCommands().size(), 2);
+    // Sorted by bytes, largest first.
+    const QVariantMap fillCommandStats = memoryStats.undoCommands().first().toMap();
+    QCOMPARE(fillCommandStats.value("type").toString(), QLatin1String("PixelFillTool"));
+    QCOMPARE(fillCommandStats.value("bytes").toLongLong(), layerImageBytes);
+    QCOMPARE(memoryStats.totalBytes(), memoryStats.layerBytes() + memoryStats.undoStackBytes()
+        + memoryStats.livePreviewBytes() + memoryStats.selectionBytes() + memoryStats.contentImageCacheBytes()
+        + memoryStats.clipboardBytes() + memoryStats.autoSwatchBytes());
+
+    // The overlay refreshes its own stats while it's visible.
+    app.settings()->setFpsVisible(true);
+    QQuickItem *frameTimingsOverlay = window->findChild<QQuickItem*>("frameTimingsOverlay");
+    QVERIFY(frameTimingsOverlay);
+    MemoryStats *overlayMemoryStats = frameTimingsOverlay->findChild<MemoryStats*>("memoryStats");
+    QVERIFY(overlayMemoryStats);
+    QTRY_COMPARE(overlayMemoryStats->undoStackBytes(), memoryStats.undoStackBytes());
+    app.settings()->setFpsVisible(false);
+}
+
 void tst_App::showGrid()
 {
     QVERIFY2(createNewTilesetProject(), failureMessage);
@@ -1187,6 +1415,8 @@ void tst_App::undoPixels()
     lastImage = *tilesetProject->tileAt(cursorPos)->tileset()->image();
     setCursorPosInScenePixels(cursorPos + QPoint(0, 1));
     QTest::mouseMove(window, cursorWindowPos);
+    // Coalesced strokes are drawn before the next frame.
+    QVERIFY(QQuickTest::qWaitForPolish(tileCanvas));
     QVERIFY(*tilesetProject->tileAt(cursorPos)->tileset()->image() != lastImage);
 
     // Now release the mouse and finish the drawing. Nothing should have changed.
@@ -1275,6 +1505,41 @@ void tst_App::undoLargePixelPen()
     QCOMPARE(*tilesetProject->tileset()->image(), originalTilesetImage);
 }
 
+void tst_App::undoLargePixelEraser()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+    QVERIFY2(switchMode(TileCanvas::TileMode), failureMessage);
+
+    // Draw two tiles next to each other.
+    for (int x = 0; x < 2; ++x) {
+        setCursorPosInTiles(x, 0);
+        QTest::mouseMove(window, cursorWindowPos);
+        QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+        QVERIFY(tilesetProject->tileAt(cursorPos));
+    }
+
+    QVERIFY2(switchMode(TileCanvas::PixelMode), failureMessage);
+    QVERIFY2(switchTool(ImageCanvas::EraserTool), failureMessage);
+    const int toolSize = tilesetProject->tileWidth();
+    QVERIFY2(changeToolSize(toolSize), failureMessage);
+
+    const QImage originalTilesetImage = *tilesetProject->tileset()->image();
+
+    // Erase across the boundary between the two tiles.
+    setCursorPosInScenePixels(toolSize, toolSize / 2);
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QVERIFY(*tilesetProject->tileset()->image() != originalTilesetImage);
+    QCOMPARE(tilesetProject->tileAt(cursorPos - QPoint(1, 0))->pixelColor(toolSize - 1, toolSize / 2), QColor(Qt::transparent));
+    QCOMPARE(tilesetProject->tileAt(cursorPos)->pixelColor(0, toolSize / 2), QColor(Qt::transparent));
+
+    QVERIFY2(clickButton(undoToolButton), failureMessage);
+    QCOMPARE(*tilesetProject->tileset()->image(), originalTilesetImage);
+
+    QVERIFY2(clickButton(redoToolButton), failureMessage);
+    QCOMPARE(tilesetProject->tileAt(cursorPos)->pixelColor(0, toolSize / 2), QColor(Qt::transparent));
+}
+
 void tst_App::undoTiles()
 {
     QVERIFY2(createNewTilesetProject(), failureMessage);
@@ -1387,6 +1652,8 @@ void tst_App::undoWithDuplicates()
     lastImage = *tilesetProject->tileAt(cursorPos)->tileset()->image();
     setCursorPosInScenePixels(0, 2);
     QTest::mouseMove(window, cursorWindowPos);
+    // Coalesced strokes are drawn before the next frame.
+    QVERIFY(QQuickTest::qWaitForPolish(tileCanvas));
     QCOMPARE(tilesetProject->tileAt(cursorPos)->pixelColor(cursorPos), tileCanvas->penForegroundColour());
     QVERIFY(*tilesetProject->tileAt(cursorPos)->tileset()->image() != lastImage);
 
@@ -1394,10 +1661,12 @@ void tst_App::undoWithDuplicates()
     lastImage = *tilesetProject->tileAt(cursorPos)->tileset()->image();
     setCursorPosInScenePixels(0, 1);
     QTest::mouseMove(window, cursorWindowPos);
+    QVERIFY(QQuickTest::qWaitForPolish(tileCanvas));
     QCOMPARE(*tilesetProject->tileAt(cursorPos)->tileset()->image(), lastImage);
 
     setCursorPosInScenePixels(0, 2);
     QTest::mouseMove(window, cursorWindowPos);
+    QVERIFY(QQuickTest::qWaitForPolish(tileCanvas));
     QCOMPARE(*tilesetProject->tileAt(cursorPos)->tileset()->image(), lastImage);
 
     lastImage = *tilesetProject->tileAt(cursorPos)->tileset()->image();
@@ -1432,6 +1701,7 @@ void tst_App::undoWithDuplicates()
     for (; x < tilesetProject->tileWidth(); ++x) {
         setCursorPosInScenePixels(x, y);
         QTest::mouseMove(window, cursorWindowPos);
+        QVERIFY(QQuickTest::qWaitForPolish(tileCanvas));
         QCOMPARE(tilesetProject->tileAt(cursorPos)->pixelColor(cursorPos), tileCanvas->penForegroundColour());
     }
     // The last pixel is on the next tile.
@@ -1633,6 +1903,41 @@ void tst_App::undoLayeredImageSizeChange()
     QCOMPARE(postUndoSnapshot, preSizeChangeCanvasSnapshot);
 }
 
+void tst_App::asyncLayeredImageLivePreview()
+{
+    QVERIFY2(createNewLayeredImageProject(12, 12), failureMessage);
+    QVERIFY2(addNewLayer("Layer 2", 0), failureMessage);
+    const QSize originalSize = project->size();
+
+    // Only the last of several quick modifications should end up being shown.
+    project->beginLivePreview();
+    layeredImageProject->resize(24, 24, false);
+    layeredImageProject->resize(6, 6, false);
+    QTRY_VERIFY(!layeredImageProject->isLivePreviewModificationPending());
+    QCOMPARE(project->size(), QSize(6, 6));
+    QCOMPARE(layeredImageProject->layerAt(0)->image()->size(), QSize(6, 6));
+    QCOMPARE(layeredImageProject->layerAt(1)->image()->size(), QSize(6, 6));
+
+    // Cancelling while a modification is still pending should discard it.
+    layeredImageProject->resize(30, 30, false);
+    project->endLivePreview(Project::RollbackModification);
+    QVERIFY(!layeredImageProject->isLivePreviewModificationPending());
+    QCOMPARE(project->size(), originalSize);
+    QTest::qWait(0);
+    QCOMPARE(project->size(), originalSize);
+
+    // Committing while a modification is still pending should commit it.
+    project->beginLivePreview();
+    layeredImageProject->resize(8, 8, false);
+    project->endLivePreview(Project::CommitModificaton);
+    QVERIFY(!layeredImageProject->isLivePreviewModificationPending());
+    QCOMPARE(project->size(), QSize(8, 8));
+    QCOMPARE(layeredImageProject->layerAt(1)->image()->size(), QSize(8, 8));
+
+    QVERIFY2(clickButton(undoToolButton), failureMessage);
+    QCOMPARE(project->size(), originalSize);
+}
+
 void tst_App::undoRearrangeContentsIntoGridChange_data()
 {
     QTest::addColumn<QString>("projectPath");
@@ -1773,6 +2078,171 @@ void tst_App::undoTileFill()
     QCOMPARE(tilesetProject->tileAtTilePos(QPoint(1, 0)), targetTile);
 }
 
+void tst_App::greedyPixelFillTileCanvas()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+    QVERIFY2(togglePanel("tilesetSwatchPanel", true), failureMessage);
+
+    QVERIFY2(switchMode(TileCanvas::TileMode), failureMessage);
+
+    // Select a blank tile to draw on.
+    QTest::mouseMove(window, tilesetTileSceneCentre(1, 0));
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, tilesetTileSceneCentre(1, 0));
+
+    // Draw the tile on so that we can operate on its pixels.
+    setCursorPosInTiles(0, 0);
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::mousePress(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QTest::mouseRelease(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QVERIFY(tilesetProject->tileAt(cursorPos));
+
+    // Draw two separate pixels.
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    setCursorPosInScenePixels(3, 3);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    const Tile *targetTile = tilesetProject->tileAt(cursorPos);
+    QVERIFY(targetTile);
+    const QColor black = QColor(Qt::black);
+    const QColor previousColour = targetTile->pixelColor(1, 1);
+    QVERIFY(previousColour != black);
+
+    // A greedy fill should fill both of them, but nothing in between.
+    QVERIFY2(switchTool(TileCanvas::FillTool), failureMessage);
+    const QColor red = QColor(Qt::red);
+    tileCanvas->setPenForegroundColour(red);
+    setCursorPosInScenePixels(0, 0);
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::keyPress(window, Qt::Key_Shift);
+    // For some reason there must be a delay in order for the shift modifier to work.
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos, 100);
+    QTest::keyRelease(window, Qt::Key_Shift);
+    QCOMPARE(targetTile->pixelColor(0, 0), red);
+    QCOMPARE(targetTile->pixelColor(3, 3), red);
+    QCOMPARE(targetTile->pixelColor(1, 1), previousColour);
+
+    // Undo it.
+    QVERIFY2(clickButton(undoToolButton), failureMessage);
+    QCOMPARE(targetTile->pixelColor(0, 0), black);
+    QCOMPARE(targetTile->pixelColor(3, 3), black);
+}
+
+void tst_App::tileUsages()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+    QVERIFY2(togglePanel("tilesetSwatchPanel", true), failureMessage);
+
+    const Tile *penTile = tileCanvas->penTile();
+    QVERIFY(penTile);
+    QVERIFY(tilesetProject->tilePositionsUsingTile(penTile->id()).isEmpty());
+    // Empty cells aren't uses of anything.
+    QVERIFY(tilesetProject->tilePositionsUsingTile(Tile::invalidId()).isEmpty());
+
+    setCursorPosInTiles(0, 0);
+    QVERIFY2(drawTileAtCursorPos(), failureMessage);
+
+    setCursorPosInTiles(2, 1);
+    QVERIFY2(drawTileAtCursorPos(), failureMessage);
+
+    QVector<QPoint> tilePositions = tilesetProject->tilePositionsUsingTile(penTile->id());
+    std::sort(tilePositions.begin(), tilePositions.end(), [](const QPoint &a, const QPoint &b) {
+        return a.y() != b.y() ? a.y() < b.y() : a.x() < b.x();
+    });
+    QCOMPARE(tilePositions, (QVector<QPoint>{ QPoint(0, 0), QPoint(2, 1) }));
+
+    // Highlighting the tile should outline its uses on the canvas.
+    QVERIFY(imageGrabber.requestImage(tileCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    const QImage unhighlightedCanvasImage = imageGrabber.takeImage();
+
+    QSignalSpy highlightedTileIdChangedSpy(tileCanvas, &TileCanvas::highlightedTileIdChanged);
+    tileCanvas->setHighlightedTileId(penTile->id());
+    QCOMPARE(tileCanvas->highlightedTileId(), penTile->id());
+    QCOMPARE(highlightedTileIdChangedSpy.size(), 1);
+    QVERIFY(imageGrabber.requestImage(tileCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    QVERIFY(imageGrabber.takeImage() != unhighlightedCanvasImage);
+
+    tileCanvas->setHighlightedTileId(Tile::invalidId());
+    QCOMPARE(highlightedTileIdChangedSpy.size(), 2);
+    QVERIFY(imageGrabber.requestImage(tileCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    QCOMPARE(imageGrabber.takeImage(), unhighlightedCanvasImage);
+
+    // Replace every use of it with another tile.
+    const QPoint tilesetCentre = tilesetTileCentre(1, 0);
+    const Tile *replacementTile = tilesetProject->tilesetTileAt(tilesetCentre.x(), tilesetCentre.y());
+    QVERIFY(replacementTile);
+    QVERIFY(replacementTile != penTile);
+    QSignalSpy tilesChangedSpy(tilesetProject.data(), &TilesetProject::tilesChanged);
+    tilesetProject->replaceTile(penTile->id(), replacementTile->id());
+    QCOMPARE(tilesChangedSpy.size(), 1);
+    QVERIFY(tilesetProject->tilePositionsUsingTile(penTile->id()).isEmpty());
+    QCOMPARE(tilesetProject->tilePositionsUsingTile(replacementTile->id()).size(), 2);
+    QCOMPARE(tilesetProject->tileAtTilePos(QPoint(0, 0)), replacementTile);
+    QCOMPARE(tilesetProject->tileAtTilePos(QPoint(2, 1)), replacementTile);
+
+    // It should be undoable as one change.
+    QVERIFY2(clickButton(undoToolButton), failureMessage);
+    QCOMPARE(tilesChangedSpy.size(), 2);
+    QCOMPARE(tilesetProject->tilePositionsUsingTile(penTile->id()).size(), 2);
+    QVERIFY(tilesetProject->tilePositionsUsingTile(replacementTile->id()).isEmpty());
+    QCOMPARE(tilesetProject->tileAtTilePos(QPoint(0, 0)), penTile);
+    QCOMPARE(tilesetProject->tileAtTilePos(QPoint(2, 1)), penTile);
+
+    QVERIFY2(clickButton(redoToolButton), failureMessage);
+    QCOMPARE(tilesChangedSpy.size(), 3);
+    QCOMPARE(tilesetProject->tileAtTilePos(QPoint(0, 0)), replacementTile);
+    QCOMPARE(tilesetProject->tileAtTilePos(QPoint(2, 1)), replacementTile);
+
+    // Shrinking the map should drop the uses that no longer fit.
+    tilesetProject->setSize(QSize(2, 2));
+    QCOMPARE(tilesetProject->tilePositionsUsingTile(replacementTile->id()), QVector<QPoint>{ QPoint(0, 0) });
+}
+
+void tst_App::tilesetChangeBatches()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+
+    Tileset *tileset = tilesetProject->tileset();
+    QSignalSpy imageChangedSpy(tileset, &Tileset::imageChanged);
+    QVERIFY(imageChangedSpy.isValid());
+
+    // Outside of a batch, each edit is notified on its own.
+    const QRect firstRect(0, 0, 2, 2);
+    const QRect secondRect(10, 5, 3, 1);
+    tileset->notifyImageChanged(firstRect);
+    tileset->notifyImageChanged(secondRect);
+    QCOMPARE(imageChangedSpy.size(), 2);
+    QCOMPARE(imageChangedSpy.at(0).at(0).value<QRegion>(), QRegion(firstRect));
+    QCOMPARE(imageChangedSpy.at(1).at(0).value<QRegion>(), QRegion(secondRect));
+
+    // Within a batch (even a nested one), nothing is emitted until the outermost
+    // commit, and then only once, with the union of every edit.
+    imageChangedSpy.clear();
+    tileset->beginChanges();
+    tileset->notifyImageChanged(firstRect);
+    tileset->beginChanges();
+    tileset->notifyImageChanged(secondRect);
+    tileset->commitChanges();
+    const QPoint pixelPos(tileset->tileWidth() + 1, 0);
+    tileset->setPixelColor(pixelPos.x(), pixelPos.y(), Qt::red);
+    QCOMPARE(imageChangedSpy.size(), 0);
+    tileset->commitChanges();
+    QCOMPARE(imageChangedSpy.size(), 1);
+    const QRegion expectedRegion = QRegion(firstRect) + secondRect
+        + QRect(tileset->tileWidth(), 0, tileset->tileWidth(), tileset->tileHeight());
+    QCOMPARE(imageChangedSpy.at(0).at(0).value<QRegion>(), expectedRegion);
+
+    // A batch without any edits shouldn't emit anything.
+    imageChangedSpy.clear();
+    tileset->beginChanges();
+    tileset->commitChanges();
+    QCOMPARE(imageChangedSpy.size(), 0);
+}
+
 void tst_App::undoThickSquarePen()
 {
     QVERIFY2(createNewImageProject(), failureMessage);
@@ -1856,6 +2326,74 @@ void tst_App::undoThickRoundPen()
     QCOMPARE(canvas->currentProjectImage()->copy(QRect(0, 0, 5, 5)), undoneImage);
 }
 
+// Segments of a pen stroke should end up in one undo command
+// which restores everything the stroke covered.
+void tst_App::undoPixelPenStroke()
+{
+    QVERIFY2(createNewImageProject(), failureMessage);
+    QVERIFY2(changeToolSize(3), failureMessage);
+
+    const QImage originalImage = *canvas->currentProjectImage();
+
+    setCursorPosInScenePixels(QPoint(4, 4));
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::mousePress(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    // Go back over what's already been drawn to check that the
+    // original pixels are kept rather than the ones from earlier segments.
+    const QVector<QPoint> scenePositions = { QPoint(10, 4), QPoint(10, 10), QPoint(4, 4) };
+    for (const QPoint &scenePos : scenePositions) {
+        setCursorPosInScenePixels(scenePos);
+        QTest::mouseMove(window, cursorWindowPos);
+    }
+    QTest::mouseRelease(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(4, 4), QColor(Qt::black));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(10, 4), QColor(Qt::black));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(10, 10), QColor(Qt::black));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(7, 7), QColor(Qt::black));
+
+    QUndoStack *undoStack = project->undoStack();
+    const QUndoCommand *strokeCommand = undoStack->command(undoStack->index() - 1);
+    QVERIFY(strokeCommand);
+    QCOMPARE(strokeCommand->childCount(), 1);
+
+    const QImage drawnImage = *canvas->currentProjectImage();
+
+    QVERIFY2(clickButton(undoToolButton), failureMessage);
+    QCOMPARE(*canvas->currentProjectImage(), originalImage);
+
+    QVERIFY2(clickButton(redoToolButton), failureMessage);
+    QCOMPARE(*canvas->currentProjectImage(), drawnImage);
+
+    QVERIFY2(clickButton(undoToolButton), failureMessage);
+    QCOMPARE(*canvas->currentProjectImage(), originalImage);
+}
+
+void tst_App::coalescedPixelPenStroke()
+{
+    QVERIFY2(createNewImageProject(), failureMessage);
+
+    QSignalSpy latencySpy(canvas.data(), SIGNAL(strokeLatencyMeasured(qint64)));
+    QVERIFY(latencySpy.isValid());
+
+    setCursorPosInScenePixels(QPoint(0, 0));
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::mousePress(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    // Several moves within one frame should be drawn as one polyline.
+    for (int x = 2; x <= 8; x += 2) {
+        setCursorPosInScenePixels(QPoint(x, 0));
+        QTest::mouseMove(window, cursorWindowPos);
+    }
+    QVERIFY(QQuickTest::qWaitForPolish(canvas));
+    for (int x = 0; x <= 8; ++x)
+        QCOMPARE(canvas->currentProjectImage()->pixelColor(x, 0), QColor(Qt::black));
+    QTRY_VERIFY(!latencySpy.isEmpty());
+    QVERIFY(latencySpy.first().first().toLongLong() > 0);
+
+    QTest::mouseRelease(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QUndoStack *undoStack = project->undoStack();
+    QCOMPARE(undoStack->command(undoStack->index() - 1)->childCount(), 1);
+}
+
 void tst_App::penSubpixelPosition()
 {
     QVERIFY2(createNewImageProject(), failureMessage);
@@ -3316,6 +3854,87 @@ void tst_App::splitScreenRendering()
     QCOMPARE(canvasGrab.pixelColor(layeredImageCanvas->width() * 0.75, layeredImageCanvas->height() / 2), QColor(Qt::white));
 }
 
+void tst_App::contentImageSharedBetweenPanes()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+    QVERIFY(canvas->isSplitScreen());
+
+    // Ensure that both panes have painted.
+    QVERIFY(imageGrabber.requestImage(layeredImageCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    imageGrabber.takeImage();
+
+    // Nothing has changed since then, so the content image shouldn't be recomputed.
+    const QImage contentImage = canvas->contentImage();
+    QCOMPARE(canvas->contentImage().constBits(), contentImage.constBits());
+
+    // Drawing should cause it to be recomputed, though.
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QVERIFY(canvas->contentImage().constBits() != contentImage.constBits());
+    QCOMPARE(canvas->contentImage().pixelColor(0, 0), QColor(Qt::black));
+    QCOMPARE(contentImage.pixelColor(0, 0), QColor(Qt::white));
+}
+
+void tst_App::contentImageNotRecomputedWhenPanning()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+    QVERIFY2(addNewLayer(QLatin1String("Layer 2"), 1), failureMessage);
+
+    QVERIFY(imageGrabber.requestImage(layeredImageCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    imageGrabber.takeImage();
+    const QImage contentImage = canvas->contentImage();
+
+    // Panning only changes the view, so the layers shouldn't be flattened again.
+    QVERIFY2(panBy(50, 30), failureMessage);
+    QVERIFY(imageGrabber.requestImage(layeredImageCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    imageGrabber.takeImage();
+    QCOMPARE(canvas->contentImage().constBits(), contentImage.constBits());
+
+    // Neither should zooming.
+    canvas->currentPane()->setZoomLevel(canvas->currentPane()->zoomLevel() + 1);
+    QVERIFY(imageGrabber.requestImage(layeredImageCanvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    imageGrabber.takeImage();
+    QCOMPARE(canvas->contentImage().constBits(), contentImage.constBits());
+
+    // Hiding a layer changes the content, though.
+    layeredImageProject->layerAt(0)->setVisible(false);
+    QVERIFY(canvas->contentImage().constBits() != contentImage.constBits());
+}
+
+void tst_App::exportedImageCached()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+
+    // Nothing has changed, so the layers shouldn't be flattened again.
+    const QImage exportedImage = project->exportedImage();
+    const quint64 contentsGeneration = project->contentsGeneration();
+    QCOMPARE(project->exportedImage().constBits(), exportedImage.constBits());
+    QCOMPARE(project->contentsGeneration(), contentsGeneration);
+
+    // Drawing should invalidate it.
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QVERIFY(project->contentsGeneration() > contentsGeneration);
+    const QImage drawnExportedImage = project->exportedImage();
+    QVERIFY(drawnExportedImage.constBits() != exportedImage.constBits());
+    QCOMPARE(drawnExportedImage.pixelColor(0, 0), QColor(Qt::black));
+    QCOMPARE(project->exportedImage().constBits(), drawnExportedImage.constBits());
+
+    // So should undoing, which doesn't emit contentsModified().
+    layeredImageProject->undoStack()->undo();
+    QCOMPARE(project->exportedImage().pixelColor(0, 0), QColor(Qt::white));
+
+    // ... and changing a layer's visibility.
+    layeredImageProject->setLayerVisible(0, false);
+    QCOMPARE(project->exportedImage().pixelColor(0, 0), QColor(Qt::transparent));
+}
+
 // Distinct from a read-only file, this test checks that the UI prevents images with formats like Format_Indexed8
 // from being modified, as QPainter doesn't support it.
 void tst_App::formatNotModifiable()
@@ -3343,6 +3962,245 @@ void tst_App::models()
     }
 }
 
+void tst_App::upscale_data()
+{
+    QTest::addColumn<int>("factor");
+
+    QTest::newRow("2") << 2;
+    QTest::newRow("3") << 3;
+    QTest::newRow("8") << 8;
+}
+
+void tst_App::upscale()
+{
+    QFETCH(int, factor);
+
+    // A diagonal line.
+    QImage image = ImageUtils::filledImage(5, 4, Qt::white);
+    for (int i = 0; i < 4; ++i)
+        image.setPixelColor(i, i, Qt::red);
+
+    // Nearest neighbour upscaling should be identical to QImage's generic scaling.
+    const QImage expectedImage = image.scaled(image.size() * factor);
+    QCOMPARE(ImageUtils::upscale(image, factor), expectedImage);
+    QCOMPARE(ImageUtils::resizeContents(image, image.size() * factor), expectedImage);
+
+    // The pixel-art upscalers shouldn't introduce any new colours,
+    // and should smooth out the staircase of the diagonal line.
+    const QVector<ImageUtils::Upscaler> upscalers = { ImageUtils::Scale2xUpscaler, ImageUtils::Scale3xUpscaler };
+    for (const ImageUtils::Upscaler upscaler : upscalers) {
+        const QImage upscaledImage = ImageUtils::upscale(image, factor, upscaler);
+        QCOMPARE(upscaledImage.size(), image.size() * factor);
+        QVector<QColor> uniqueColours;
+        QCOMPARE(ImageUtils::findUniqueColours(upscaledImage, 10, uniqueColours), ImageUtils::FindUniqueColoursSucceeded);
+        QCOMPARE(uniqueColours.size(), 2);
+
+        const bool usesKernel = (upscaler == ImageUtils::Scale2xUpscaler && factor % 2 == 0)
+            || (upscaler == ImageUtils::Scale3xUpscaler && factor % 3 == 0);
+        if (usesKernel) {
+            // The block of pixels to the right of the first red pixel
+            // should now have some red in its bottom left corner.
+            QCOMPARE(upscaledImage.pixelColor(factor, factor - 1), QColor(Qt::red));
+        } else {
+            QCOMPARE(upscaledImage, expectedImage);
+        }
+    }
+
+    // Images that the kernels can't work on directly should come back in their own format.
+    const QVector<QImage::Format> formats = { QImage::Format_Indexed8, QImage::Format_RGB888, QImage::Format_RGB16 };
+    for (const QImage::Format format : formats) {
+        const QImage convertedImage = image.convertToFormat(format);
+        for (const ImageUtils::Upscaler upscaler : { ImageUtils::NearestNeighbourUpscaler, ImageUtils::Scale2xUpscaler }) {
+            const QImage upscaledImage = ImageUtils::upscale(convertedImage, factor, upscaler);
+            QCOMPARE(upscaledImage.format(), format);
+            QCOMPARE(upscaledImage.size(), image.size() * factor);
+            QCOMPARE(upscaledImage.pixelColor(0, 0), convertedImage.pixelColor(0, 0));
+            QCOMPARE(upscaledImage.pixelColor(upscaledImage.width() - 1, 0), convertedImage.pixelColor(image.width() - 1, 0));
+        }
+        QCOMPARE(ImageUtils::upscale(convertedImage, factor), expectedImage.convertToFormat(format));
+    }
+}
+
+void tst_App::rotateAndFlip_data()
+{
+    QTest::addColumn<QSize>("size");
+
+    QTest::newRow("5x3") << QSize(5, 3);
+    // Bigger than the block size that rotations are done in, and not a multiple of it.
+    QTest::newRow("70x33") << QSize(70, 33);
+}
+
+void tst_App::rotateAndFlip()
+{
+    QFETCH(QSize, size);
+
+    // Give every pixel a unique colour so that we can tell if any end up in the wrong place.
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < size.height(); ++y) {
+        for (int x = 0; x < size.width(); ++x)
+            image.setPixelColor(x, y, QColor(x, y, 255));
+    }
+
+    const QVector<int> angles = { 90, 180, 270, -90, 360 };
+    for (const int angle : angles) {
+        QTransform transform;
+        transform.rotate(angle);
+        QCOMPARE(ImageUtils::rotate(image, angle), image.transformed(transform));
+    }
+
+    QImage flippedImage = image;
+    ImageUtils::flip(flippedImage, flippedImage.rect(), Qt::Horizontal);
+    QCOMPARE(flippedImage, image.mirrored(true, false));
+
+    flippedImage = image;
+    ImageUtils::flip(flippedImage, flippedImage.rect(), Qt::Vertical);
+    QCOMPARE(flippedImage, image.mirrored(false, true));
+
+    // Flipping part of the image should leave the rest alone.
+    const QRect area(1, 1, size.width() - 2, size.height() - 1);
+    flippedImage = image;
+    ImageUtils::flip(flippedImage, area, Qt::Horizontal);
+    QImage expectedImage = image;
+    ImageUtils::copyPixels(image.copy(area).mirrored(true, false), QRect(QPoint(0, 0), area.size()), expectedImage, area.topLeft());
+    QCOMPARE(flippedImage, expectedImage);
+}
+
+void tst_App::moveContentsWrapAround_data()
+{
+    QTest::addColumn<QPoint>("distance");
+
+    QTest::newRow("2,-1") << QPoint(2, -1);
+    QTest::newRow("-3,4") << QPoint(-3, 4);
+    // Further than the size of the image.
+    QTest::newRow("12,-9") << QPoint(12, -9);
+}
+
+void tst_App::moveContentsWrapAround()
+{
+    QFETCH(QPoint, distance);
+
+    // Give every pixel a unique colour so that we can tell if any end up in the wrong place.
+    const QSize size(5, 3);
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < size.height(); ++y) {
+        for (int x = 0; x < size.width(); ++x)
+            image.setPixelColor(x, y, QColor(x * 50, y * 50, 255));
+    }
+
+    // Without wrapping around, the result should be the same as painting the image at the new position.
+    QImage expectedImage = ImageUtils::filledImage(size);
+    QPainter painter(&expectedImage);
+    painter.drawImage(distance, image);
+    painter.end();
+    QCOMPARE(ImageUtils::moveContents(image, distance.x(), distance.y()), expectedImage);
+
+    const QImage wrappedImage = ImageUtils::moveContents(image, distance.x(), distance.y(), true);
+    for (int y = 0; y < size.height(); ++y) {
+        for (int x = 0; x < size.width(); ++x) {
+            const QPoint wrappedPos(((x + distance.x()) % size.width() + size.width()) % size.width(),
+                ((y + distance.y()) % size.height() + size.height()) % size.height());
+            QCOMPARE(wrappedImage.pixelColor(wrappedPos), image.pixelColor(x, y));
+        }
+    }
+
+    // Formats that are moved with QPainter should wrap around in the same way.
+    const QImage rgbImage = image.convertToFormat(QImage::Format_RGB32);
+    QCOMPARE(ImageUtils::moveContents(rgbImage, distance.x(), distance.y(), true).convertToFormat(QImage::Format_RGB32),
+        wrappedImage.convertToFormat(QImage::Format_RGB32));
+}
+
+void tst_App::extractTiles()
+{
+    // A 4x2 map of 3x3 tiles, where only three of the tiles are unique:
+    // A B A A
+    // C A B A
+    const QSize tileSize(3, 3);
+    const QVector<QColor> uniqueTileColours = { Qt::red, Qt::green, Qt::blue };
+    const QVector<int> expectedTileIndices = { 0, 1, 0, 0, 2, 0, 1, 0 };
+    QImage image(4 * tileSize.width(), 2 * tileSize.height(), QImage::Format_ARGB32_Premultiplied);
+    for (int cellIndex = 0; cellIndex < expectedTileIndices.size(); ++cellIndex) {
+        const QRect cellRect(QPoint((cellIndex % 4) * tileSize.width(), (cellIndex / 4) * tileSize.height()), tileSize);
+        QPainter painter(&image);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(cellRect, uniqueTileColours.at(expectedTileIndices.at(cellIndex)));
+        // Make sure that more than the first pixel is compared.
+        painter.fillRect(cellRect.x() + 2, cellRect.y() + 2, 1, 1, Qt::black);
+    }
+
+    const ImageUtils::ExtractedTiles extractedTiles = ImageUtils::extractTiles(image, tileSize);
+    QCOMPARE(extractedTiles.tileIndices, expectedTileIndices);
+    QCOMPARE(extractedTiles.tilesetTilesWide, 2);
+    QCOMPARE(extractedTiles.tilesetTilesHigh, 2);
+    for (int tileIndex = 0; tileIndex < uniqueTileColours.size(); ++tileIndex) {
+        const QPoint topLeft((tileIndex % 2) * tileSize.width(), (tileIndex / 2) * tileSize.height());
+        QCOMPARE(extractedTiles.tilesetImage.pixelColor(topLeft), uniqueTileColours.at(tileIndex));
+        QCOMPARE(extractedTiles.tilesetImage.pixelColor(topLeft + QPoint(2, 2)), QColor(Qt::black));
+    }
+
+    // Create a project from the image.
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+    const QString imagePath = tempProjectDir->path() + "/level.png";
+    QVERIFY(image.save(imagePath));
+    tilesetProject->createFromImage(QUrl::fromLocalFile(imagePath), tileSize.width(), tileSize.height());
+    QCOMPARE(tilesetProject->tilesWide(), 4);
+    QCOMPARE(tilesetProject->tilesHigh(), 2);
+    QCOMPARE(tilesetProject->tileset()->tilesWide(), 2);
+    QCOMPARE(tilesetProject->tileset()->tilesHigh(), 2);
+    for (int cellIndex = 0; cellIndex < expectedTileIndices.size(); ++cellIndex) {
+        const Tile *tile = tilesetProject->tileAtTilePos(QPoint(cellIndex % 4, cellIndex / 4));
+        QVERIFY(tile);
+        QCOMPARE(tile->pixelColor(0, 0), uniqueTileColours.at(expectedTileIndices.at(cellIndex)));
+    }
+}
+
+void tst_App::saveAndLoadTiles()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+
+    // Make a map that has runs of the same tile as well as single tiles.
+    tilesetProject->setSize(QSize(40, 30));
+    const Tile *tile = tilesetProject->tilesetTileAt(0, 0);
+    QVERIFY(tile);
+    const int tileId = tile->id();
+    for (int x = 0; x < 40; ++x)
+        tilesetProject->setTileAtPixelPos(QPoint(x, 0), tileId);
+    tilesetProject->setTileAtPixelPos(QPoint(5, 5), tileId);
+    tilesetProject->setTileAtPixelPos(QPoint(39, 29), tileId);
+    const QVector<int> expectedTiles = tilesetProject->tiles();
+
+    // By default, the tiles should be saved as one value per cell so that older versions can read them.
+    const QUrl unpackedSaveUrl = QUrl::fromLocalFile(tempProjectDir->path() + "/unpacked-tiles.stp");
+    QVERIFY(tilesetProject->saveAs(unpackedSaveUrl));
+
+    QFile projectFile(unpackedSaveUrl.toLocalFile());
+    QVERIFY(projectFile.open(QIODevice::ReadOnly));
+    QJsonObject projectObject = QJsonDocument::fromJson(projectFile.readAll()).object().value("project").toObject();
+    QCOMPARE(projectObject.value("tiles").toArray().size(), 40 * 30);
+    QVERIFY(!projectObject.contains("packedTiles"));
+    projectFile.close();
+
+    // When enabled, they should be packed into one value.
+    app.settings()->setPackedTilesEnabled(true);
+    const QUrl packedSaveUrl = QUrl::fromLocalFile(tempProjectDir->path() + "/packed-tiles.stp");
+    const bool saved = tilesetProject->saveAs(packedSaveUrl);
+    app.settings()->setPackedTilesEnabled(false);
+    QVERIFY(saved);
+
+    projectFile.setFileName(packedSaveUrl.toLocalFile());
+    QVERIFY(projectFile.open(QIODevice::ReadOnly));
+    projectObject = QJsonDocument::fromJson(projectFile.readAll()).object().value("project").toObject();
+    QVERIFY(projectObject.value("packedTiles").isString());
+    QVERIFY(!projectObject.contains("tiles"));
+    projectFile.close();
+
+    // Both should load regardless of the setting.
+    for (const QUrl &saveUrl : { unpackedSaveUrl, packedSaveUrl }) {
+        QVERIFY2(loadProject(saveUrl), failureMessage);
+        QCOMPARE(tilesetProject->tiles(), expectedTiles);
+        QCOMPARE(tilesetProject->tilePositionsUsingTile(tileId).size(), 42);
+    }
+}
+
 void tst_App::rulersAndGuides_data()
 {
     addAllProjectTypes();
@@ -4482,6 +5340,76 @@ void tst_App::moveSelectionWithKeysImageCanvas()
     QCOMPARE(imageProject->image()->pixelColor(5, 4), QColor(Qt::black));
 }
 
+void tst_App::selectionPreview_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::selectionPreview()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+    const QColor backgroundColour = canvas->currentProjectImage()->pixelColor(20, 20);
+
+    // Draw a square of black pixels.
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+    QVERIFY2(changeToolSize(5), failureMessage);
+    setCursorPosInScenePixels(2, 2);
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(0, 0), QColor(Qt::black));
+
+    QVERIFY2(changeToolSize(1), failureMessage);
+    QVERIFY2(switchTool(ImageCanvas::SelectionTool), failureMessage);
+    QVERIFY2(selectArea(QRect(0, 0, 5, 5)), failureMessage);
+
+    // Move the selection without confirming it.
+    QSignalSpy contentRectPaintRequestedSpy(canvas, &ImageCanvas::contentRectPaintRequested);
+    QVERIFY2(dragSelection(QPoint(10, 10)), failureMessage);
+    QCOMPARE(canvas->selectionArea(), QRect(10, 10, 5, 5));
+
+    // Only the area that the contents left and the area they were moved to
+    // should be repainted, not everything in between.
+    QVERIFY(!contentRectPaintRequestedSpy.isEmpty());
+    bool repaintedNewArea = false;
+    for (const QList<QVariant> &arguments : qAsConst(contentRectPaintRequestedSpy)) {
+        const QRect sceneRect = arguments.first().toRect();
+        QVERIFY2(!sceneRect.contains(7, 7), qPrintable(QDebug::toString(sceneRect)));
+        if (sceneRect.contains(QRect(10, 10, 5, 5)))
+            repaintedNewArea = true;
+    }
+    QVERIFY(repaintedNewArea);
+
+    // The preview should show the contents at their new position and the hole they left behind...
+    const QImage contentImage = canvas->contentImage();
+    QCOMPARE(contentImage.pixelColor(0, 0), QColor(Qt::transparent));
+    QCOMPARE(contentImage.pixelColor(4, 4), QColor(Qt::transparent));
+    QCOMPARE(contentImage.pixelColor(10, 10), QColor(Qt::black));
+    QCOMPARE(contentImage.pixelColor(14, 14), QColor(Qt::black));
+    QCOMPARE(contentImage.pixelColor(20, 20), backgroundColour);
+
+    // ... without touching the layer itself.
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(0, 0), QColor(Qt::black));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(10, 10), backgroundColour);
+
+    // The preview is drawn over the unmodified image (or layer) when painting,
+    // so check that it ends up in the right place.
+    QVERIFY(imageGrabber.requestImage(canvas));
+    QTRY_VERIFY(imageGrabber.isReady());
+    const QImage canvasGrab = imageGrabber.takeImage();
+    setCursorPosInScenePixels(12, 12);
+    QCOMPARE(canvasGrab.pixelColor(canvas->mapFromScene(cursorWindowPos).toPoint()), QColor(Qt::black));
+    setCursorPosInScenePixels(2, 2);
+    QVERIFY(canvasGrab.pixelColor(canvas->mapFromScene(cursorWindowPos).toPoint()) != QColor(Qt::black));
+
+    // Confirming the move should apply it to the layer.
+    QTest::keyClick(window, Qt::Key_Escape);
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(0, 0), QColor(Qt::transparent));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(10, 10), QColor(Qt::black));
+    QCOMPARE(canvas->contentImage().pixelColor(0, 0), QColor(Qt::transparent));
+    QCOMPARE(canvas->contentImage().pixelColor(10, 10), QColor(Qt::black));
+}
+
 void tst_App::deleteSelectionImageCanvas_data()
 {
     addImageProjectTypes();
@@ -4771,6 +5699,36 @@ void tst_App::undoPasteAcrossLayers()
     QVERIFY2(compareImages(undoneLayerImages, originalLayerImages), failureMessage);
 }
 
+void tst_App::copyAcrossLayersCropped()
+{
+    QVERIFY2(createNewLayeredImageProject(256, 256, true), failureMessage);
+
+    // Draw a red dot on a new layer, leaving the other layer empty.
+    QVERIFY2(addNewLayer("Layer 2", 0), failureMessage);
+    QVERIFY2(selectLayer("Layer 2", 0), failureMessage);
+    setCursorPosInScenePixels(20, 20);
+    layeredImageCanvas->setPenForegroundColour(Qt::red);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    QVERIFY2(switchTool(ImageCanvas::SelectionTool), failureMessage);
+    QVERIFY2(selectArea(QRect(10, 10, 32, 32)), failureMessage);
+    QVERIFY2(copyAcrossLayers(), failureMessage);
+
+    // Only what's in each layer within the copied area should be stored.
+    const QVector<CopiedLayerImage> copiedLayerImages = Clipboard::instance()->copiedLayerImages();
+    QCOMPARE(Clipboard::instance()->copiedLayerAreaSize(), QSize(32, 32));
+    QCOMPARE(copiedLayerImages.at(0).image.size(), QSize(1, 1));
+    QCOMPARE(copiedLayerImages.at(0).image.pixelColor(0, 0), QColor(Qt::red));
+    QCOMPARE(copiedLayerImages.at(0).offset, QPoint(10, 10));
+    QVERIFY(copiedLayerImages.at(1).image.isNull());
+
+    // Pasting should still replace the whole area in each layer.
+    QVERIFY2(pasteAcrossLayers(50, 50, false), failureMessage);
+    QCOMPARE(layeredImageProject->layerAt(0)->image()->pixelColor(60, 60), QColor(Qt::red));
+    QCOMPARE(layeredImageProject->layerAt(0)->image()->pixelColor(20, 20), QColor(Qt::red));
+    QCOMPARE(layeredImageProject->layerAt(1)->image()->pixelColor(60, 60), QColor(Qt::transparent));
+}
+
 void tst_App::flipPastedImage()
 {
     QVERIFY2(createNewImageProject(), failureMessage);
@@ -5641,6 +6599,209 @@ void tst_App::animationGifExport()
     }
 }
 
+struct GifFrameInfo
+{
+    QRect rect;
+    int delayInCentiseconds = 0;
+};
+
+// Returns the position, size and delay of each frame in gifData,
+// or nothing if it couldn't be parsed.
+static QVector<GifFrameInfo> gifFrameInfos(const QByteArray &gifData)
+{
+    const auto uint16At = [&](int index) {
+        return int(uchar(gifData.at(index))) | (int(uchar(gifData.at(index + 1))) << 8);
+    };
+    const auto skipSubBlocks = [&](int index) {
+        while (index < gifData.size()) {
+            const int blockSize = uchar(gifData.at(index));
+            index += 1 + blockSize;
+            if (blockSize == 0)
+                return index;
+        }
+        return -1;
+    };
+
+    QVector<GifFrameInfo> frameInfos;
+    if (gifData.size() < 13 || !gifData.startsWith("GIF89a"))
+        return {};
+
+    int index = 13;
+    const uchar screenFields = uchar(gifData.at(10));
+    if (screenFields & 0x80)
+        index += 3 * (1 << ((screenFields & 0x07) + 1));
+
+    int delayInCentiseconds = 0;
+    while (index >= 0 && index + 10 <= gifData.size()) {
+        const uchar introducer = uchar(gifData.at(index));
+        if (introducer == 0x3B) {
+            return frameInfos;
+        } else if (introducer == 0x21) {
+            // Graphic control extension.
+            if (uchar(gifData.at(index + 1)) == 0xF9)
+                delayInCentiseconds = uint16At(index + 4);
+            index = skipSubBlocks(index + 2);
+        } else if (introducer == 0x2C) {
+            frameInfos.append({ QRect(uint16At(index + 1), uint16At(index + 3),
+                uint16At(index + 5), uint16At(index + 7)), delayInCentiseconds });
+            const uchar descriptorFields = uchar(gifData.at(index + 9));
+            index += 10;
+            if (descriptorFields & 0x80)
+                index += 3 * (1 << ((descriptorFields & 0x07) + 1));
+            // Skip the LZW minimum code size and the image data.
+            index = skipSubBlocks(index + 1);
+        } else {
+            return {};
+        }
+    }
+    // The trailer is missing.
+    return {};
+}
+
+void tst_App::animationGifExportChangedAreas()
+{
+    // Four 8x8 frames. The second frame changes a small area of the first, the third is identical
+    // to the second, and the fourth moves what changed in the second.
+    const int frameWidth = 8;
+    const int frameHeight = 8;
+    const int frameCount = 4;
+    QImage sourceImage(frameWidth * frameCount, frameHeight, QImage::Format_ARGB32);
+    sourceImage.fill(Qt::darkGreen);
+    {
+        QPainter painter(&sourceImage);
+        for (int frameIndex = 0; frameIndex < frameCount; ++frameIndex) {
+            const QPoint frameTopLeft(frameIndex * frameWidth, 0);
+            painter.fillRect(QRect(frameTopLeft, QSize(2, 2)), Qt::blue);
+            if (frameIndex == 1 || frameIndex == 2)
+                painter.fillRect(QRect(frameTopLeft + QPoint(3, 4), QSize(2, 3)), Qt::yellow);
+            else if (frameIndex == 3)
+                painter.fillRect(QRect(frameTopLeft + QPoint(5, 1), QSize(1, 2)), Qt::yellow);
+        }
+    }
+
+    Animation animation;
+    animation.setFrameWidth(frameWidth);
+    animation.setFrameHeight(frameHeight);
+    animation.setFrameCount(frameCount);
+    animation.setFps(10);
+    AnimationPlayback playback;
+    playback.setAnimation(&animation);
+    playback.setScale(1);
+    const int frameDelayInCentiseconds = 10;
+
+    const QString gifPath = tempProjectDir->path() + QLatin1String("/changed-areas.gif");
+    QString errorMessage;
+    QVERIFY2(ImageUtils::exportGif(sourceImage, QUrl::fromLocalFile(gifPath), playback, errorMessage),
+        qPrintable(errorMessage));
+
+    // Only the changed area of each frame should be encoded, and the identical
+    // third frame should have been merged into the second.
+    QFile gifFile(gifPath);
+    QVERIFY(gifFile.open(QIODevice::ReadOnly));
+    const QVector<GifFrameInfo> frameInfos = gifFrameInfos(gifFile.readAll());
+    gifFile.close();
+    QCOMPARE(frameInfos.size(), 3);
+    QCOMPARE(frameInfos.at(0).rect, QRect(0, 0, frameWidth, frameHeight));
+    QCOMPARE(frameInfos.at(1).rect, QRect(3, 4, 2, 3));
+    QCOMPARE(frameInfos.at(2).rect, QRect(3, 1, 3, 6));
+    QCOMPARE(frameInfos.at(0).delayInCentiseconds, frameDelayInCentiseconds);
+    QCOMPARE(frameInfos.at(1).delayInCentiseconds, frameDelayInCentiseconds * 2);
+    QCOMPARE(frameInfos.at(2).delayInCentiseconds, frameDelayInCentiseconds);
+    int totalDelayInCentiseconds = 0;
+    for (const GifFrameInfo &frameInfo : frameInfos)
+        totalDelayInCentiseconds += frameInfo.delayInCentiseconds;
+    QCOMPARE(totalDelayInCentiseconds, frameDelayInCentiseconds * frameCount);
+
+    // Each decoded frame should look exactly like the source frame(s) it was created from.
+    GIF *gif = gif_load(gifPath.toLatin1().constData());
+    QVERIFY(gif);
+    auto gifCleanup = qScopeGuard([gif]{ gif_free(gif); });
+    QCOMPARE(gif->n, frameInfos.size());
+    const QVector<int> sourceFrameIndices = { 0, 1, 3 };
+    for (int gifFrameIndex = 0; gifFrameIndex < gif->n; ++gifFrameIndex) {
+        const Bitmap *gifBitmap = gif->frames[gifFrameIndex].image;
+        QCOMPARE(gifBitmap->w, frameWidth);
+        QCOMPARE(gifBitmap->h, frameHeight);
+
+        const int sourceFrameIndex = sourceFrameIndices.at(gifFrameIndex);
+        const QImage expectedImage = sourceImage.copy(sourceFrameIndex * frameWidth, 0, frameWidth, frameHeight);
+        for (int y = 0; y < frameHeight; ++y) {
+            for (int x = 0; x < frameWidth; ++x) {
+                const int byteIndex = (y * frameWidth + x) * 4;
+                const QColor actualColour(gifBitmap->data[byteIndex + 2], gifBitmap->data[byteIndex + 1],
+                    gifBitmap->data[byteIndex], gifBitmap->data[byteIndex + 3]);
+                const QColor expectedColour = expectedImage.pixelColor(x, y);
+                QVERIFY2(actualColour == expectedColour,
+                    qPrintable(QString::fromLatin1("Expected pixel at x=%1 y=%2 of GIF frame %3 to be %4 but it's %5")
+                        .arg(x).arg(y).arg(gifFrameIndex).arg(expectedColour.name(QColor::HexArgb)).arg(actualColour.name(QColor::HexArgb))));
+            }
+        }
+    }
+}
+
+void tst_App::animationGifExportUpscaler_data()
+{
+    QTest::addColumn<AnimationPlayback::Upscaler>("upscaler");
+    QTest::addColumn<int>("scale");
+
+    QTest::newRow("NearestNeighbourUpscaler") << AnimationPlayback::NearestNeighbourUpscaler << 2;
+    QTest::newRow("Scale2xUpscaler") << AnimationPlayback::Scale2xUpscaler << 2;
+    QTest::newRow("Scale3xUpscaler") << AnimationPlayback::Scale3xUpscaler << 3;
+}
+
+void tst_App::animationGifExportUpscaler()
+{
+    QFETCH(AnimationPlayback::Upscaler, upscaler);
+    QFETCH(int, scale);
+
+    // A single frame with a diagonal line, which the Scale2x and Scale3x kernels smooth out.
+    const int frameSize = 4;
+    QImage sourceImage(frameSize, frameSize, QImage::Format_ARGB32);
+    sourceImage.fill(Qt::darkGreen);
+    for (int i = 0; i < frameSize; ++i)
+        sourceImage.setPixelColor(i, i, Qt::blue);
+
+    Animation animation;
+    animation.setFrameWidth(frameSize);
+    animation.setFrameHeight(frameSize);
+    animation.setFrameCount(1);
+    animation.setFps(10);
+    AnimationPlayback playback;
+    playback.setAnimation(&animation);
+    playback.setScale(scale);
+    playback.setUpscaler(upscaler);
+
+    const QString gifPath = tempProjectDir->path() + QLatin1String("/upscaler.gif");
+    QString errorMessage;
+    QVERIFY2(ImageUtils::exportGif(sourceImage, QUrl::fromLocalFile(gifPath), playback, errorMessage),
+        qPrintable(errorMessage));
+
+    const QImage expectedImage = ImageUtils::upscale(sourceImage, scale, static_cast<ImageUtils::Upscaler>(upscaler));
+    if (upscaler != AnimationPlayback::NearestNeighbourUpscaler) {
+        // Make sure that the test would notice if the wrong upscaler was used.
+        QVERIFY(expectedImage != ImageUtils::upscale(sourceImage, scale, ImageUtils::NearestNeighbourUpscaler));
+    }
+
+    GIF *gif = gif_load(gifPath.toLatin1().constData());
+    QVERIFY(gif);
+    auto gifCleanup = qScopeGuard([gif]{ gif_free(gif); });
+    QCOMPARE(gif->n, 1);
+    const Bitmap *gifBitmap = gif->frames[0].image;
+    QCOMPARE(gifBitmap->w, expectedImage.width());
+    QCOMPARE(gifBitmap->h, expectedImage.height());
+    for (int y = 0; y < expectedImage.height(); ++y) {
+        for (int x = 0; x < expectedImage.width(); ++x) {
+            const int byteIndex = (y * expectedImage.width() + x) * 4;
+            const QColor actualColour(gifBitmap->data[byteIndex + 2], gifBitmap->data[byteIndex + 1],
+                gifBitmap->data[byteIndex], gifBitmap->data[byteIndex + 3]);
+            const QColor expectedColour = expectedImage.pixelColor(x, y);
+            QVERIFY2(actualColour == expectedColour,
+                qPrintable(QString::fromLatin1("Expected pixel at x=%1 y=%2 to be %3 but it's %4")
+                    .arg(x).arg(y).arg(expectedColour.name(QColor::HexArgb)).arg(actualColour.name(QColor::HexArgb))));
+        }
+    }
+}
+
 void tst_App::newAnimations_data()
 {
     addImageProjectTypes();
@@ -7101,6 +8262,65 @@ void tst_App::selectNextLayer()
     QCOMPARE(layeredImageProject->currentLayerIndex(), 0);
 }
 
+void tst_App::layerThumbnails()
+{
+    QVERIFY2(createNewLayeredImageProject(), failureMessage);
+    QVERIFY2(togglePanel("layerPanel", true), failureMessage);
+    QVERIFY2(addNewLayer("Layer 2", 0), failureMessage);
+
+    LayerThumbnailCache *thumbnails = layeredImageProject->layerThumbnails();
+    QTRY_VERIFY(!thumbnails->isUpdatePending());
+
+    ImageLayer *layer1 = layeredImageProject->layerAt(1);
+    ImageLayer *layer2 = layeredImageProject->layerAt(0);
+    const QSize thumbnailSize = LayerThumbnailCache::thumbnailSize(layer1->size());
+    QCOMPARE(thumbnailSize, QSize(LayerThumbnailCache::maxThumbnailSize, LayerThumbnailCache::maxThumbnailSize));
+    QCOMPARE(thumbnails->thumbnail(layer1).size(), thumbnailSize);
+    QCOMPARE(thumbnails->thumbnail(layer2).size(), thumbnailSize);
+    const QString layer1Url = thumbnails->thumbnailUrl(layer1);
+    const QString layer2Url = thumbnails->thumbnailUrl(layer2);
+    QVERIFY(!layer1Url.isEmpty());
+    QVERIFY(!layer2Url.isEmpty());
+
+    // The delegates should show them.
+    QQuickItem *layer2Delegate = findListViewChild("layerListView", "Layer 2");
+    QVERIFY(layer2Delegate);
+    QQuickItem *layer2ThumbnailImage = layer2Delegate->findChild<QQuickItem*>("layerThumbnailImage");
+    QVERIFY(layer2ThumbnailImage);
+    QCOMPARE(layer2ThumbnailImage->property("source").toUrl().toString(), layer2Url);
+
+    // Draw on the second layer; only its thumbnail should change.
+    const QImage layer2ThumbnailBeforeDrawing = thumbnails->thumbnail(layer2);
+    QVERIFY2(selectLayer("Layer 2", 0), failureMessage);
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+    layeredImageCanvas->setPenForegroundColour(Qt::red);
+    setCursorPosInScenePixels(10, 10);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QTRY_VERIFY(!thumbnails->isUpdatePending());
+    QCOMPARE(thumbnails->thumbnailUrl(layer1), layer1Url);
+    QVERIFY(thumbnails->thumbnailUrl(layer2) != layer2Url);
+    QTRY_COMPARE(layer2ThumbnailImage->property("source").toUrl().toString(), thumbnails->thumbnailUrl(layer2));
+    QVERIFY(thumbnails->thumbnail(layer2) != layer2ThumbnailBeforeDrawing);
+
+    // Only part of the thumbnail was updated, but it should be identical to one made from scratch.
+    const QImage expectedThumbnail = ImageUtils::downsample(*layer2->image(), QPoint(0, 0),
+        layer2->size(), thumbnailSize, QRect(QPoint(0, 0), thumbnailSize));
+    QCOMPARE(thumbnails->thumbnail(layer2), expectedThumbnail);
+
+    // Undoing should restore the original thumbnail.
+    layeredImageProject->undoStack()->undo();
+    QTRY_VERIFY(!thumbnails->isUpdatePending());
+    QCOMPARE(thumbnails->thumbnail(layer2), layer2ThumbnailBeforeDrawing);
+
+    // Changes that don't go through the canvas should result in the whole thumbnail being updated.
+    const QSize newLayerSize(128, 300);
+    layeredImageProject->setSize(newLayerSize);
+    QTRY_VERIFY(!thumbnails->isUpdatePending());
+    QCOMPARE(thumbnails->thumbnail(layer1).size(), LayerThumbnailCache::thumbnailSize(newLayerSize));
+    QCOMPARE(thumbnails->thumbnail(layer2).size(), LayerThumbnailCache::thumbnailSize(newLayerSize));
+    QVERIFY(thumbnails->thumbnailUrl(layer1) != layer1Url);
+}
+
 int main(int argc, char *argv[])
 {
     qputenv("QT_QUICK_CONTROLS_STYLE", "Basic");
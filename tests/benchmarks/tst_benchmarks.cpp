@@ -0,0 +1,397 @@
+/*
+    Copyright 2023, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QGuiApplication>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "fillalgorithms.h"
+#include "imagecanvas.h"
+#include "imagelayer.h"
+#include "imageutils.h"
+#include "layeredimageproject.h"
+#include "texturedfillparameters.h"
+
+/*
+    Benchmarks for the image kernels that the editor spends most of its time in.
+
+    These don't create a window or load any QML, so they measure only the
+    library code. Each benchmark is data-driven over image sizes (and layer
+    counts, where relevant) so that scaling problems are easy to spot.
+
+    To get machine-readable results that can be compared between releases,
+    use QtTest's own loggers, e.g.:
+
+        ./benchmarks -o results.csv,csv
+        ./benchmarks -o results.xml,xml -o -,txt
+
+    Use -tickcounter or -perf (Linux) instead of the default walltime
+    measurement for less noisy results.
+*/
+
+class tst_Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void pixelFloodFill_data();
+    void pixelFloodFill();
+    void greedyPixelFill_data();
+    void greedyPixelFill();
+    void texturedFill_data();
+    void texturedFill();
+    void modifyHsl_data();
+    void modifyHsl();
+    void findUniqueColours_data();
+    void findUniqueColours();
+    void rearrangeContentsIntoGrid_data();
+    void rearrangeContentsIntoGrid();
+    void flattenedImage_data();
+    void flattenedImage();
+    void saveLayeredImageProject_data();
+    void saveLayeredImageProject();
+    void loadLayeredImageProject_data();
+    void loadLayeredImageProject();
+    void exportGif_data();
+    void exportGif();
+
+private:
+    void addImageSizeColumns();
+    void addImageSizeAndLayerCountColumns();
+    QImage createTestImage(int size, int colourCount, bool transparentBackground) const;
+    Q_REQUIRED_RESULT bool createProject(int size, int layerCount, QScopedPointer<LayeredImageProject> &project);
+
+    QTemporaryDir mTempDir;
+    QString mFailureMessage;
+};
+
+static const int sizes[] = { 64, 256, 1024 };
+static const int layerCounts[] = { 1, 8, 32 };
+
+void tst_Benchmarks::initTestCase()
+{
+    QVERIFY2(mTempDir.isValid(), qPrintable(mTempDir.errorString()));
+}
+
+void tst_Benchmarks::addImageSizeColumns()
+{
+    QTest::addColumn<int>("size");
+
+    for (const int size : sizes)
+        QTest::addRow("%dx%d", size, size) << size;
+}
+
+void tst_Benchmarks::addImageSizeAndLayerCountColumns()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("layerCount");
+
+    for (const int size : sizes) {
+        for (const int layerCount : layerCounts)
+            QTest::addRow("%dx%d, %d layers", size, size, layerCount) << size << layerCount;
+    }
+}
+
+/*!
+    Returns a \a size by \a size image made up of 8x8 blocks, each filled
+    with one of \a colourCount colours. If \a transparentBackground is \c true,
+    roughly half of the blocks are left transparent so that fills have
+    irregular regions to work with.
+
+    The same seed is always used so that results are comparable between runs.
+*/
+QImage tst_Benchmarks::createTestImage(int size, int colourCount, bool transparentBackground) const
+{
+    QRandomGenerator generator(size + colourCount);
+
+    QVector<QColor> colours;
+    colours.reserve(colourCount);
+    for (int i = 0; i < colourCount; ++i)
+        colours.append(QColor::fromRgb(generator.generate() | 0xff000000));
+
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    const int blockSize = 8;
+    QPainter painter(&image);
+    for (int y = 0; y < size; y += blockSize) {
+        for (int x = 0; x < size; x += blockSize) {
+            if (transparentBackground && generator.bounded(2) == 0)
+                continue;
+
+            painter.fillRect(x, y, blockSize, blockSize, colours.at(generator.bounded(colourCount)));
+        }
+    }
+    return image;
+}
+
+bool tst_Benchmarks::createProject(int size, int layerCount, QScopedPointer<LayeredImageProject> &project)
+{
+    project.reset(new LayeredImageProject);
+    project->createNew(size, size, true);
+
+    for (int i = 1; i < layerCount; ++i)
+        project->addNewLayer();
+
+    if (project->layerCount() != layerCount) {
+        mFailureMessage = QString::fromLatin1("Expected %1 layers but got %2")
+            .arg(layerCount).arg(project->layerCount());
+        return false;
+    }
+
+    for (int i = 0; i < layerCount; ++i)
+        *project->layerAt(i)->image() = createTestImage(size, 16 + i, true);
+
+    return true;
+}
+
+void tst_Benchmarks::pixelFloodFill_data()
+{
+    addImageSizeColumns();
+}
+
+void tst_Benchmarks::pixelFloodFill()
+{
+    QFETCH(int, size);
+
+    const QImage image = createTestImage(size, 16, true);
+    const QPoint startPos(0, 0);
+    const QColor targetColour = image.pixelColor(startPos);
+
+    QBENCHMARK {
+        const QImage filledImage = imagePixelFloodFill(&image, startPos, targetColour, Qt::red);
+        Q_UNUSED(filledImage);
+    }
+}
+
+void tst_Benchmarks::greedyPixelFill_data()
+{
+    addImageSizeColumns();
+}
+
+void tst_Benchmarks::greedyPixelFill()
+{
+    QFETCH(int, size);
+
+    const QImage image = createTestImage(size, 16, true);
+    const QPoint startPos(0, 0);
+    const QColor targetColour = image.pixelColor(startPos);
+
+    QBENCHMARK {
+        const QImage filledImage = imageGreedyPixelFill(&image, startPos, targetColour, Qt::red);
+        Q_UNUSED(filledImage);
+    }
+}
+
+void tst_Benchmarks::texturedFill_data()
+{
+    addImageSizeColumns();
+}
+
+void tst_Benchmarks::texturedFill()
+{
+    QFETCH(int, size);
+
+    const QImage image = createTestImage(size, 16, true);
+    const QPoint startPos(0, 0);
+    const QColor targetColour = image.pixelColor(startPos);
+
+    TexturedFillParameters parameters;
+    parameters.setType(TexturedFillParameters::VarianceFillType);
+    parameters.lightness()->setEnabled(true);
+    parameters.lightness()->setVarianceLowerBound(-0.2);
+    parameters.lightness()->setVarianceUpperBound(0.2);
+
+    QBENCHMARK {
+        const QImage filledImage = ::texturedFill(&image, startPos, targetColour, Qt::red, parameters);
+        Q_UNUSED(filledImage);
+    }
+}
+
+void tst_Benchmarks::modifyHsl_data()
+{
+    addImageSizeColumns();
+}
+
+void tst_Benchmarks::modifyHsl()
+{
+    QFETCH(int, size);
+
+    const QImage originalImage = createTestImage(size, 64, true);
+
+    QBENCHMARK {
+        QImage image = originalImage;
+        ImageUtils::modifyHsl(image, 0.1, -0.1, 0.05, 0,
+            ImageCanvas::AlphaAdjustmentFlags(ImageCanvas::DoNotModifyFullyTransparentPixels));
+    }
+}
+
+void tst_Benchmarks::findUniqueColours_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("colourCount");
+
+    for (const int size : sizes) {
+        for (const int colourCount : { 16, 256 })
+            QTest::addRow("%dx%d, %d colours", size, size, colourCount) << size << colourCount;
+    }
+}
+
+void tst_Benchmarks::findUniqueColours()
+{
+    QFETCH(int, size);
+    QFETCH(int, colourCount);
+
+    const QImage image = createTestImage(size, colourCount, false);
+
+    QBENCHMARK {
+        QVector<QColor> uniqueColours;
+        const auto result = ImageUtils::findUniqueColours(image, 1000, uniqueColours);
+        QCOMPARE(result, ImageUtils::FindUniqueColoursSucceeded);
+    }
+}
+
+void tst_Benchmarks::rearrangeContentsIntoGrid_data()
+{
+    addImageSizeAndLayerCountColumns();
+}
+
+void tst_Benchmarks::rearrangeContentsIntoGrid()
+{
+    QFETCH(int, size);
+    QFETCH(int, layerCount);
+
+    QVector<QImage> images;
+    for (int i = 0; i < layerCount; ++i)
+        images.append(createTestImage(size, 16 + i, true));
+
+    // Go from an 8x8 grid to a 4x16 one.
+    const int cellSize = size / 8;
+
+    QBENCHMARK {
+        const QVector<QImage> newImages = ImageUtils::rearrangeContentsIntoGrid(images, cellSize, cellSize, 4, 16);
+        QCOMPARE(newImages.size(), layerCount);
+    }
+}
+
+void tst_Benchmarks::flattenedImage_data()
+{
+    addImageSizeAndLayerCountColumns();
+}
+
+void tst_Benchmarks::flattenedImage()
+{
+    QFETCH(int, size);
+    QFETCH(int, layerCount);
+
+    QScopedPointer<LayeredImageProject> project;
+    QVERIFY2(createProject(size, layerCount, project), qPrintable(mFailureMessage));
+
+    QBENCHMARK {
+        const QImage image = project->flattenedImage();
+        QCOMPARE(image.size(), QSize(size, size));
+    }
+}
+
+void tst_Benchmarks::saveLayeredImageProject_data()
+{
+    addImageSizeAndLayerCountColumns();
+}
+
+void tst_Benchmarks::saveLayeredImageProject()
+{
+    QFETCH(int, size);
+    QFETCH(int, layerCount);
+
+    QScopedPointer<LayeredImageProject> project;
+    QVERIFY2(createProject(size, layerCount, project), qPrintable(mFailureMessage));
+
+    QSignalSpy errorSpy(project.data(), &Project::errorOccurred);
+    const QUrl url = QUrl::fromLocalFile(mTempDir.filePath(QLatin1String("save-benchmark.slp")));
+
+    QBENCHMARK {
+        QVERIFY(project->saveAs(url));
+    }
+    QCOMPARE(errorSpy.size(), 0);
+}
+
+void tst_Benchmarks::loadLayeredImageProject_data()
+{
+    addImageSizeAndLayerCountColumns();
+}
+
+void tst_Benchmarks::loadLayeredImageProject()
+{
+    QFETCH(int, size);
+    QFETCH(int, layerCount);
+
+    const QUrl url = QUrl::fromLocalFile(mTempDir.filePath(QLatin1String("load-benchmark.slp")));
+    {
+        QScopedPointer<LayeredImageProject> project;
+        QVERIFY2(createProject(size, layerCount, project), qPrintable(mFailureMessage));
+        QVERIFY(project->saveAs(url));
+    }
+
+    LayeredImageProject project;
+    QSignalSpy errorSpy(&project, &Project::errorOccurred);
+
+    QBENCHMARK {
+        project.load(url);
+        QVERIFY(project.hasLoaded());
+    }
+    QCOMPARE(errorSpy.size(), 0);
+    QCOMPARE(project.layerCount(), layerCount);
+}
+
+void tst_Benchmarks::exportGif_data()
+{
+    addImageSizeAndLayerCountColumns();
+}
+
+void tst_Benchmarks::exportGif()
+{
+    QFETCH(int, size);
+    QFETCH(int, layerCount);
+
+    QScopedPointer<LayeredImageProject> project;
+    QVERIFY2(createProject(size, layerCount, project), qPrintable(mFailureMessage));
+    // This creates a four-frame animation spanning the width of the canvas.
+    project->setUsingAnimation(true);
+
+    QSignalSpy errorSpy(project.data(), &Project::errorOccurred);
+    const QUrl url = QUrl::fromLocalFile(mTempDir.filePath(QLatin1String("export-benchmark.gif")));
+
+    QBENCHMARK {
+        // exportGif() uses the cached exportedImage() once it's been created, and we
+        // want to measure flattening the layers too, so invalidate it each time.
+        emit project->contentsModified();
+        project->exportGif(url);
+    }
+    QCOMPARE(errorSpy.size(), 0);
+}
+
+QTEST_MAIN(tst_Benchmarks)
+
+#include "tst_benchmarks.moc"
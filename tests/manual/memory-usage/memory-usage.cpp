@@ -17,13 +17,57 @@
     along with Slate. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
 #include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaEnum>
 #include <QtTest>
 
+#if defined(Q_OS_MACOS)
+#include <sys/resource.h>
+#elif defined(Q_OS_WIN)
+#define NOMINMAX
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#endif
+
 #include "application.h"
+#include "canvaspane.h"
+#include "imagecanvas.h"
+#include "inputrecorder.h"
+#include "memorystats.h"
 #include "project.h"
 #include "testhelper.h"
 
+/*
+    pen() is a benchmark that must be run by hand.
+
+    replay() replays the input sessions recorded with SLATE_INPUT_RECORDING_FILE
+    (see InputRecorder) that are in the sessions directory, or the directory
+    that SLATE_INPUT_SESSIONS_DIR points to, and fails if any of them exceed
+    the budget in their "budget" object:
+
+        "budget": {
+            "maxPeakRssBytes": 524288000,
+            "maxUndoStackBytes": 16777216,
+            "maxEventLatencyMs": { "50": 10, "95": 30, "99": 60 }
+        }
+
+    All budget entries are optional. The latency of an event is the time it
+    takes to deliver it and then process any events that it caused to be posted.
+    Events are replayed as fast as possible rather than with their recorded timing.
+
+    It's registered with CTest and is meant to be run headless:
+
+        QT_QPA_PLATFORM=offscreen ./memory-usage replay
+*/
+
 class tst_MemoryUsage : public TestHelper
 {
     Q_OBJECT
@@ -34,8 +78,72 @@ public:
 
 private Q_SLOTS:
     void pen();
+    void replay_data();
+    void replay();
+
+private:
+    Q_REQUIRED_RESULT bool setUpReplay(const QJsonObject &session);
+    Q_REQUIRED_RESULT bool replayEvent(const QJsonObject &eventObject);
 };
 
+static const QString inputSessionsDir = QLatin1String(INPUT_SESSIONS_DIR);
+
+template<typename T>
+static T enumFromString(const QString &key, bool *ok)
+{
+    return T(QMetaEnum::fromType<T>().keyToValue(qPrintable(key), ok));
+}
+
+// Returns the peak resident set size of this process in bytes, or -1 if it's not supported.
+static qint64 peakRssBytes()
+{
+#if defined(Q_OS_LINUX)
+    QFile statusFile(QLatin1String("/proc/self/status"));
+    if (!statusFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    // "VmHWM:    123456 kB"
+    const QList<QByteArray> lines = statusFile.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return -1;
+#elif defined(Q_OS_MACOS)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+    // Unlike Linux, this is in bytes.
+    return usage.ru_maxrss;
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return -1;
+    return counters.PeakWorkingSetSize;
+#else
+    return -1;
+#endif
+}
+
+// Resets the peak resident set size so that each session is measured on its own, where possible.
+static void resetPeakRss()
+{
+#if defined(Q_OS_LINUX)
+    QFile clearRefsFile(QLatin1String("/proc/self/clear_refs"));
+    if (clearRefsFile.open(QIODevice::WriteOnly))
+        clearRefsFile.write("5");
+#endif
+}
+
+static qreal percentile(const QVector<qreal> &sortedValues, int percent)
+{
+    if (sortedValues.isEmpty())
+        return 0;
+
+    const int index = qMin(int(sortedValues.size() * percent / 100), int(sortedValues.size() - 1));
+    return sortedValues.at(index);
+}
+
 tst_MemoryUsage::tst_MemoryUsage(int &argc, char **argv) :
     TestHelper(argc, argv)
 {
@@ -72,6 +180,218 @@ void tst_MemoryUsage::pen()
     }
 }
 
+void tst_MemoryUsage::replay_data()
+{
+    QTest::addColumn<QString>("sessionFilePath");
+
+    const QString sessionsDirPath = qEnvironmentVariableIsSet("SLATE_INPUT_SESSIONS_DIR")
+        ? qEnvironmentVariable("SLATE_INPUT_SESSIONS_DIR") : inputSessionsDir;
+    const QDir sessionsDir(sessionsDirPath);
+    const QStringList sessionFileNames = sessionsDir.entryList({ QLatin1String("*.json") }, QDir::Files, QDir::Name);
+    for (const QString &sessionFileName : sessionFileNames)
+        QTest::newRow(qPrintable(sessionFileName)) << sessionsDir.filePath(sessionFileName);
+}
+
+void tst_MemoryUsage::replay()
+{
+    QFETCH(QString, sessionFilePath);
+
+    QFile sessionFile(sessionFilePath);
+    QVERIFY2(sessionFile.open(QIODevice::ReadOnly), qPrintable(sessionFile.errorString()));
+
+    QJsonParseError parseError;
+    const QJsonDocument sessionDocument = QJsonDocument::fromJson(sessionFile.readAll(), &parseError);
+    QVERIFY2(parseError.error == QJsonParseError::NoError, qPrintable(parseError.errorString()));
+    const QJsonObject session = sessionDocument.object();
+    QVERIFY2(session.value(QLatin1String("version")).toInt() <= InputRecorder::sessionVersion,
+        qPrintable(QString::fromLatin1("Session was recorded with a newer version (%1) than is supported (%2)")
+            .arg(session.value(QLatin1String("version")).toInt()).arg(InputRecorder::sessionVersion)));
+
+    const QString projectType = session.value(QLatin1String("projectType")).toString();
+    if (projectType != Project::typeToString(Project::ImageType)
+            && projectType != Project::typeToString(Project::LayeredImageType)) {
+        QSKIP(qPrintable(QString::fromLatin1("Replaying %1 projects is not supported").arg(projectType)));
+    }
+
+    QVERIFY2(setUpReplay(session), failureMessage);
+
+    resetPeakRss();
+
+    const QJsonArray events = session.value(QLatin1String("events")).toArray();
+    QVector<qreal> eventLatenciesMs;
+    eventLatenciesMs.reserve(events.size());
+    QElapsedTimer eventTimer;
+    for (const QJsonValue &eventValue : events) {
+        eventTimer.start();
+        QVERIFY2(replayEvent(eventValue.toObject()), failureMessage);
+        QCoreApplication::processEvents();
+        eventLatenciesMs.append(eventTimer.nsecsElapsed() / 1000000.0);
+    }
+    std::sort(eventLatenciesMs.begin(), eventLatenciesMs.end());
+
+    MemoryStats memoryStats;
+    memoryStats.setCanvas(canvas);
+    memoryStats.refresh();
+    const qint64 undoStackBytes = memoryStats.undoStackBytes();
+    const qint64 peakRss = peakRssBytes();
+
+    qInfo().nospace() << "Replayed " << events.size() << " events from " << sessionFilePath
+        << ": peak RSS=" << peakRss << " undo stack bytes=" << undoStackBytes
+        << " latency (ms) p50=" << percentile(eventLatenciesMs, 50)
+        << " p95=" << percentile(eventLatenciesMs, 95)
+        << " p99=" << percentile(eventLatenciesMs, 99)
+        << " max=" << (eventLatenciesMs.isEmpty() ? 0 : eventLatenciesMs.last());
+
+    const QJsonObject budget = session.value(QLatin1String("budget")).toObject();
+    if (budget.contains(QLatin1String("maxPeakRssBytes"))) {
+        if (peakRss == -1) {
+            qWarning() << "Peak RSS is not supported on this platform; not checking it";
+        } else {
+            const qint64 maxPeakRss = budget.value(QLatin1String("maxPeakRssBytes")).toInteger();
+            QVERIFY2(peakRss <= maxPeakRss, qPrintable(QString::fromLatin1(
+                "Peak RSS of %1 bytes exceeds the budget of %2 bytes").arg(peakRss).arg(maxPeakRss)));
+        }
+    }
+
+    if (budget.contains(QLatin1String("maxUndoStackBytes"))) {
+        const qint64 maxUndoStackBytes = budget.value(QLatin1String("maxUndoStackBytes")).toInteger();
+        QVERIFY2(undoStackBytes <= maxUndoStackBytes, qPrintable(QString::fromLatin1(
+            "Undo stack of %1 bytes exceeds the budget of %2 bytes").arg(undoStackBytes).arg(maxUndoStackBytes)));
+    }
+
+    const QJsonObject maxEventLatencies = budget.value(QLatin1String("maxEventLatencyMs")).toObject();
+    for (auto it = maxEventLatencies.constBegin(); it != maxEventLatencies.constEnd(); ++it) {
+        bool isInt = false;
+        const int percent = it.key().toInt(&isInt);
+        QVERIFY2(isInt && percent > 0 && percent <= 100,
+            qPrintable(QString::fromLatin1("Invalid latency percentile \"%1\"").arg(it.key())));
+
+        const qreal latencyMs = percentile(eventLatenciesMs, percent);
+        const qreal maxLatencyMs = it.value().toDouble();
+        QVERIFY2(latencyMs <= maxLatencyMs, qPrintable(QString::fromLatin1(
+            "p%1 event latency of %2 ms exceeds the budget of %3 ms").arg(percent).arg(latencyMs).arg(maxLatencyMs)));
+    }
+}
+
+bool tst_MemoryUsage::setUpReplay(const QJsonObject &session)
+{
+    const QUrl projectUrl(session.value(QLatin1String("projectUrl")).toString());
+    const int imageWidth = session.value(QLatin1String("imageWidth")).toInt();
+    const int imageHeight = session.value(QLatin1String("imageHeight")).toInt();
+    if (projectUrl.isLocalFile() && QFile::exists(projectUrl.toLocalFile())) {
+        if (!loadProject(projectUrl))
+            return false;
+    } else {
+        if (!projectUrl.isEmpty())
+            qWarning() << "Project" << projectUrl << "doesn't exist; replaying on a new project instead";
+
+        const bool created = session.value(QLatin1String("projectType")).toString() == Project::typeToString(Project::ImageType)
+            ? createNewImageProject(imageWidth, imageHeight, true)
+            : createNewLayeredImageProject(imageWidth, imageHeight, true);
+        if (!created)
+            return false;
+    }
+
+    // Positions are recorded relative to the canvas, so it needs to be the same size.
+    const QSize canvasSize(session.value(QLatin1String("canvasWidth")).toInt(),
+        session.value(QLatin1String("canvasHeight")).toInt());
+    window->resize(window->width() + canvasSize.width() - int(canvas->width()),
+        window->height() + canvasSize.height() - int(canvas->height()));
+    if (!QTest::qWaitFor([&]() { return QSize(canvas->width(), canvas->height()) == canvasSize; })) {
+        failureMessage = QString::fromLatin1("Expected canvas size to be %1x%2, but it's %3x%4")
+            .arg(canvasSize.width()).arg(canvasSize.height()).arg(canvas->width()).arg(canvas->height()).toLatin1();
+        return false;
+    }
+
+    canvas->setSplitScreen(session.value(QLatin1String("splitScreen")).toBool());
+    canvas->firstPane()->read(session.value(QLatin1String("firstPane")).toObject());
+    canvas->secondPane()->read(session.value(QLatin1String("secondPane")).toObject());
+
+    QJsonObject initialState;
+    initialState.insert(QLatin1String("type"), QLatin1String("tool"));
+    initialState.insert(QLatin1String("tool"), session.value(QLatin1String("tool")));
+    if (!replayEvent(initialState))
+        return false;
+    for (const QString &type : { QLatin1String("toolShape"), QLatin1String("toolSize") }) {
+        QJsonObject eventObject;
+        eventObject.insert(QLatin1String("type"), type);
+        eventObject.insert(type, session.value(type));
+        if (!replayEvent(eventObject))
+            return false;
+    }
+    for (const QString &type : { QLatin1String("penForegroundColour"), QLatin1String("penBackgroundColour") }) {
+        QJsonObject eventObject;
+        eventObject.insert(QLatin1String("type"), type);
+        eventObject.insert(QLatin1String("colour"), session.value(type));
+        if (!replayEvent(eventObject))
+            return false;
+    }
+
+    // Don't let the setup affect the measurements.
+    project->undoStack()->clear();
+    QCoreApplication::processEvents();
+    return true;
+}
+
+bool tst_MemoryUsage::replayEvent(const QJsonObject &eventObject)
+{
+    const QString type = eventObject.value(QLatin1String("type")).toString();
+    const Qt::KeyboardModifiers modifiers(eventObject.value(QLatin1String("modifiers")).toInt());
+    const QPoint windowPos = canvas->mapToScene(QPointF(eventObject.value(QLatin1String("x")).toDouble(),
+        eventObject.value(QLatin1String("y")).toDouble())).toPoint();
+
+    if (type == QLatin1String("mousePress")) {
+        QTest::mousePress(window, Qt::MouseButton(eventObject.value(QLatin1String("button")).toInt()), modifiers, windowPos);
+    } else if (type == QLatin1String("mouseMove") || type == QLatin1String("hoverMove")) {
+        QTest::mouseMove(window, windowPos);
+    } else if (type == QLatin1String("mouseRelease")) {
+        QTest::mouseRelease(window, Qt::MouseButton(eventObject.value(QLatin1String("button")).toInt()), modifiers, windowPos);
+    } else if (type == QLatin1String("wheel")) {
+        const QPoint pixelDelta(eventObject.value(QLatin1String("pixelDeltaX")).toInt(),
+            eventObject.value(QLatin1String("pixelDeltaY")).toInt());
+        const QPoint angleDelta(eventObject.value(QLatin1String("angleDeltaX")).toInt(),
+            eventObject.value(QLatin1String("angleDeltaY")).toInt());
+        QWheelEvent wheelEvent(windowPos, window->mapToGlobal(windowPos), pixelDelta, angleDelta,
+            Qt::NoButton, modifiers, Qt::NoScrollPhase, false);
+        QSpontaneKeyEvent::setSpontaneous(&wheelEvent);
+        qApp->notify(window, &wheelEvent);
+    } else if (type == QLatin1String("keyPress") || type == QLatin1String("keyRelease")) {
+        const Qt::Key key = Qt::Key(eventObject.value(QLatin1String("key")).toInt());
+        if (type == QLatin1String("keyPress"))
+            QTest::keyPress(window, key, modifiers);
+        else
+            QTest::keyRelease(window, key, modifiers);
+    } else if (type == QLatin1String("tool")) {
+        bool ok = false;
+        canvas->setTool(enumFromString<ImageCanvas::Tool>(eventObject.value(type).toString(), &ok));
+        if (!ok) {
+            failureMessage = "Unknown tool: " + eventObject.value(type).toString().toLatin1();
+            return false;
+        }
+    } else if (type == QLatin1String("toolShape")) {
+        bool ok = false;
+        canvas->setToolShape(enumFromString<ImageCanvas::ToolShape>(eventObject.value(type).toString(), &ok));
+        if (!ok) {
+            failureMessage = "Unknown tool shape: " + eventObject.value(type).toString().toLatin1();
+            return false;
+        }
+    } else if (type == QLatin1String("toolSize")) {
+        canvas->setToolSize(eventObject.value(type).toInt());
+    } else if (type == QLatin1String("penForegroundColour")) {
+        canvas->setPenForegroundColour(QColor(eventObject.value(QLatin1String("colour")).toString()));
+    } else if (type == QLatin1String("penBackgroundColour")) {
+        canvas->setPenBackgroundColour(QColor(eventObject.value(QLatin1String("colour")).toString()));
+    } else if (type == QLatin1String("undo")) {
+        canvas->undo();
+    } else if (type == QLatin1String("redo")) {
+        canvas->redo();
+    } else {
+        failureMessage = "Unknown event type: " + type.toLatin1();
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     tst_MemoryUsage test(argc, argv);
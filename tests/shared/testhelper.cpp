@@ -519,6 +519,14 @@ QVector<QImage> TestHelper::getLayerImages() const
     return images;
 }
 
+bool TestHelper::waitForLivePreviewModification()
+{
+    // Live preview modifications to layered image projects are computed asynchronously.
+    if (layeredImageProject)
+        TRY_VERIFY(!layeredImageProject->isLivePreviewModificationPending());
+    return true;
+}
+
 Q_REQUIRED_RESULT bool TestHelper::copyAcrossLayers()
 {
     VERIFY2(layeredImageProject, "Need LayeredImageProject in order to copy across layers");
@@ -714,6 +722,8 @@ bool TestHelper::changeImageSize(int width, int height, bool preserveAspectRatio
     QTest::keyClick(window, Qt::Key_Tab);
 
     // Check that the live preview has changed.
+    if (!waitForLivePreviewModification())
+        return false;
     QImage resizedContents = ImageUtils::resizeContents(originalContents, originalWidthSpinBoxValue + 1, originalWidthSpinBoxValue - 1);
     if (!compareImages(project->exportedImage(), resizedContents, "live preview should show resized contents (before cancelling)"))
         return false;
@@ -754,6 +764,8 @@ bool TestHelper::changeImageSize(int width, int height, bool preserveAspectRatio
     QTest::keyClick(window, Qt::Key_Tab);
 
     // Check that the preview has changed.
+    if (!waitForLivePreviewModification())
+        return false;
     resizedContents = ImageUtils::resizeContents(originalContents, width, height);
     if (!compareImages(project->exportedImage(), resizedContents, "live preview should show resized contents (before accepting)"))
         return false;
@@ -881,6 +893,8 @@ bool TestHelper::moveContents(int x, int y, bool onlyVisibleLayers)
     QTest::keyClick(window, Qt::Key_Tab);
 
     // Check that the live preview has changed.
+    if (!waitForLivePreviewModification())
+        return false;
     QImage movedContents = ImageUtils::moveContents(originalContents, 1, -1);
     if (!compareImages(project->exportedImage(), movedContents, "live preview should show moved contents (before cancelling)"))
         return false;
@@ -910,6 +924,8 @@ bool TestHelper::moveContents(int x, int y, bool onlyVisibleLayers)
     QTest::keyClick(window, Qt::Key_Tab);
 
     // Check that the preview has changed.
+    if (!waitForLivePreviewModification())
+        return false;
     movedContents = ImageUtils::moveContents(originalContents, x, y);
     if (!compareImages(project->exportedImage(), movedContents, "live preview should show moved contents (before accepting)"))
         return false;
@@ -979,6 +995,8 @@ bool TestHelper::rearrangeContentsIntoGrid(int cellWidth, int cellHeight, int co
     QTest::keyClick(window, Qt::Key_Tab);
 
     // Check that the live preview has changed.
+    if (!waitForLivePreviewModification())
+        return false;
     QVector<QImage> rearrangedImages = ImageUtils::rearrangeContentsIntoGrid(originalImages,
         originalCellWidthSpinBoxValue + 1, originalCellHeightSpinBoxValue + 2,
         originalColumnsSpinBoxValue + 3, originalRowsSpinBoxValue + 4);
@@ -1017,6 +1035,8 @@ bool TestHelper::rearrangeContentsIntoGrid(int cellWidth, int cellHeight, int co
     QTest::keyClick(window, Qt::Key_Tab);
 
     // Check that the preview has changed.
+    if (!waitForLivePreviewModification())
+        return false;
     rearrangedImages = ImageUtils::rearrangeContentsIntoGrid(originalImages, cellWidth, cellHeight, columns, rows);
     if (!compareImages(getLayerImages(), rearrangedImages, "live preview should show rearranged contents (before accepting)"))
         return false;
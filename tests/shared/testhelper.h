@@ -302,6 +302,7 @@ protected:
     Q_REQUIRED_RESULT bool copyAcrossLayers();
     Q_REQUIRED_RESULT bool pasteAcrossLayers(int pasteX, int pasteY, bool onlyPasteIntoVisibleLayers);
     Q_REQUIRED_RESULT bool changeCanvasSize(int width, int height, CloseDialogFlag closeDialog = CloseDialog);
+    Q_REQUIRED_RESULT bool waitForLivePreviewModification();
     Q_REQUIRED_RESULT bool changeImageSize(int width, int height, bool preserveAspectRatio = false);
     Q_REQUIRED_RESULT bool changeToolSize(int size);
     Q_REQUIRED_RESULT bool changeToolShape(ImageCanvas::ToolShape toolShape);